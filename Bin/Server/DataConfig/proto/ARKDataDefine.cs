@@ -917,6 +917,8 @@ public class Server
 	public static readonly String IP = "IP"; //string
 	public static readonly String Port = "Port"; //int
 	public static readonly String Type = "Type"; //int
+	public static readonly String CompactHead = "CompactHead"; //bool
+	public static readonly String Transport = "Transport"; //string
 	//DataTables
 
 }
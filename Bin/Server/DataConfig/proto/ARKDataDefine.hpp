@@ -935,6 +935,8 @@ public:
 	static const std::string& IP() { static std::string xIP = "IP"; return xIP; } //string
 	static const std::string& Port() { static std::string xPort = "Port"; return xPort; } //int
 	static const std::string& Type() { static std::string xType = "Type"; return xType; } //int
+	static const std::string& CompactHead() { static std::string xCompactHead = "CompactHead"; return xCompactHead; } //bool
+	static const std::string& Transport() { static std::string xTransport = "Transport"; return xTransport; } //string
 	//DataTables
 
 };
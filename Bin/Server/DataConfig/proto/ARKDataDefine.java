@@ -891,6 +891,8 @@ public class Server {
 	public static final String IP = "IP"; // string
 	public static final String Port = "Port"; // int
 	public static final String Type = "Type"; // int
+	public static final String CompactHead = "CompactHead"; // bool
+	public static final String Transport = "Transport"; // string
 	// Record
 
 }
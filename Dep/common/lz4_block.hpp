@@ -0,0 +1,268 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+// lz4 block format, readable by LZ4_decompress_safe and able to read the output of LZ4_compress_default
+#include <stdint.h>
+#include <string.h>
+
+namespace lz4
+{
+
+enum
+{
+    MIN_MATCH = 4,
+    LAST_LITERALS = 5,  //the last 5 bytes are always literals
+    MF_LIMIT = 12,      //the last match starts at least 12 bytes before the end
+    HASH_LOG = 12,
+    MAX_DISTANCE = 65535,
+    RUN_MASK = 15,
+    ML_MASK = 15,
+};
+
+static inline int compress_bound(int src_size)
+{
+    return (src_size < 0 ? 0 : src_size + src_size / 255 + 16);
+}
+
+static inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash32(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+static inline uint8_t* write_length(uint8_t* op, size_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static inline uint8_t* write_sequence(uint8_t* op, const uint8_t* literals, size_t literal_len, size_t offset, size_t match_len, bool last)
+{
+    uint8_t* token = op++;
+    *token = (uint8_t)((literal_len >= RUN_MASK ? (size_t)RUN_MASK : literal_len) << 4);
+
+    if (literal_len >= RUN_MASK)
+    {
+        op = write_length(op, literal_len - RUN_MASK);
+    }
+
+    memcpy(op, literals, literal_len);
+    op += literal_len;
+
+    if (last)
+    {
+        return op;
+    }
+
+    *op++ = (uint8_t)(offset & 0xFF);
+    *op++ = (uint8_t)(offset >> 8);
+
+    match_len -= MIN_MATCH;
+    *token |= (uint8_t)(match_len >= ML_MASK ? (size_t)ML_MASK : match_len);
+
+    if (match_len >= ML_MASK)
+    {
+        op = write_length(op, match_len - ML_MASK);
+    }
+
+    return op;
+}
+
+// return the compressed size, 0 when dst_capacity is less than compress_bound(src_size)
+static inline int compress(const char* src, char* dst, int src_size, int dst_capacity)
+{
+    if (src_size < 0 || dst_capacity < compress_bound(src_size))
+    {
+        return 0;
+    }
+
+    const uint8_t* const base = (const uint8_t*)src;
+    const uint8_t* const end = base + src_size;
+    const uint8_t* ip = base;
+    const uint8_t* anchor = base;
+    uint8_t* op = (uint8_t*)dst;
+
+    if (src_size > MF_LIMIT)
+    {
+        const uint8_t* const match_limit = end - LAST_LITERALS;
+        const uint8_t* const mf_limit = end - MF_LIMIT;
+        uint32_t table[1 << HASH_LOG] = { 0 };
+
+        while (ip <= mf_limit)
+        {
+            const uint32_t seq = read32(ip);
+            const uint32_t h = hash32(seq);
+            const uint8_t* ref = base + table[h];
+            table[h] = (uint32_t)(ip - base);
+
+            if (ref >= ip || ip - ref > MAX_DISTANCE || read32(ref) != seq)
+            {
+                //skip faster through data which does not match
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            const uint8_t* mp = ip + MIN_MATCH;
+            const uint8_t* rp = ref + MIN_MATCH;
+
+            while (mp < match_limit && *mp == *rp)
+            {
+                ++mp;
+                ++rp;
+            }
+
+            op = write_sequence(op, anchor, ip - anchor, ip - ref, mp - ip, false);
+
+            ip = mp;
+            anchor = ip;
+
+            if (ip <= mf_limit)
+            {
+                table[hash32(read32(ip - 2))] = (uint32_t)(ip - 2 - base);
+            }
+        }
+    }
+
+    op = write_sequence(op, anchor, end - anchor, 0, 0, true);
+    return (int)(op - (uint8_t*)dst);
+}
+
+// return the decompressed size, -1 for malformed input or too small dst_capacity
+static inline int decompress(const char* src, char* dst, int src_size, int dst_capacity)
+{
+    if (src_size <= 0 || dst_capacity < 0)
+    {
+        return -1;
+    }
+
+    const uint8_t* ip = (const uint8_t*)src;
+    const uint8_t* const iend = ip + src_size;
+    uint8_t* op = (uint8_t*)dst;
+    uint8_t* const ostart = op;
+    uint8_t* const oend = op + dst_capacity;
+
+    for (;;)
+    {
+        const uint8_t token = *ip++;
+        size_t literal_len = token >> 4;
+
+        if (literal_len == RUN_MASK)
+        {
+            uint8_t s;
+
+            do
+            {
+                if (ip >= iend)
+                {
+                    return -1;
+                }
+
+                s = *ip++;
+                literal_len += s;
+            } while (s == 255);
+        }
+
+        if ((size_t)(iend - ip) < literal_len || (size_t)(oend - op) < literal_len)
+        {
+            return -1;
+        }
+
+        memcpy(op, ip, literal_len);
+        op += literal_len;
+        ip += literal_len;
+
+        if (ip == iend)
+        {
+            break;
+        }
+
+        if (iend - ip < 2)
+        {
+            return -1;
+        }
+
+        const size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > (size_t)(op - ostart))
+        {
+            return -1;
+        }
+
+        size_t match_len = token & ML_MASK;
+
+        if (match_len == ML_MASK)
+        {
+            uint8_t s;
+
+            do
+            {
+                if (ip >= iend)
+                {
+                    return -1;
+                }
+
+                s = *ip++;
+                match_len += s;
+            } while (s == 255);
+        }
+
+        match_len += MIN_MATCH;
+
+        if ((size_t)(oend - op) < match_len || ip >= iend)
+        {
+            return -1;
+        }
+
+        const uint8_t* match = op - offset;
+
+        if (offset >= match_len)
+        {
+            memcpy(op, match, match_len);
+            op += match_len;
+        }
+        else
+        {
+            //overlapped copy repeats the last offset bytes
+            while (match_len-- > 0)
+            {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return (int)(op - ostart);
+}
+
+}
@@ -0,0 +1,331 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "SDK/Core/AFPlatform.hpp"
+#include "SDK/Core/AFNoncopyable.hpp"
+
+#if ARK_PLATFORM != PLATFORM_WIN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+//One direction of a bus channel: a single producer single consumer ring in a named shared memory segment.
+//Records are [len(4) | data | pad to 8], a record never wraps, the writer puts a skip mark at the end of the ring instead.
+//Positions only grow, the writer owns head and the reader owns tail, so nothing but the two atomics is shared.
+//The segment is never unlinked, a restarted process attaches to the same ring again.
+class AFBusChannel : public AFNoncopyable
+{
+public:
+    enum
+    {
+        ARK_BUS_CHANNEL_MAGIC = 0x41524B42, //ARKB
+        ARK_BUS_CHANNEL_VERSION = 1,
+        ARK_BUS_CHANNEL_ALIGN = 8,
+        ARK_BUS_CHANNEL_SKIP = 0xFFFFFFFF,
+    };
+
+    AFBusChannel() = default;
+
+    ~AFBusChannel()
+    {
+        Close();
+    }
+
+    //create the segment or attach to it, nCapacity must be a power of 2
+    bool Open(const std::string& strName, const size_t nCapacity, const bool bReader)
+    {
+        if (m_pHeader != nullptr)
+        {
+            return true;
+        }
+
+        if (nCapacity == 0 || (nCapacity & (nCapacity - 1)) != 0)
+        {
+            return false;
+        }
+
+        bool bCreated = false;
+        char* pMem = Map(strName, sizeof(ChannelHeader) + nCapacity, bCreated);
+
+        if (pMem == nullptr)
+        {
+            return false;
+        }
+
+        ChannelHeader* pHeader = reinterpret_cast<ChannelHeader*>(pMem);
+
+        if (bCreated)
+        {
+            pHeader->nCapacity = nCapacity;
+            pHeader->nVersion = ARK_BUS_CHANNEL_VERSION;
+            pHeader->nHead.store(0, std::memory_order_relaxed);
+            pHeader->nTail.store(0, std::memory_order_relaxed);
+            pHeader->bReader.store(false, std::memory_order_relaxed);
+            pHeader->nMagic.store(ARK_BUS_CHANNEL_MAGIC, std::memory_order_release);
+        }
+        else if (pHeader->nMagic.load(std::memory_order_acquire) != ARK_BUS_CHANNEL_MAGIC
+                 || pHeader->nVersion != ARK_BUS_CHANNEL_VERSION || pHeader->nCapacity != nCapacity)
+        {
+            //not initialized by the creator yet, or another layout
+            Unmap();
+            return false;
+        }
+
+        m_pHeader = pHeader;
+        m_pData = pMem + sizeof(ChannelHeader);
+        mbReader = bReader;
+
+        if (bReader)
+        {
+            //drop what is left from the last run, the writer sends here only after the reader is attached
+            m_pHeader->nTail.store(m_pHeader->nHead.load(std::memory_order_acquire), std::memory_order_release);
+            m_pHeader->bReader.store(true, std::memory_order_release);
+        }
+
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_pHeader != nullptr && mbReader)
+        {
+            m_pHeader->bReader.store(false, std::memory_order_release);
+        }
+
+        m_pHeader = nullptr;
+        m_pData = nullptr;
+        Unmap();
+    }
+
+    bool IsOpen() const
+    {
+        return (m_pHeader != nullptr);
+    }
+
+    //writer side, the reader process is attached
+    bool IsReady() const
+    {
+        return (m_pHeader != nullptr && m_pHeader->bReader.load(std::memory_order_acquire));
+    }
+
+    //write one record made of two parts, false when the ring is full
+    bool Write(const char* pHead, const size_t nHeadLen, const char* pBody, const size_t nBodyLen)
+    {
+        const size_t nLen = nHeadLen + nBodyLen;
+        const size_t nNeed = AlignSize(sizeof(uint32_t) + nLen);
+        const uint64_t nCapacity = m_pHeader->nCapacity;
+
+        if (nNeed > nCapacity / 2)
+        {
+            return false;
+        }
+
+        uint64_t nHead = m_pHeader->nHead.load(std::memory_order_relaxed);
+        const uint64_t nTail = m_pHeader->nTail.load(std::memory_order_acquire);
+        const size_t nPos = (size_t)(nHead & (nCapacity - 1));
+        const size_t nContiguous = (size_t)(nCapacity - nPos);
+        const size_t nSkip = (nNeed > nContiguous ? nContiguous : 0);
+
+        if (nCapacity - (nHead - nTail) < nSkip + nNeed)
+        {
+            return false;
+        }
+
+        if (nSkip > 0)
+        {
+            const uint32_t nMark = ARK_BUS_CHANNEL_SKIP;
+            memcpy(m_pData + nPos, &nMark, sizeof(nMark));
+            nHead += nSkip;
+        }
+
+        char* pRecord = m_pData + (size_t)(nHead & (nCapacity - 1));
+        const uint32_t nRecordLen = (uint32_t)nLen;
+        memcpy(pRecord, &nRecordLen, sizeof(nRecordLen));
+        memcpy(pRecord + sizeof(nRecordLen), pHead, nHeadLen);
+
+        if (nBodyLen > 0)
+        {
+            memcpy(pRecord + sizeof(nRecordLen) + nHeadLen, pBody, nBodyLen);
+        }
+
+        m_pHeader->nHead.store(nHead + nNeed, std::memory_order_release);
+        return true;
+    }
+
+    //reader side, call back every record in place, at most nMaxCount, returns the count
+    template<typename Func>
+    size_t Read(Func&& func, const size_t nMaxCount)
+    {
+        const uint64_t nCapacity = m_pHeader->nCapacity;
+        const uint64_t nHead = m_pHeader->nHead.load(std::memory_order_acquire);
+        uint64_t nTail = m_pHeader->nTail.load(std::memory_order_relaxed);
+        size_t nCount = 0;
+
+        while (nTail != nHead && nCount < nMaxCount)
+        {
+            const size_t nPos = (size_t)(nTail & (nCapacity - 1));
+            uint32_t nLen = 0;
+            memcpy(&nLen, m_pData + nPos, sizeof(nLen));
+
+            if (nLen == ARK_BUS_CHANNEL_SKIP)
+            {
+                nTail += nCapacity - nPos;
+                continue;
+            }
+
+            func(m_pData + nPos + sizeof(nLen), (size_t)nLen);
+            nTail += AlignSize(sizeof(nLen) + nLen);
+            ++nCount;
+        }
+
+        //the records can be overwritten from now on
+        m_pHeader->nTail.store(nTail, std::memory_order_release);
+        return nCount;
+    }
+
+private:
+    struct ChannelHeader
+    {
+        std::atomic<uint32_t> nMagic;
+        uint32_t nVersion;
+        uint64_t nCapacity;
+        std::atomic<bool> bReader;
+        char xPad0[64 - sizeof(std::atomic<uint32_t>) - sizeof(uint32_t) - sizeof(uint64_t) - sizeof(std::atomic<bool>)];
+        //head and tail on their own cache lines
+        std::atomic<uint64_t> nHead;
+        char xPad1[64 - sizeof(std::atomic<uint64_t>)];
+        std::atomic<uint64_t> nTail;
+        char xPad2[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    static size_t AlignSize(const size_t nSize)
+    {
+        return (nSize + ARK_BUS_CHANNEL_ALIGN - 1) & ~(size_t)(ARK_BUS_CHANNEL_ALIGN - 1);
+    }
+
+#if ARK_PLATFORM == PLATFORM_WIN
+    char* Map(const std::string& strName, const size_t nSize, bool& bCreated)
+    {
+        std::string strMapName = "Local\\" + strName;
+        mhMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)nSize >> 32), (DWORD)(nSize & 0xFFFFFFFF), strMapName.c_str());
+
+        if (mhMapping == NULL)
+        {
+            return nullptr;
+        }
+
+        bCreated = (GetLastError() != ERROR_ALREADY_EXISTS);
+        void* pMem = MapViewOfFile(mhMapping, FILE_MAP_ALL_ACCESS, 0, 0, nSize);
+
+        if (pMem == nullptr)
+        {
+            CloseHandle(mhMapping);
+            mhMapping = NULL;
+            return nullptr;
+        }
+
+        m_pMem = pMem;
+        return static_cast<char*>(pMem);
+    }
+
+    void Unmap()
+    {
+        if (m_pMem != nullptr)
+        {
+            UnmapViewOfFile(m_pMem);
+            m_pMem = nullptr;
+        }
+
+        if (mhMapping != NULL)
+        {
+            CloseHandle(mhMapping);
+            mhMapping = NULL;
+        }
+    }
+
+    HANDLE mhMapping{ NULL };
+#else
+    char* Map(const std::string& strName, const size_t nSize, bool& bCreated)
+    {
+        std::string strShmName = "/" + strName;
+        int fd = shm_open(strShmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+        bCreated = (fd >= 0);
+
+        if (bCreated)
+        {
+            if (ftruncate(fd, (off_t)nSize) != 0)
+            {
+                close(fd);
+                shm_unlink(strShmName.c_str());
+                return nullptr;
+            }
+        }
+        else
+        {
+            fd = shm_open(strShmName.c_str(), O_RDWR, 0666);
+
+            struct stat xStat;
+
+            if (fd < 0 || fstat(fd, &xStat) != 0 || (size_t)xStat.st_size < nSize)
+            {
+                //the creator has not set the size yet
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+
+                return nullptr;
+            }
+        }
+
+        void* pMem = mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (pMem == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        m_pMem = pMem;
+        mnMemSize = nSize;
+        return static_cast<char*>(pMem);
+    }
+
+    void Unmap()
+    {
+        if (m_pMem != nullptr)
+        {
+            munmap(m_pMem, mnMemSize);
+            m_pMem = nullptr;
+            mnMemSize = 0;
+        }
+    }
+
+    size_t mnMemSize{ 0 };
+#endif
+
+    void* m_pMem{ nullptr };
+    ChannelHeader* m_pHeader{ nullptr };
+    char* m_pData{ nullptr };
+    bool mbReader{ false };
+};
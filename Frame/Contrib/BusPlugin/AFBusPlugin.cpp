@@ -21,6 +21,8 @@
 #include "AFBusPlugin.h"
 #include "AFCBusModule.h"
 #include "AFCProcModule.h"
+#include "AFCProcConfigModule.h"
+#include "AFCBusConfigModule.h"
 
 #ifdef ARK_DYNAMIC_PLUGIN
 
@@ -43,6 +45,8 @@ const std::string AFBusPlugin::GetPluginName()
 
 void AFBusPlugin::Install()
 {
+    REGISTER_MODULE(pPluginManager, AFIProcConfigModule, AFCProcConfigModule)
+    REGISTER_MODULE(pPluginManager, AFIBusConfigModule, AFCBusConfigModule)
     REGISTER_MODULE(pPluginManager, AFIBusModule, AFCBusModule)
     REGISTER_MODULE(pPluginManager, AFIProcModule, AFCProcModule)
 }
@@ -51,4 +55,6 @@ void AFBusPlugin::Uninstall()
 {
     UNREGISTER_MODULE(pPluginManager, AFIProcModule, AFCProcModule)
     UNREGISTER_MODULE(pPluginManager, AFIBusModule, AFCBusModule)
+    UNREGISTER_MODULE(pPluginManager, AFIBusConfigModule, AFCBusConfigModule)
+    UNREGISTER_MODULE(pPluginManager, AFIProcConfigModule, AFCProcConfigModule)
 }
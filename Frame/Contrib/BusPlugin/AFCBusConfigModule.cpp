@@ -20,7 +20,7 @@
 
 #include "rapidxml/rapidxml.hpp"
 #include "rapidxml/rapidxml_iterators.hpp"
-#include "RapidXML/rapidxml_utils.hpp"
+#include "rapidxml/rapidxml_utils.hpp"
 #include "SDK/Interface/AFIPluginManager.h"
 #include "AFCBusConfigModule.h"
 
@@ -56,28 +56,23 @@ bool AFCBusConfigModule::LoadBusRelation()
         return false;
     }
 
-    for (rapidxml::xml_node<>* pRelationNode = pRoot->first_node("bus_relations"); pRelationNode != nullptr; pRelationNode = pRelationNode->next_sibling())
+    rapidxml::xml_node<>* pRelationsNode = pRoot->first_node("bus_relations");
+    if (pRelationsNode == nullptr)
+    {
+        ARK_ASSERT_NO_EFFECT(0);
+        return false;
+    }
+
+    for (rapidxml::xml_node<>* pRelationNode = pRelationsNode->first_node("relation"); pRelationNode != nullptr; pRelationNode = pRelationNode->next_sibling("relation"))
     {
         std::string proc = pRelationNode->first_attribute("proc")->value();
         std::string target_proc = pRelationNode->first_attribute("target_proc")->value();
-        ARK_CONNECTION_TYPE connection_type = ARK_CONNECTION_TYPE(ARK_LEXICAL_CAST<int>(pRelationNode->first_attribute("target_proc")->value()));
+        ARK_CONNECTION_TYPE connection_type = ARK_CONNECTION_TYPE(ARK_LEXICAL_CAST<int>(pRelationNode->first_attribute("connect_type")->value()));
 
         const ARK_PROCESS_TYPE& proc_type = m_pProcConfigModule->GetProcType(proc);
         const ARK_PROCESS_TYPE& target_proc_type = m_pProcConfigModule->GetProcType(target_proc);
 
-        auto iter = mxBusRelations.find(proc_type);
-        if (iter != mxBusRelations.end())
-        {
-            auto target_process = iter->second;
-            target_process.insert(std::make_pair(target_proc_type, connection_type));
-        }
-        else
-        {
-            std::map<ARK_PROCESS_TYPE, ARK_CONNECTION_TYPE> target_process;
-            target_process.insert(std::make_pair(target_proc_type, connection_type));
-
-            mxBusRelations.insert(std::make_pair(proc_type, target_process));
-        }
+        mxBusRelations[proc_type][target_proc_type] = connection_type;
     }
 
     return true;
@@ -93,6 +88,11 @@ bool AFCBusConfigModule::GetBusRelation(const ARK_PROCESS_TYPE& target_type, con
     }
 
     auto it = iter->second.find(target_type);
+    if (it == iter->second.end())
+    {
+        return false;
+    }
+
     connect_type = it->second;
 
     return m_pProcConfigModule->GetProcHostInfo(target_type, target_inst_id, host_config);
@@ -103,6 +103,23 @@ bool AFCBusConfigModule::GetBusServer(const ARK_PROCESS_TYPE& type, const uint8_
     return m_pProcConfigModule->GetProcHostInfo(type, inst_id, host_config);
 }
 
+bool AFCBusConfigModule::GetBusRelationList(std::vector<AFBusRelation>& relation_list)
+{
+    for (auto& iter : mxBusRelations)
+    {
+        for (auto& it : iter.second)
+        {
+            AFBusRelation relation;
+            relation.proc_type = iter.first;
+            relation.target_proc_type = it.first;
+            relation.connection_type = it.second;
+            relation_list.emplace_back(relation);
+        }
+    }
+
+    return true;
+}
+
 const AFBusAddr AFCBusConfigModule::GetSelfBusID()
 {
     AFBusAddr bus_addr;
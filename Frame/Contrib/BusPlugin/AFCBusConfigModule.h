@@ -33,6 +33,7 @@ public:
 
     virtual bool GetBusRelation(const ARK_PROCESS_TYPE& target_type, const int& inst_id, ARK_CONNECTION_TYPE& connect_type, AFHostConfig& host_config);
     virtual bool GetBusServer(const ARK_PROCESS_TYPE& type, const uint8_t inst_id, AFHostConfig& host_config);
+    virtual bool GetBusRelationList(std::vector<AFBusRelation>& relation_list);
 
     virtual const ARK_PROCESS_TYPE GetSelfProcType();
     virtual const AFBusAddr GetSelfBusID();
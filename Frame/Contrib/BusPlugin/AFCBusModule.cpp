@@ -18,9 +18,14 @@
 *
 */
 
+#include "SDK/Interface/AFIPluginManager.h"
+#include "Server/Interface/AFINetClientModule.hpp"
 #include "AFCBusModule.h"
 
 AFCBusModule::AFCBusModule(AFIPluginManager* p)
+    : mnLastOpenTime(0)
+    , m_pBusConfigModule(nullptr)
+    , m_pProcConfigModule(nullptr)
 {
     pPluginManager = p;
 }
@@ -28,3 +33,211 @@ AFCBusModule::AFCBusModule(AFIPluginManager* p)
 AFCBusModule::~AFCBusModule()
 {
 }
+
+bool AFCBusModule::Init()
+{
+    m_pBusConfigModule = pPluginManager->FindModule<AFIBusConfigModule>();
+    m_pProcConfigModule = pPluginManager->FindModule<AFIProcConfigModule>();
+    ARK_ASSERT_RET_VAL(m_pBusConfigModule != nullptr && m_pProcConfigModule != nullptr, false);
+
+    return true;
+}
+
+bool AFCBusModule::PostInit()
+{
+    CreateLocalChannels();
+
+    return true;
+}
+
+bool AFCBusModule::Shut()
+{
+    //the peers see the rings detached and stop writing to them
+    mxLocalChannels.clear();
+
+    return true;
+}
+
+bool AFCBusModule::Update()
+{
+    const int64_t nNow = GetSteadyTime();
+    const bool bOpen = (nNow - mnLastOpenTime >= ARK_BUS_OPEN_INTERVAL);
+
+    if (bOpen)
+    {
+        mnLastOpenTime = nNow;
+    }
+
+    for (auto& iter : mxLocalChannels)
+    {
+        AFBusLocalChannel& xChannel = *iter.second;
+
+        if (bOpen)
+        {
+            OpenChannel(xChannel);
+        }
+
+        ProcessChannel(xChannel);
+    }
+
+    AFNetMsgArena::Reset();
+    return true;
+}
+
+bool AFCBusModule::CreateLocalChannels()
+{
+    const AFBusAddr xSelf = m_pBusConfigModule->GetSelfBusID();
+    const ARK_PROCESS_TYPE eSelfType = m_pBusConfigModule->GetSelfProcType();
+
+    AFServerConfig xSelfConfig;
+
+    if (!m_pProcConfigModule->GetProcServerInfo(eSelfType, xSelf.inst_id, xSelfConfig))
+    {
+        return false;
+    }
+
+    std::vector<AFBusRelation> xRelationList;
+    m_pBusConfigModule->GetBusRelationList(xRelationList);
+
+    for (const AFBusRelation& xRelation : xRelationList)
+    {
+        //channels are in both directions, connected from either side
+        ARK_PROCESS_TYPE eTargetType = ARK_PROC_NONE;
+
+        if (xRelation.proc_type == eSelfType)
+        {
+            eTargetType = xRelation.target_proc_type;
+        }
+        else if (xRelation.target_proc_type == eSelfType)
+        {
+            eTargetType = xRelation.proc_type;
+        }
+        else
+        {
+            continue;
+        }
+
+        std::vector<AFServerConfig> xServerList;
+        m_pProcConfigModule->GetProcServerList(eTargetType, xServerList);
+
+        for (const AFServerConfig& xServer : xServerList)
+        {
+            //only the peers on the same host
+            if (xServer.host != xSelfConfig.host)
+            {
+                continue;
+            }
+
+            const AFBusAddr xTarget(xSelf.channel_id, xSelf.zone_id, (uint8_t)eTargetType, xServer.inst_id);
+
+            if (xTarget.bus_id == xSelf.bus_id || mxLocalChannels.find(xTarget.bus_id) != mxLocalChannels.end())
+            {
+                continue;
+            }
+
+            std::unique_ptr<AFBusLocalChannel> pChannel(new AFBusLocalChannel());
+            pChannel->nBusID = xTarget.bus_id;
+            pChannel->strSendName = GetChannelName(xSelf.bus_id, xTarget.bus_id);
+            pChannel->strRecvName = GetChannelName(xTarget.bus_id, xSelf.bus_id);
+            OpenChannel(*pChannel);
+
+            mxLocalChannels.insert(std::make_pair(xTarget.bus_id, std::move(pChannel)));
+        }
+    }
+
+    return true;
+}
+
+void AFCBusModule::OpenChannel(AFBusLocalChannel& xChannel)
+{
+    //the first one of the two processes creates the ring, the other attaches to it
+    if (!xChannel.xRecv.IsOpen())
+    {
+        xChannel.xRecv.Open(xChannel.strRecvName, ARK_BUS_CHANNEL_SIZE, true);
+    }
+
+    if (!xChannel.xSend.IsOpen())
+    {
+        xChannel.xSend.Open(xChannel.strSendName, ARK_BUS_CHANNEL_SIZE, false);
+    }
+}
+
+void AFCBusModule::ProcessChannel(AFBusLocalChannel& xChannel)
+{
+    if (!xChannel.xRecv.IsOpen())
+    {
+        return;
+    }
+
+    const AFGUID xClientID(0, (uint64_t)xChannel.nBusID);
+
+    //handled in place, the record is released after the batch
+    xChannel.xRecv.Read([this, &xClientID](const char* pData, const size_t nLen)
+    {
+        if (nLen < AFIMsgHead::ARK_MSG_HEAD_LENGTH)
+        {
+            return;
+        }
+
+        AFCMsgHead xHead;
+        xHead.DeCode(pData);
+
+        if (xHead.GetBodyLength() + AFIMsgHead::ARK_MSG_HEAD_LENGTH != nLen)
+        {
+            return;
+        }
+
+        OnReceiveBaseNetPack(xHead, xHead.GetMsgID(), pData + AFIMsgHead::ARK_MSG_HEAD_LENGTH, xHead.GetBodyLength(), xClientID);
+    }, ARK_BUS_READ_BATCH);
+}
+
+bool AFCBusModule::SendMsg(const int nTargetBusID, const uint16_t nMsgID, const char* msg, const uint32_t nLen, const AFGUID& xPlayerID)
+{
+    auto iter = mxLocalChannels.find(nTargetBusID);
+
+    if (iter != mxLocalChannels.end() && iter->second->xSend.IsReady())
+    {
+        AFCMsgHead xHead;
+        xHead.SetMsgID(nMsgID);
+        xHead.SetPlayerID(xPlayerID);
+        xHead.SetBodyLength(nLen);
+
+        char szHead[AFIMsgHead::ARK_MSG_HEAD_LENGTH] = { 0 };
+        xHead.EnCode(szHead);
+
+        //a full ring fails here instead of going by TCP, that would reorder the messages
+        return iter->second->xSend.Write(szHead, sizeof(szHead), msg, nLen);
+    }
+
+    AFBusAddr xTarget(nTargetBusID);
+    auto it = mxRemoteChannels.find(ARK_PROCESS_TYPE(xTarget.proc_id));
+
+    if (it == mxRemoteChannels.end() || it->second == nullptr)
+    {
+        return false;
+    }
+
+    //the client module knows the server by its config ServerID, the bus id is bound with ConnectData::nBusID
+    return it->second->SendByBusID(nTargetBusID, nMsgID, msg, nLen, xPlayerID);
+}
+
+bool AFCBusModule::IsLocalChannel(const int nTargetBusID)
+{
+    auto iter = mxLocalChannels.find(nTargetBusID);
+    return (iter != mxLocalChannels.end() && iter->second->xSend.IsReady());
+}
+
+void AFCBusModule::AddRemoteChannel(const ARK_PROCESS_TYPE eTargetType, AFINetClientModule* pNetClientModule)
+{
+    mxRemoteChannels[eTargetType] = pNetClientModule;
+}
+
+std::string AFCBusModule::GetChannelName(const int nFromBusID, const int nToBusID)
+{
+    return "ark_bus_" + ARK_TO_STRING(nFromBusID) + "_" + ARK_TO_STRING(nToBusID);
+}
+
+int64_t AFCBusModule::GetSteadyTime()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -21,6 +21,9 @@
 #pragma once
 
 #include "Contrib/Interface/AFIBusModule.h"
+#include "Contrib/Interface/AFIBusConfigModule.h"
+#include "Contrib/Interface/AFIProcConfigModule.h"
+#include "AFBusChannel.hpp"
 
 class AFCBusModule : public AFIBusModule
 {
@@ -28,6 +31,45 @@ public:
     explicit AFCBusModule(AFIPluginManager* p);
     virtual ~AFCBusModule();
 
+    virtual bool Init();
+    virtual bool PostInit();
+    virtual bool Update();
+    virtual bool Shut();
+
+    virtual bool SendMsg(const int nTargetBusID, const uint16_t nMsgID, const char* msg, const uint32_t nLen, const AFGUID& xPlayerID);
+    virtual bool IsLocalChannel(const int nTargetBusID);
+    virtual void AddRemoteChannel(const ARK_PROCESS_TYPE eTargetType, AFINetClientModule* pNetClientModule);
+
+protected:
+    //a ring for each direction, named by [from bus id]_[to bus id]
+    struct AFBusLocalChannel
+    {
+        int nBusID{ 0 };
+        std::string strSendName;
+        std::string strRecvName;
+        AFBusChannel xSend;
+        AFBusChannel xRecv;
+    };
+
+    bool CreateLocalChannels();
+    void OpenChannel(AFBusLocalChannel& xChannel);
+    void ProcessChannel(AFBusLocalChannel& xChannel);
+
+    static std::string GetChannelName(const int nFromBusID, const int nToBusID);
+    static int64_t GetSteadyTime();
+
 private:
+    enum
+    {
+        ARK_BUS_CHANNEL_SIZE = 4 * 1024 * 1024, //every direction
+        ARK_BUS_READ_BATCH = 1024,              //max messages of a channel every update
+        ARK_BUS_OPEN_INTERVAL = 1000,           //ms, retry to attach to the peer
+    };
+
+    std::map<int, std::unique_ptr<AFBusLocalChannel>> mxLocalChannels;
+    std::map<ARK_PROCESS_TYPE, AFINetClientModule*> mxRemoteChannels;
+    int64_t mnLastOpenTime;
 
-};
\ No newline at end of file
+    AFIBusConfigModule* m_pBusConfigModule;
+    AFIProcConfigModule* m_pProcConfigModule;
+};
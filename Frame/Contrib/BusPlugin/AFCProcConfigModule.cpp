@@ -20,7 +20,7 @@
 
 #include "rapidxml/rapidxml.hpp"
 #include "rapidxml/rapidxml_iterators.hpp"
-#include "RapidXML/rapidxml_utils.hpp"
+#include "rapidxml/rapidxml_utils.hpp"
 #include "SDK/Interface/AFIPluginManager.h"
 #include "AFCProcConfigModule.h"
 
@@ -156,6 +156,18 @@ bool AFCProcConfigModule::GetProcServerInfo(const ARK_PROCESS_TYPE& type, uint8_
     return false;
 }
 
+bool AFCProcConfigModule::GetProcServerList(const ARK_PROCESS_TYPE& type, std::vector<AFServerConfig>& server_list)
+{
+    auto iter = mxProcConfig.servers.find(type);
+    if (iter == mxProcConfig.servers.end())
+    {
+        return false;
+    }
+
+    server_list.insert(server_list.end(), iter->second.begin(), iter->second.end());
+    return true;
+}
+
 bool AFCProcConfigModule::GetProcHostInfo(const ARK_PROCESS_TYPE& type, uint8_t inst_id, AFHostConfig& host_config)
 {
     AFServerConfig server_config;
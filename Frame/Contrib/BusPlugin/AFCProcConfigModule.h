@@ -33,6 +33,7 @@ public:
 
     virtual bool GetProcServerInfo(const ARK_PROCESS_TYPE& type, uint8_t inst_id, AFServerConfig& server_config);
     virtual bool GetProcHostInfo(const ARK_PROCESS_TYPE& type, uint8_t inst_id, AFHostConfig& host_config);
+    virtual bool GetProcServerList(const ARK_PROCESS_TYPE& type, std::vector<AFServerConfig>& server_list);
 
 protected:
     bool LoadProcConfig();
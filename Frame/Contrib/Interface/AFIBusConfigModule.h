@@ -77,6 +77,7 @@ class AFIBusConfigModule : public AFIModule
 public:
     virtual bool GetBusRelation(const ARK_PROCESS_TYPE& target_type, const int& inst_id, ARK_CONNECTION_TYPE& connect_type, AFHostConfig& host_config) = 0;
     virtual bool GetBusServer(const ARK_PROCESS_TYPE& type, const uint8_t inst_id, AFHostConfig& host_config) = 0;
+    virtual bool GetBusRelationList(std::vector<AFBusRelation>& relation_list) = 0;
 
     virtual const ARK_PROCESS_TYPE GetSelfProcType() = 0;
     virtual const AFBusAddr GetSelfBusID() = 0;
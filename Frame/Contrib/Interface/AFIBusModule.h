@@ -21,9 +21,42 @@
 #pragma once
 
 #include "SDK/Interface/AFIModule.h"
+#include "Server/Interface/AFINetModule.h"
+#include "Contrib/Interface/AFIBusConfigModule.h"
 
-class AFIBusModule : public AFIModule
+class AFINetClientModule;
+
+//Channels to the processes in bus_relation.xml.
+//Peers on the same host are reached through shared memory rings, the other peers through the TCP client module added by AddRemoteChannel.
+//Receive callbacks are the same as AFINetModule, xClientID of a message from a ring is the bus id of the sender.
+class AFIBusModule : public AFINetModule
 {
 public:
+    virtual ~AFIBusModule() = default;
+
+    virtual bool SendMsg(const int nTargetBusID, const uint16_t nMsgID, const char* msg, const uint32_t nLen, const AFGUID& xPlayerID) = 0;
+
+    bool SendMsg(const int nTargetBusID, const uint16_t nMsgID, const std::string& strData, const AFGUID& xPlayerID)
+    {
+        return SendMsg(nTargetBusID, nMsgID, strData.data(), (uint32_t)strData.length(), xPlayerID);
+    }
+
+    bool SendMsgPB(const int nTargetBusID, const uint16_t nMsgID, const google::protobuf::Message& xData, const AFGUID& xPlayerID)
+    {
+        std::string strData;
+
+        if (!xData.SerializeToString(&strData))
+        {
+            return false;
+        }
+
+        return SendMsg(nTargetBusID, nMsgID, strData, xPlayerID);
+    }
+
+    //the peer is on this host and attached to its ring
+    virtual bool IsLocalChannel(const int nTargetBusID) = 0;
 
-};
\ No newline at end of file
+    //send to the peers of eTargetType by TCP when there is no ring to them,
+    //the peers must be added to pNetClientModule with ConnectData::nBusID set to their bus id
+    virtual void AddRemoteChannel(const ARK_PROCESS_TYPE eTargetType, AFINetClientModule* pNetClientModule) = 0;
+};
@@ -18,68 +18,107 @@
 *
 */
 
+
 #pragma once
 
-class AFBuffer
+#include "AFBufferPool.hpp"
+
+//Reference counted memory block of AFBuffer.
+//Readers take a reference to keep the frames inside alive after the buffer moved on.
+class AFBufferChunk
 {
 public:
-    ~AFBuffer()
+    static AFBufferChunk* Create(size_t nSize)
     {
-        if (mData != nullptr)
+        size_t nBlockSize = AFBufferPool::RoundUp(sizeof(AFBufferChunk) + nSize);
+        char* pBlock = AFBufferPool::GetInstance().Alloc(nBlockSize);
+
+        if (pBlock == nullptr)
         {
-            free(mData);
-            mData = nullptr;
+            return nullptr;
         }
+
+        return new (pBlock) AFBufferChunk(nBlockSize);
+    }
+
+    void AddRef()
+    {
+        mnRefCount.fetch_add(1, std::memory_order_relaxed);
     }
 
-    explicit AFBuffer(size_t nBufferSize = 1024 * 512) : mData(nullptr), mnDataSize(0), mWritePos(0), mnReadPos(0)
+    void Release()
     {
-        if ((mData = (char*)malloc(sizeof(char) * nBufferSize)) != NULL)
+        if (mnRefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
         {
-            mnDataSize = nBufferSize;
-            mnReadPos = 0;
-            mWritePos = 0;
+            size_t nBlockSize = mnBlockSize;
+            this->~AFBufferChunk();
+            AFBufferPool::GetInstance().Free(reinterpret_cast<char*>(this), nBlockSize);
         }
     }
 
-    bool write(const char* data, size_t len)
+    bool IsShared() const
     {
-        bool write_ret = true;
+        return mnRefCount.load(std::memory_order_acquire) > 1;
+    }
+
+    char* GetData()
+    {
+        return reinterpret_cast<char*>(this) + sizeof(AFBufferChunk);
+    }
 
-        if (getwritevalidcount() >= len)
+    size_t GetSize() const
+    {
+        return mnBlockSize - sizeof(AFBufferChunk);
+    }
+
+private:
+    explicit AFBufferChunk(size_t nBlockSize) : mnRefCount(1), mnBlockSize(nBlockSize)
+    {
+    }
+
+    ~AFBufferChunk() = default;
+
+    std::atomic<int> mnRefCount;
+    size_t mnBlockSize;
+};
+
+class AFBuffer
+{
+public:
+    ~AFBuffer()
+    {
+        release();
+    }
+
+    explicit AFBuffer(size_t nBufferSize = AFBufferPool::ARK_BUFFER_MIN_SIZE) : mpChunk(nullptr), mData(nullptr), mnDataSize(0), mWritePos(0), mnReadPos(0), mnInitSize(nBufferSize)
+    {
+    }
+
+    bool write(const char* data, size_t len)
+    {
+        if (len == 0)
         {
-            memcpy(getwriteptr(), data, len);
-            addwritepos(len);
+            return true;
         }
-        else
-        {
-            size_t left_len = mnDataSize - getlength();
 
-            if (left_len >= len)
+        if (getwritevalidcount() < len)
+        {
+            if (mnDataSize - getlength() >= len && !mpChunk->IsShared())
             {
                 AdjusttoHead();
-                write(data, len);
             }
-            else
+            else if (!grow(getlength() + len))
             {
-                size_t needLen = len - left_len;
-
-                if (needLen > 0)
-                {
-                    grow(needLen);
-                    write(data, len);
-                }
-                else
-                {
-                    write_ret = false;
-                }
+                return false;
             }
         }
 
-        return write_ret;
+        memcpy(getwriteptr(), data, len);
+        addwritepos(len);
+        return true;
     }
 
-    size_t getlength()
+    size_t getlength() const
     {
         return mWritePos - mnReadPos;
     }
@@ -98,12 +137,34 @@ public:
 
     void removedata(size_t value)
     {
-        size_t temp = mnReadPos + value;
+        if (value > getlength())
+        {
+            return;
+        }
 
-        if (temp <= mnDataSize)
+        mnReadPos += value;
+
+        if (mnReadPos == mWritePos)
+        {
+            //all data consumed, the connection does not need the memory any more
+            release();
+        }
+    }
+
+    size_t getcapacity() const
+    {
+        return mnDataSize;
+    }
+
+    //take a reference of the current block, caller must Release it
+    AFBufferChunk* sharechunk()
+    {
+        if (mpChunk != nullptr)
         {
-            mnReadPos = temp;
+            mpChunk->AddRef();
         }
+
+        return mpChunk;
     }
 
 private:
@@ -127,24 +188,6 @@ private:
         mWritePos = len;
     }
 
-    //Remove unused function
-    //void init()
-    //{
-    //    mnReadPos = 0;
-    //    mWritePos = 0;
-    //}
-
-    size_t getwritepos()
-    {
-        return mWritePos;
-    }
-
-    //Remove unused function
-    //size_t getreadpos()
-    //{
-    //    return mnReadPos;
-    //}
-
     void addwritepos(size_t value)
     {
         size_t temp = mWritePos + value;
@@ -155,17 +198,11 @@ private:
         }
     }
 
-    size_t getwritevalidcount()
+    size_t getwritevalidcount() const
     {
         return mnDataSize - mWritePos;
     }
 
-    //Remove unused function
-    //size_t getsize()
-    //{
-    //    return mnDataSize;
-    //}
-
     char* getwriteptr()
     {
         if (mWritePos < mnDataSize)
@@ -178,20 +215,51 @@ private:
         }
     }
 
-    void grow(size_t len)
+    bool grow(size_t len)
+    {
+        //grow at least twice for the blocks out of the pool size classes
+        size_t n = (len > mnDataSize ? std::max(len, mnDataSize * 2) : len);
+        AFBufferChunk* pChunk = AFBufferChunk::Create(std::max(n, mnInitSize - std::min(mnInitSize, sizeof(AFBufferChunk))));
+
+        if (pChunk == nullptr)
+        {
+            return false;
+        }
+
+        size_t nLength = getlength();
+
+        if (nLength > 0)
+        {
+            memcpy(pChunk->GetData(), mData + mnReadPos, nLength);
+        }
+
+        release();
+        mpChunk = pChunk;
+        mData = pChunk->GetData();
+        mnDataSize = pChunk->GetSize();
+        mWritePos = nLength;
+        return true;
+    }
+
+    void release()
     {
-        size_t n = mnDataSize + len;
-        char* d = new char[n];
+        if (mpChunk != nullptr)
+        {
+            mpChunk->Release();
+            mpChunk = nullptr;
+        }
 
-        memcpy(d, mData, getwritepos());
-        mnDataSize = n;
-        delete[] mData;
-        mData = d;
+        mData = nullptr;
+        mnDataSize = 0;
+        mWritePos = 0;
+        mnReadPos = 0;
     }
 
+    AFBufferChunk* mpChunk;
     char*   mData;
     size_t mnDataSize;
 
     size_t mWritePos;
     size_t mnReadPos;
-};
\ No newline at end of file
+    size_t mnInitSize; //size of the first block
+};
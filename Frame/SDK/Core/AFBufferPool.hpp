@@ -0,0 +1,208 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+
+#pragma once
+
+#include "AFPlatform.hpp"
+#include "AFSpinLock.hpp"
+#include "AFSingleton.hpp"
+
+//Process wide pool of receive buffer blocks.
+//Blocks are handed out in fixed size classes(4K/16K/64K/256K/1M) so that connections
+//only hold the memory they really need, and drained blocks are cached for the next user.
+//Blocks bigger than the largest class are allocated directly and freed when released.
+class AFBufferPool : public AFSingleton<AFBufferPool>
+{
+public:
+    enum
+    {
+        ARK_BUFFER_MIN_SIZE = 4 * 1024,
+        ARK_BUFFER_MAX_SIZE = 1024 * 1024,
+        ARK_BUFFER_CLASS_COUNT = 5,
+        ARK_BUFFER_CLASS_CACHE = 8 * 1024 * 1024, //max cached bytes of every size class
+    };
+
+    AFBufferPool() : mnUsedBytes(0), mnCachedBytes(0), mnPeakBytes(0)
+    {
+        for (int i = 0; i < ARK_BUFFER_CLASS_COUNT; ++i)
+        {
+            mxFreeList[i] = nullptr;
+            mnFreeCount[i] = 0;
+        }
+    }
+
+    ~AFBufferPool()
+    {
+        Purge();
+    }
+
+    //the real block size used to hold nSize bytes
+    static size_t RoundUp(size_t nSize)
+    {
+        size_t nClassSize = ARK_BUFFER_MIN_SIZE;
+
+        for (int i = 0; i < ARK_BUFFER_CLASS_COUNT; ++i, nClassSize <<= 2)
+        {
+            if (nSize <= nClassSize)
+            {
+                return nClassSize;
+            }
+        }
+
+        return nSize;
+    }
+
+    //nSize must be a value returned by RoundUp
+    char* Alloc(size_t nSize)
+    {
+        char* pData = nullptr;
+        int nIndex = GetClassIndex(nSize);
+
+        if (nIndex >= 0)
+        {
+            std::lock_guard<AFSpinLock> xGuard(mxLocks[nIndex]);
+            FreeBlock* pBlock = mxFreeList[nIndex];
+
+            if (pBlock != nullptr)
+            {
+                mxFreeList[nIndex] = pBlock->next;
+                --mnFreeCount[nIndex];
+                mnCachedBytes -= nSize;
+                pData = reinterpret_cast<char*>(pBlock);
+            }
+        }
+
+        if (pData == nullptr)
+        {
+            pData = (char*)malloc(nSize);
+
+            if (pData == nullptr)
+            {
+                return nullptr;
+            }
+        }
+
+        size_t nUsed = (mnUsedBytes += nSize);
+        size_t nPeak = mnPeakBytes;
+
+        while (nUsed > nPeak && !mnPeakBytes.compare_exchange_weak(nPeak, nUsed))
+        {
+        }
+
+        return pData;
+    }
+
+    void Free(char* pData, size_t nSize)
+    {
+        if (pData == nullptr)
+        {
+            return;
+        }
+
+        mnUsedBytes -= nSize;
+        int nIndex = GetClassIndex(nSize);
+
+        if (nIndex >= 0)
+        {
+            std::lock_guard<AFSpinLock> xGuard(mxLocks[nIndex]);
+
+            if ((mnFreeCount[nIndex] + 1) * nSize <= ARK_BUFFER_CLASS_CACHE)
+            {
+                FreeBlock* pBlock = reinterpret_cast<FreeBlock*>(pData);
+                pBlock->next = mxFreeList[nIndex];
+                mxFreeList[nIndex] = pBlock;
+                ++mnFreeCount[nIndex];
+                mnCachedBytes += nSize;
+                return;
+            }
+        }
+
+        free(pData);
+    }
+
+    //give all cached blocks back to the system
+    void Purge()
+    {
+        size_t nClassSize = ARK_BUFFER_MIN_SIZE;
+
+        for (int i = 0; i < ARK_BUFFER_CLASS_COUNT; ++i, nClassSize <<= 2)
+        {
+            std::lock_guard<AFSpinLock> xGuard(mxLocks[i]);
+
+            while (mxFreeList[i] != nullptr)
+            {
+                FreeBlock* pBlock = mxFreeList[i];
+                mxFreeList[i] = pBlock->next;
+                free(pBlock);
+            }
+
+            mnCachedBytes -= mnFreeCount[i] * nClassSize;
+            mnFreeCount[i] = 0;
+        }
+    }
+
+    //bytes held by live buffers
+    size_t GetUsedBytes() const
+    {
+        return mnUsedBytes;
+    }
+
+    //bytes cached in the pool and ready for reuse
+    size_t GetCachedBytes() const
+    {
+        return mnCachedBytes;
+    }
+
+    //highest value of used bytes since process start
+    size_t GetPeakBytes() const
+    {
+        return mnPeakBytes;
+    }
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    static int GetClassIndex(size_t nSize)
+    {
+        size_t nClassSize = ARK_BUFFER_MIN_SIZE;
+
+        for (int i = 0; i < ARK_BUFFER_CLASS_COUNT; ++i, nClassSize <<= 2)
+        {
+            if (nSize == nClassSize)
+            {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    AFSpinLock mxLocks[ARK_BUFFER_CLASS_COUNT];
+    FreeBlock* mxFreeList[ARK_BUFFER_CLASS_COUNT];
+    size_t mnFreeCount[ARK_BUFFER_CLASS_COUNT];
+
+    std::atomic<size_t> mnUsedBytes;
+    std::atomic<size_t> mnCachedBytes;
+    std::atomic<size_t> mnPeakBytes;
+};
@@ -46,11 +46,25 @@ public:
         return mList.try_dequeue(object);
     }
 
+    //pop at most nMaxCount objects, return the count popped. Consumer thread only
+    size_t Pop(T* pObjects, size_t nMaxCount)
+    {
+        size_t nCount = 0;
+
+        while (nCount < nMaxCount && mList.try_dequeue(pObjects[nCount]))
+        {
+            ++nCount;
+        }
+
+        return nCount;
+    }
+
     size_t Count()
     {
         return mList.size_approx();
     }
 
 private:
-    moodycamel::BlockingReaderWriterQueue<T> mList;
+    //nobody waits on the queue, so the non-blocking version saves the semaphore on every push and pop
+    moodycamel::ReaderWriterQueue<T> mList;
 };
\ No newline at end of file
@@ -0,0 +1,369 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include "AFCKcpNetClient.h"
+
+void AFCKcpNetClient::Update()
+{
+    ProcessMsgLogicThread();
+    UpdateStats();
+}
+
+void AFCKcpNetClient::Start(const std::string& strAddrPort, const int nServerID)
+{
+    std::string strHost;
+    int nPort = 0;
+
+    if (mbRunning || !SplitHostPort(strAddrPort, strHost, nPort) || !AFNetUdpSocket::MakeAddr(strHost, nPort, mxServerAddr))
+    {
+        return;
+    }
+
+    if (!mxSocket.Open("", 0))
+    {
+        return;
+    }
+
+    mxSocket.SetFault(mxFaultConfig);
+    mnServerID = nServerID;
+    mbConnected = false;
+    mnCookie = 0;
+
+    //the token tells the SYN of this client from the ones of an old client on the same address
+    const uint32_t nToken = std::random_device {}();
+    m_pClientEntity.reset(ARK_NEW AFKcpEntity(this, AFGUID(mnServerID, 1), &mxSocket, mxServerAddr, 0, nToken));
+
+    mbRunning = true;
+    mxThread = std::thread(&AFCKcpNetClient::Run, this);
+    SetWorking(true);
+}
+
+bool AFCKcpNetClient::Final()
+{
+    mbRunning = false;
+
+    if (mxThread.joinable())
+    {
+        mxThread.join();
+    }
+
+    if (m_pClientEntity != nullptr && mbConnected)
+    {
+        m_pClientEntity->SendControl(AFNetKcpControl::ARK_KCP_CTRL_FIN);
+    }
+
+    mbConnected = false;
+    m_pClientEntity.reset(nullptr);
+    mxSocket.Close();
+    SetWorking(false);
+    return true;
+}
+
+void AFCKcpNetClient::Run()
+{
+    std::vector<char> xBuffer(AFNetUdpSocket::ARK_UDP_MAX_DATAGRAM);
+    const uint32_t nStartTime = AFNetKcp::GetClock();
+    uint32_t nSynTime = nStartTime;
+
+    while (mbRunning && !m_pClientEntity->IsClosed())
+    {
+        uint32_t nNow = AFNetKcp::GetClock();
+        uint32_t nNextTime = nNow + AFNetKcpControl::ARK_KCP_MAX_WAIT;
+
+        if (!mbConnected)
+        {
+            if ((int32_t)(nNow - nStartTime) >= (int32_t)mxKcpConfig.nTimeout)
+            {
+                //the owner learns it like a lost link, e.g. to connect again
+                CONSOLE_LOG_NO_FILE << "kcp connect timeout" << std::endl;
+                CloseLink(false);
+                break;
+            }
+
+            if ((int32_t)(nNow - nSynTime) >= 0)
+            {
+                SendSyn();
+                nSynTime = nNow + AFNetKcpControl::ARK_KCP_SYN_INTERVAL;
+            }
+        }
+        else if (!m_pClientEntity->Tick(nNow, mxKcpConfig.nTimeout, nNextTime))
+        {
+            CloseLink(true);
+            break;
+        }
+
+        int nWait = std::max<int>(0, (int32_t)(nNextTime - nNow));
+        const int nFaultWait = mxSocket.PumpFault(nNow);
+
+        if (nFaultWait >= 0)
+        {
+            nWait = std::min(nWait, nFaultWait);
+        }
+
+        mxSocket.Wait(nWait);
+
+        nNow = AFNetKcp::GetClock();
+        sockaddr_in xAddr;
+
+        for (int i = 0; i < AFNetKcpControl::ARK_KCP_MAX_DRAIN; ++i)
+        {
+            const int nLen = mxSocket.RecvFrom(xBuffer.data(), xBuffer.size(), xAddr);
+
+            if (nLen < 0)
+            {
+                break;
+            }
+
+            if (AFNetUdpSocket::GetAddrKey(xAddr) == AFNetUdpSocket::GetAddrKey(mxServerAddr))
+            {
+                OnDatagram(xBuffer.data(), nLen, nNow);
+            }
+        }
+    }
+
+    mxSocket.Flush();
+}
+
+void AFCKcpNetClient::OnDatagram(const char* pData, const size_t nLen, const uint32_t nNow)
+{
+    uint32_t nConv = AFNetKcp::GetConv(pData, nLen);
+
+    if (nConv != 0)
+    {
+        if (!mbConnected || nConv != m_pClientEntity->GetConv() || !m_pClientEntity->Input(pData, nLen, nNow))
+        {
+            return;
+        }
+
+        AFBufferChunk* pChunk = nullptr;
+        const char* pFrames = nullptr;
+        size_t nFramesLen = 0;
+        uint8_t nPeerCaps = 0;
+
+        if (!AFNetFrameCodec::Take(m_pClientEntity.get(), IsCompactHead(), IsCompress(), pChunk, pFrames, nFramesLen, nPeerCaps))
+        {
+            CloseLink(true);
+            return;
+        }
+
+        if (pChunk != nullptr)
+        {
+            AFKcpMsg* pMsg = AFKcpMsg::Create(m_pClientEntity.get());
+            pMsg->nType = RECIVEDATA;
+            pMsg->pChunk = pChunk;
+            pMsg->pData = pFrames;
+            pMsg->nLen = nFramesLen;
+            m_pClientEntity->mxNetMsgMQ.Push(pMsg);
+        }
+
+        return;
+    }
+
+    uint8_t nCmd = 0;
+    uint32_t nToken = 0;
+
+    if (!AFNetKcpControl::Parse(pData, nLen, nCmd, nToken, nConv) || nToken != m_pClientEntity->GetToken())
+    {
+        return;
+    }
+
+    switch (nCmd)
+    {
+    case AFNetKcpControl::ARK_KCP_CTRL_COOKIE:
+        {
+            //answered at once, the SYN with the cookie sets the link up
+            if (!mbConnected && nConv != 0 && nConv != mnCookie)
+            {
+                mnCookie = nConv;
+                SendSyn();
+            }
+        }
+        break;
+
+    case AFNetKcpControl::ARK_KCP_CTRL_SYN_ACK:
+        {
+            if (!mbConnected && nConv != 0)
+            {
+                m_pClientEntity->SetConv(nConv);
+                m_pClientEntity->Touch(nNow);
+                mbConnected = true;
+                PushEvent(CONNECTED);
+            }
+        }
+        break;
+
+    case AFNetKcpControl::ARK_KCP_CTRL_PING:
+        {
+            if (mbConnected && nConv == m_pClientEntity->GetConv())
+            {
+                m_pClientEntity->Touch(nNow);
+            }
+        }
+        break;
+
+    case AFNetKcpControl::ARK_KCP_CTRL_FIN:
+        {
+            if (mbConnected && nConv == m_pClientEntity->GetConv())
+            {
+                CloseLink(false);
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void AFCKcpNetClient::CloseLink(const bool bSendFin)
+{
+    if (bSendFin)
+    {
+        m_pClientEntity->SendControl(AFNetKcpControl::ARK_KCP_CTRL_FIN);
+    }
+
+    m_pClientEntity->SetClosed();
+    PushEvent(DISCONNECTED);
+}
+
+void AFCKcpNetClient::SendSyn()
+{
+    char szData[AFNetKcpControl::ARK_KCP_CTRL_LENGTH];
+    AFNetKcpControl::Make(szData, AFNetKcpControl::ARK_KCP_CTRL_SYN, m_pClientEntity->GetToken(), mnCookie);
+    mxSocket.SendTo(szData, sizeof(szData), mxServerAddr);
+}
+
+void AFCKcpNetClient::PushEvent(const NetEventType eType)
+{
+    AFKcpMsg* pMsg = AFKcpMsg::Create(m_pClientEntity.get());
+    pMsg->xClientID = m_pClientEntity->GetClientID();
+    pMsg->nType = eType;
+    m_pClientEntity->mxNetMsgMQ.Push(pMsg);
+}
+
+void AFCKcpNetClient::ProcessMsgLogicThread()
+{
+    if (m_pClientEntity == nullptr)
+    {
+        return;
+    }
+
+    //only the messages already in queue, the io thread keeps pushing
+    size_t nReceiveCount = m_pClientEntity->mxNetMsgMQ.Count();
+    AFKcpMsg* xMsgs[AFNetMsgPool<AFKcpMsg>::ARK_NET_MSG_BATCH];
+
+    while (nReceiveCount > 0)
+    {
+        size_t nPopCount = m_pClientEntity->mxNetMsgMQ.Pop(xMsgs, std::min<size_t>(nReceiveCount, AFNetMsgPool<AFKcpMsg>::ARK_NET_MSG_BATCH));
+
+        if (nPopCount == 0)
+        {
+            break;
+        }
+
+        nReceiveCount -= nPopCount;
+
+        for (size_t i = 0; i < nPopCount; ++i)
+        {
+            AFKcpMsg* pMsg = xMsgs[i];
+
+            switch (pMsg->nType)
+            {
+            case RECIVEDATA:
+                {
+                    if (mRecvCB)
+                    {
+                        DispatchFrames(pMsg->pData, pMsg->nLen, m_pClientEntity->GetClientID(), mRecvCB);
+                    }
+                }
+                break;
+
+            case CONNECTED:
+                mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                break;
+
+            case DISCONNECTED:
+                {
+                    mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                    m_pClientEntity->SetNeedRemove(true);
+                }
+                break;
+
+            default:
+                break;
+            }
+
+            AFKcpMsg::Release(pMsg);
+        }
+    }
+}
+
+bool AFCKcpNetClient::SendMsgWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID)
+{
+    AFCMsgHead xHead;
+    xHead.SetMsgID(nMsgID);
+    xHead.SetPlayerID(xPlayerID);
+    xHead.SetBodyLength(nLen);
+
+    return SendMsgPacket(AFNetPacketPool::GetInstance().EnCode(xHead, msg, nLen), xClientID);
+}
+
+bool AFCKcpNetClient::SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID)
+{
+    //the conv is set by io thread before CONNECTED is pushed, so a link seen connected by logic thread can send
+    if (m_pClientEntity == nullptr || m_pClientEntity->GetConv() == 0 || m_pClientEntity->IsClosed())
+    {
+        return false;
+    }
+
+    AFNetStats::RecordSend(GetPacketMsgID(xPacket), xPacket->size());
+
+    if (IsCompactHead())
+    {
+        const brynet::net::DataSocket::PACKET_PTR xCompact = AFNetFrameCodec::PackCompact(xPacket);
+        return m_pClientEntity->Send(xCompact->data(), xCompact->size());
+    }
+
+    return m_pClientEntity->Send(xPacket->data(), xPacket->size());
+}
+
+bool AFCKcpNetClient::CloseNetEntity(const AFGUID& xClient)
+{
+    if (m_pClientEntity != nullptr && m_pClientEntity->GetClientID() == xClient)
+    {
+        m_pClientEntity->RequestClose();
+    }
+
+    return true;
+}
+
+void AFCKcpNetClient::GetSessionStats(std::vector<AFNetSessionStat>& xList)
+{
+    if (m_pClientEntity == nullptr)
+    {
+        return;
+    }
+
+    AFNetSessionStat xStat;
+    xStat.xClientID = m_pClientEntity->GetClientID();
+    xStat.nRecvQueue = m_pClientEntity->mxNetMsgMQ.Count();
+    xStat.nSendBacklog = m_pClientEntity->GetSendBacklog();
+    xList.push_back(xStat);
+}
@@ -0,0 +1,88 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "AFINet.h"
+#include "AFNetUdp.hpp"
+
+//Client of one reliable udp link to AFCKcpNetServer.
+//Start returns at once, the io thread sends SYN until the server answers or the link times out, with the cookie of the server once it has one,
+//CONNECTED comes in Update like the one of AFCNetClient.
+class AFCKcpNetClient : public AFINet
+{
+public:
+    template<typename BaseType>
+    AFCKcpNetClient(BaseType* pBaseType, void (BaseType::*handleRecieve)(const AFIMsgHead& xHead, const int, const char*, const size_t, const AFGUID&), void (BaseType::*handleEvent)(const NetEventType, const AFGUID&, const int))
+    {
+        mRecvCB = std::bind(handleRecieve, pBaseType, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5);
+        mEventCB = std::bind(handleEvent, pBaseType, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+    }
+
+    virtual ~AFCKcpNetClient()
+    {
+        Final();
+    }
+
+    virtual void Update();
+    virtual void Start(const std::string& strAddrPort, const int nServerID);
+    virtual bool Final() final;
+    virtual bool SendMsgWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID = 0, const AFGUID& xPlayerID = 0);
+    virtual bool SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID = 0);
+
+    virtual bool CloseNetEntity(const AFGUID& xClient);
+    virtual void GetSessionStats(std::vector<AFNetSessionStat>& xList);
+
+    virtual bool IsServer()
+    {
+        return false;
+    }
+
+    virtual bool Log(int severity, const char* msg)
+    {
+        return true;
+    }
+
+private:
+    //io thread
+    void Run();
+    void OnDatagram(const char* pData, const size_t nLen, const uint32_t nNow);
+    void CloseLink(const bool bSendFin);
+    void PushEvent(const NetEventType eType);
+    void SendSyn();
+
+    //logic thread
+    void ProcessMsgLogicThread();
+
+private:
+    //created by Start, deleted by Final after io thread stopped
+    std::unique_ptr<AFKcpEntity> m_pClientEntity{ nullptr };
+    sockaddr_in mxServerAddr;
+    int mnServerID{ 0 };
+    bool mbConnected{ false }; //io thread
+    uint32_t mnCookie{ 0 }; //io thread, the cookie of the server which SYN carries
+
+    NET_RECEIVE_FUNCTOR mRecvCB;
+    NET_EVENT_FUNCTOR mEventCB;
+
+    AFNetUdpSocket mxSocket;
+    std::atomic<bool> mbRunning{ false };
+    std::thread mxThread;
+};
@@ -0,0 +1,556 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include "AFCKcpNetServer.h"
+
+void AFCKcpNetServer::Update()
+{
+    ProcessMsgLogicThread();
+    UpdateStats();
+}
+
+int AFCKcpNetServer::Start(const unsigned int nMaxClient, const std::string& strAddrPort, const int nServerID, const int nThreadCount)
+{
+    std::string strHost;
+    int nPort = 0;
+
+    if (mbRunning || !SplitHostPort(strAddrPort, strHost, nPort))
+    {
+        return -1;
+    }
+
+    mnMaxConnect = nMaxClient;
+    mnServerID = nServerID;
+
+    if (!mxSocket.Open(strHost, nPort))
+    {
+        return -1;
+    }
+
+    mxSocket.SetFault(mxFaultConfig);
+
+    std::random_device xRandom;
+    mnCookieSecret = ((uint64_t)xRandom() << 32) | xRandom();
+
+    mbRunning = true;
+    mxThread = std::thread(&AFCKcpNetServer::Run, this);
+    SetWorking(true);
+    return 0;
+}
+
+bool AFCKcpNetServer::Final()
+{
+    mbRunning = false;
+
+    if (mxThread.joinable())
+    {
+        mxThread.join();
+    }
+
+    //the io thread is gone, the peers are told and all the entities are deleted here
+    for (auto& iter : mxLinkEntities)
+    {
+        iter.second->SendControl(AFNetKcpControl::ARK_KCP_CTRL_FIN);
+    }
+
+    mxLinkEntities.clear();
+
+    mxEntitySlots.ForEach([](AFKcpEntityPtr pEntity)
+    {
+        ARK_DELETE(pEntity);
+    });
+
+    mxEntitySlots.Clear();
+    mxReadyList.clear();
+    mxRemoveList.clear();
+    mxProcessReadyList.clear();
+    mxProcessRemoveList.clear();
+
+    mxSocket.Close();
+    SetWorking(false);
+    return true;
+}
+
+void AFCKcpNetServer::Run()
+{
+    std::vector<char> xBuffer(AFNetUdpSocket::ARK_UDP_MAX_DATAGRAM);
+    std::vector<AFKcpEntityPtr> xCloseList;
+
+    while (mbRunning)
+    {
+        uint32_t nNow = AFNetKcp::GetClock();
+        uint32_t nNextTime = nNow + AFNetKcpControl::ARK_KCP_MAX_WAIT;
+
+        for (auto& iter : mxLinkEntities)
+        {
+            uint32_t nLinkTime = nNextTime;
+
+            if (!iter.second->Tick(nNow, mxKcpConfig.nTimeout, nLinkTime))
+            {
+                xCloseList.push_back(iter.second);
+            }
+            else if ((int32_t)(nLinkTime - nNextTime) < 0)
+            {
+                nNextTime = nLinkTime;
+            }
+        }
+
+        //timeout, dead link or closed by logic thread
+        for (auto pEntity : xCloseList)
+        {
+            CloseLink(pEntity, true);
+        }
+
+        xCloseList.clear();
+
+        int nWait = std::max<int>(0, (int32_t)(nNextTime - nNow));
+        const int nFaultWait = mxSocket.PumpFault(nNow);
+
+        if (nFaultWait >= 0)
+        {
+            nWait = std::min(nWait, nFaultWait);
+        }
+
+        mxSocket.Wait(nWait);
+
+        nNow = AFNetKcp::GetClock();
+        sockaddr_in xAddr;
+
+        for (int i = 0; i < AFNetKcpControl::ARK_KCP_MAX_DRAIN; ++i)
+        {
+            const int nLen = mxSocket.RecvFrom(xBuffer.data(), xBuffer.size(), xAddr);
+
+            if (nLen < 0)
+            {
+                break;
+            }
+
+            OnDatagram(xBuffer.data(), nLen, xAddr, nNow);
+        }
+    }
+}
+
+void AFCKcpNetServer::OnDatagram(const char* pData, const size_t nLen, const sockaddr_in& xAddr, const uint32_t nNow)
+{
+    const uint32_t nConv = AFNetKcp::GetConv(pData, nLen);
+
+    if (nConv == 0)
+    {
+        OnControl(pData, nLen, xAddr, nNow);
+        return;
+    }
+
+    auto iter = mxLinkEntities.find(AFNetUdpSocket::GetAddrKey(xAddr));
+
+    if (iter == mxLinkEntities.end() || iter->second->GetConv() != nConv)
+    {
+        return;
+    }
+
+    //a bad datagram is dropped like a lost one, bad frames close the link
+    AFKcpEntityPtr pEntity = iter->second;
+
+    if (pEntity->Input(pData, nLen, nNow) && !DismantleNet(pEntity))
+    {
+        CloseLink(pEntity, true);
+    }
+}
+
+void AFCKcpNetServer::OnControl(const char* pData, const size_t nLen, const sockaddr_in& xAddr, const uint32_t nNow)
+{
+    uint8_t nCmd = 0;
+    uint32_t nToken = 0;
+    uint32_t nConv = 0;
+
+    if (!AFNetKcpControl::Parse(pData, nLen, nCmd, nToken, nConv))
+    {
+        return;
+    }
+
+    auto iter = mxLinkEntities.find(AFNetUdpSocket::GetAddrKey(xAddr));
+    AFKcpEntityPtr pEntity = (iter != mxLinkEntities.end() ? iter->second : nullptr);
+    const bool bMatch = (pEntity != nullptr && pEntity->GetToken() == nToken && pEntity->GetConv() == nConv);
+
+    switch (nCmd)
+    {
+    case AFNetKcpControl::ARK_KCP_CTRL_SYN:
+        {
+            if (pEntity != nullptr && pEntity->GetToken() == nToken)
+            {
+                //the SYN_ACK was lost
+                pEntity->SendControl(AFNetKcpControl::ARK_KCP_CTRL_SYN_ACK);
+                break;
+            }
+
+            //the conv field carries the cookie, the peer must prove it gets the datagrams of its address first
+            const uint64_t nAddrKey = AFNetUdpSocket::GetAddrKey(xAddr);
+
+            if (nConv == 0 || !AFNetKcpControl::CheckCookie(mnCookieSecret, nAddrKey, nToken, nConv, nNow))
+            {
+                char szData[AFNetKcpControl::ARK_KCP_CTRL_LENGTH];
+                AFNetKcpControl::Make(szData, AFNetKcpControl::ARK_KCP_CTRL_COOKIE, nToken,
+                                      AFNetKcpControl::MakeCookie(mnCookieSecret, nAddrKey, nToken, nNow / AFNetKcpControl::ARK_KCP_COOKIE_PERIOD));
+                mxSocket.SendTo(szData, sizeof(szData), xAddr);
+                break;
+            }
+
+            if (pEntity != nullptr)
+            {
+                //a new client on the address of an old one
+                CloseLink(pEntity, false);
+            }
+
+            OnLinkConnected(xAddr, nToken);
+        }
+        break;
+
+    case AFNetKcpControl::ARK_KCP_CTRL_PING:
+        {
+            if (bMatch)
+            {
+                pEntity->Touch(nNow);
+            }
+        }
+        break;
+
+    case AFNetKcpControl::ARK_KCP_CTRL_FIN:
+        {
+            if (bMatch)
+            {
+                CloseLink(pEntity, false);
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void AFCKcpNetServer::OnLinkConnected(const sockaddr_in& xAddr, const uint32_t nToken)
+{
+    if (mxLinkEntities.size() >= mnMaxConnect)
+    {
+        return;
+    }
+
+    //conv 0 is the one of control datagrams
+    mnNextConv = (mnNextConv + 1 == 0 ? 1 : mnNextConv + 1);
+
+    AFKcpEntityPtr pEntity = ARK_NEW AFKcpEntity(this, AFGUID(0), &mxSocket, xAddr, mnNextConv, nToken);
+    //the id is set before the entity is visible to the broadcasts of logic thread
+    const uint64_t nHandle = mxEntitySlots.Add(pEntity, [pEntity](const uint64_t nNewHandle)
+    {
+        pEntity->SetClientID(AFGUID(0, nNewHandle));
+    });
+
+    if (nHandle == 0)
+    {
+        ARK_DELETE(pEntity);
+        return;
+    }
+
+    mxLinkEntities[pEntity->GetAddrKey()] = pEntity;
+    pEntity->SendControl(AFNetKcpControl::ARK_KCP_CTRL_SYN_ACK);
+
+    AFKcpMsg* pMsg = AFKcpMsg::Create(pEntity);
+    pMsg->xClientID = pEntity->GetClientID();
+    pMsg->nType = CONNECTED;
+
+    pEntity->mxNetMsgMQ.Push(pMsg);
+    AddReadyEntity(pEntity);
+}
+
+void AFCKcpNetServer::CloseLink(AFKcpEntityPtr pEntity, const bool bSendFin)
+{
+    if (bSendFin)
+    {
+        pEntity->SendControl(AFNetKcpControl::ARK_KCP_CTRL_FIN);
+    }
+
+    mxLinkEntities.erase(pEntity->GetAddrKey());
+    pEntity->SetClosed();
+
+    AFKcpMsg* pMsg = AFKcpMsg::Create(pEntity);
+    pMsg->xClientID = pEntity->GetClientID();
+    pMsg->nType = DISCONNECTED;
+
+    pEntity->mxNetMsgMQ.Push(pMsg);
+
+    //the last touch of the entity in io thread, logic thread will delete it
+    AddRemoveEntity(pEntity);
+}
+
+bool AFCKcpNetServer::DismantleNet(AFKcpEntityPtr pEntity)
+{
+    AFBufferChunk* pChunk = nullptr;
+    const char* pData = nullptr;
+    size_t nLen = 0;
+    uint8_t nPeerCaps = 0;
+
+    if (!AFNetFrameCodec::Take(pEntity, IsCompactHead(), IsCompress(), pChunk, pData, nLen, nPeerCaps))
+    {
+        return false;
+    }
+
+    if (pChunk == nullptr)
+    {
+        return true;
+    }
+
+    AFKcpMsg* pNetInfo = AFKcpMsg::Create(pEntity);
+    pNetInfo->nType = RECIVEDATA;
+    pNetInfo->pChunk = pChunk;
+    pNetInfo->pData = pData;
+    pNetInfo->nLen = nLen;
+    pEntity->mxNetMsgMQ.Push(pNetInfo);
+    AddReadyEntity(pEntity);
+
+    return true;
+}
+
+void AFCKcpNetServer::AddReadyEntity(AFKcpEntityPtr pEntity)
+{
+    if (pEntity->MarkReady())
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxReadyLock);
+        mxReadyList.push_back(pEntity);
+    }
+}
+
+void AFCKcpNetServer::AddRemoveEntity(AFKcpEntityPtr pEntity)
+{
+    std::lock_guard<AFSpinLock> xGuard(mxReadyLock);
+    mxRemoveList.push_back(pEntity);
+}
+
+void AFCKcpNetServer::ProcessMsgLogicThread()
+{
+    do
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxReadyLock);
+        mxProcessReadyList.swap(mxReadyList);
+        mxProcessRemoveList.swap(mxRemoveList);
+    } while (0);
+
+    for (auto pEntity : mxProcessReadyList)
+    {
+        //a closed entity in both lists is handled once, with the remove list
+        if (!pEntity->IsClosed())
+        {
+            pEntity->ClearReady();
+            ProcessMsgLogicThread(pEntity);
+        }
+    }
+
+    mxProcessReadyList.clear();
+
+    //io thread never touches the entities in remove list again
+    for (auto pEntity : mxProcessRemoveList)
+    {
+        ProcessMsgLogicThread(pEntity);
+        RemoveNetEntity(pEntity->GetClientID());
+    }
+
+    mxProcessRemoveList.clear();
+}
+
+void AFCKcpNetServer::ProcessMsgLogicThread(AFKcpEntityPtr pEntity)
+{
+    //only the messages already in queue, the io thread keeps pushing
+    size_t nReceiveCount = pEntity->mxNetMsgMQ.Count();
+    AFKcpMsg* xMsgs[AFNetMsgPool<AFKcpMsg>::ARK_NET_MSG_BATCH];
+
+    while (nReceiveCount > 0)
+    {
+        size_t nPopCount = pEntity->mxNetMsgMQ.Pop(xMsgs, std::min<size_t>(nReceiveCount, AFNetMsgPool<AFKcpMsg>::ARK_NET_MSG_BATCH));
+
+        if (nPopCount == 0)
+        {
+            break;
+        }
+
+        nReceiveCount -= nPopCount;
+
+        for (size_t i = 0; i < nPopCount; ++i)
+        {
+            AFKcpMsg* pMsg = xMsgs[i];
+
+            switch (pMsg->nType)
+            {
+            case RECIVEDATA:
+                {
+                    if (mRecvCB)
+                    {
+                        DispatchFrames(pMsg->pData, pMsg->nLen, pEntity->GetClientID(), mRecvCB);
+                    }
+                }
+                break;
+
+            case CONNECTED:
+                mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                break;
+
+            case DISCONNECTED:
+                {
+                    mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                    pEntity->SetNeedRemove(true);
+                }
+                break;
+
+            default:
+                break;
+            }
+
+            AFKcpMsg::Release(pMsg);
+        }
+    }
+}
+
+bool AFCKcpNetServer::SendPacket(AFKcpEntityPtr pEntity, const brynet::net::DataSocket::PACKET_PTR& xPacket)
+{
+    if (pEntity->IsClosed())
+    {
+        return false;
+    }
+
+    //a peer which does not ack is dropped like a slow consumer of tcp, see SetSendWaterMark
+    if (mnSendLimit > 0 && pEntity->GetSendBacklog() + xPacket->size() > mnSendLimit)
+    {
+        pEntity->RequestClose();
+        return false;
+    }
+
+    AFNetStats::RecordSend(GetPacketMsgID(xPacket), xPacket->size());
+
+    if (IsCompactHead())
+    {
+        const brynet::net::DataSocket::PACKET_PTR xCompact = AFNetFrameCodec::PackCompact(xPacket);
+        return pEntity->Send(xCompact->data(), xCompact->size());
+    }
+
+    return pEntity->Send(xPacket->data(), xPacket->size());
+}
+
+bool AFCKcpNetServer::RemoveNetEntity(const AFGUID& xClientID)
+{
+    if (xClientID.nHigh != 0)
+    {
+        return false;
+    }
+
+    AFKcpEntityPtr pEntity = mxEntitySlots.Remove(xClientID.nLow);
+
+    if (pEntity == nullptr)
+    {
+        return false;
+    }
+
+    ARK_DELETE(pEntity);
+    return true;
+}
+
+AFCKcpNetServer::AFKcpEntityPtr AFCKcpNetServer::GetNetEntity(const AFGUID& xClientID)
+{
+    return (xClientID.nHigh == 0 ? mxEntitySlots.Get(xClientID.nLow) : nullptr);
+}
+
+bool AFCKcpNetServer::CloseNetEntity(const AFGUID& xClientID)
+{
+    AFKcpEntityPtr pEntity = GetNetEntity(xClientID);
+
+    if (pEntity != nullptr)
+    {
+        pEntity->RequestClose();
+    }
+
+    return true;
+}
+
+void AFCKcpNetServer::GetSessionStats(std::vector<AFNetSessionStat>& xList)
+{
+    xList.reserve(mxEntitySlots.Count());
+
+    mxEntitySlots.ForEach([&xList](AFKcpEntityPtr pEntity)
+    {
+        AFNetSessionStat xStat;
+        xStat.xClientID = pEntity->GetClientID();
+        xStat.nRecvQueue = pEntity->mxNetMsgMQ.Count();
+        xStat.nSendBacklog = pEntity->GetSendBacklog();
+        xList.push_back(xStat);
+    });
+}
+
+bool AFCKcpNetServer::SendMsgWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID)
+{
+    AFCMsgHead xHead;
+    xHead.SetMsgID(nMsgID);
+    xHead.SetPlayerID(xPlayerID);
+    xHead.SetBodyLength(nLen);
+
+    return SendMsgPacket(AFNetPacketPool::GetInstance().EnCode(xHead, msg, nLen), xClientID);
+}
+
+bool AFCKcpNetServer::SendMsgToAllClientWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xPlayerID)
+{
+    AFCMsgHead xHead;
+    xHead.SetMsgID(nMsgID);
+    xHead.SetPlayerID(xPlayerID);
+    xHead.SetBodyLength(nLen);
+
+    return SendMsgPacketToAllClient(AFNetPacketPool::GetInstance().EnCode(xHead, msg, nLen));
+}
+
+bool AFCKcpNetServer::SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID)
+{
+    AFKcpEntityPtr pEntity = GetNetEntity(xClientID);
+
+    if (pEntity == nullptr)
+    {
+        return false;
+    }
+
+    return SendPacket(pEntity, xPacket);
+}
+
+bool AFCKcpNetServer::SendMsgPacketToAllClient(const brynet::net::DataSocket::PACKET_PTR& xPacket)
+{
+    mxEntitySlots.ForEach([this, &xPacket](AFKcpEntityPtr pEntity)
+    {
+        SendPacket(pEntity, xPacket);
+    });
+
+    return true;
+}
+
+bool AFCKcpNetServer::SendMsgPacketToClientList(const brynet::net::DataSocket::PACKET_PTR& xPacket, const std::vector<AFGUID>& xClientIDList)
+{
+    for (const auto& xClientID : xClientIDList)
+    {
+        AFKcpEntityPtr pEntity = GetNetEntity(xClientID);
+
+        if (pEntity != nullptr)
+        {
+            SendPacket(pEntity, xPacket);
+        }
+    }
+
+    return true;
+}
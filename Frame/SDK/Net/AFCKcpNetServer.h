@@ -0,0 +1,129 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "AFINet.h"
+#include "AFNetUdp.hpp"
+#include "AFNetSlotMap.hpp"
+#include "SDK/Core/AFSpinLock.hpp"
+
+//Server of reliable udp links, for realtime traffic where the head of line blocking of tcp hurts on lossy links.
+//One io thread owns the socket: it reads the datagrams, feeds the kcp of the links and drives their timers.
+//The frames and events reach the logic thread in Update like the ones of AFCNetServer.
+//Cork, bulk lanes and compression are not used on these links, the compact head is.
+class AFCKcpNetServer : public AFINet
+{
+public:
+    using AFKcpEntityPtr = AFKcpEntity*;
+
+    AFCKcpNetServer()
+        : mnMaxConnect(0)
+        , mnServerID(0)
+        , mnNextConv(0)
+        , mbRunning(false)
+    {
+    }
+
+    template<typename BaseType>
+    AFCKcpNetServer(BaseType* pBaseType, void (BaseType::*handleRecieve)(const AFIMsgHead& xHead, const int, const char*, const size_t, const AFGUID&), void (BaseType::*handleEvent)(const NetEventType, const AFGUID&, const int))
+        : mnMaxConnect(0)
+        , mnServerID(0)
+        , mnNextConv(0)
+        , mbRunning(false)
+    {
+        mRecvCB = std::bind(handleRecieve, pBaseType, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5);
+        mEventCB = std::bind(handleEvent, pBaseType, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+        SetWorking(false);
+    }
+
+    virtual ~AFCKcpNetServer()
+    {
+        Final();
+    }
+
+    virtual void Update();
+
+    //nThreadCount is not used, one io thread serves all the links
+    virtual int Start(const unsigned int nMaxClient, const std::string& strAddrPort, const int nServerID, const int nThreadCount);
+    virtual bool Final() final;
+    virtual bool IsServer()
+    {
+        return true;
+    }
+
+    virtual bool SendMsgWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID);
+    virtual bool SendMsgToAllClientWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xPlayerID);
+    virtual bool SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID);
+    virtual bool SendMsgPacketToAllClient(const brynet::net::DataSocket::PACKET_PTR& xPacket);
+    virtual bool SendMsgPacketToClientList(const brynet::net::DataSocket::PACKET_PTR& xPacket, const std::vector<AFGUID>& xClientIDList);
+
+    virtual bool CloseNetEntity(const AFGUID& xClientID);
+    virtual void GetSessionStats(std::vector<AFNetSessionStat>& xList);
+    virtual bool Log(int severity, const char* msg)
+    {
+        return true;
+    };
+
+private:
+    //io thread
+    void Run();
+    void OnDatagram(const char* pData, const size_t nLen, const sockaddr_in& xAddr, const uint32_t nNow);
+    void OnControl(const char* pData, const size_t nLen, const sockaddr_in& xAddr, const uint32_t nNow);
+    void OnLinkConnected(const sockaddr_in& xAddr, const uint32_t nToken);
+    void CloseLink(AFKcpEntityPtr pEntity, const bool bSendFin);
+    bool DismantleNet(AFKcpEntityPtr pEntity);
+    void AddReadyEntity(AFKcpEntityPtr pEntity);
+    void AddRemoveEntity(AFKcpEntityPtr pEntity);
+
+    //logic thread
+    bool SendPacket(AFKcpEntityPtr pEntity, const brynet::net::DataSocket::PACKET_PTR& xPacket);
+    bool RemoveNetEntity(const AFGUID& xClientID);
+    AFKcpEntityPtr GetNetEntity(const AFGUID& xClientID);
+    void ProcessMsgLogicThread();
+    void ProcessMsgLogicThread(AFKcpEntityPtr pEntity);
+
+private:
+    //connection id is AFGUID(0, slot handle) like AFCNetServer. Entities are added by io thread, removed by logic thread
+    AFNetSlotMap<AFKcpEntity> mxEntitySlots;
+
+    //open links by peer address, only used by io thread
+    std::unordered_map<uint64_t, AFKcpEntityPtr> mxLinkEntities;
+
+    //entities with new messages and closed entities, filled by io thread
+    AFSpinLock mxReadyLock;
+    std::vector<AFKcpEntityPtr> mxReadyList;
+    std::vector<AFKcpEntityPtr> mxRemoveList;
+    //only used by logic thread, swapped with the lists above every update
+    std::vector<AFKcpEntityPtr> mxProcessReadyList;
+    std::vector<AFKcpEntityPtr> mxProcessRemoveList;
+
+    unsigned int mnMaxConnect;
+    int mnServerID;
+    uint32_t mnNextConv;
+    uint64_t mnCookieSecret{ 0 }; //set by Start, keys the cookies of SYN
+
+    NET_RECEIVE_FUNCTOR mRecvCB;
+    NET_EVENT_FUNCTOR mEventCB;
+
+    AFNetUdpSocket mxSocket;
+    std::atomic<bool> mbRunning;
+    std::thread mxThread;
+};
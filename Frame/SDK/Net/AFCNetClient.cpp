@@ -18,12 +18,14 @@
 *
 */
 
-#include <brynet/net/SyncConnector.h>
 #include "AFCNetClient.h"
 
 void AFCNetClient::Update()
 {
     ProcessMsgLogicThread();
+    ProcessConnect();
+    Flush();
+    UpdateStats();
 }
 
 void AFCNetClient::ProcessMsgLogicThread()
@@ -49,49 +51,61 @@ void AFCNetClient::ProcessMsgLogicThread(AFTCPEntity* pEntity)
         return;
     }
 
+    //only handle the messages already in queue, the worker thread keeps pushing
     size_t nReceiveCount = pEntity->mxNetMsgMQ.Count();
+    AFTCPMsg* xMsgs[AFNetMsgPool<AFTCPMsg>::ARK_NET_MSG_BATCH];
 
-    for (size_t i = 0; i < nReceiveCount; ++i)
+    while (nReceiveCount > 0)
     {
-        AFTCPMsg* pMsg(nullptr);
+        size_t nPopCount = pEntity->mxNetMsgMQ.Pop(xMsgs, std::min<size_t>(nReceiveCount, AFNetMsgPool<AFTCPMsg>::ARK_NET_MSG_BATCH));
 
-        if (!pEntity->mxNetMsgMQ.Pop(pMsg))
+        if (nPopCount == 0)
         {
             break;
         }
 
-        if (pMsg == nullptr)
-        {
-            continue;
-        }
+        nReceiveCount -= nPopCount;
 
-        switch (pMsg->nType)
+        for (size_t i = 0; i < nPopCount; ++i)
         {
-        case RECIVEDATA:
+            AFTCPMsg* pMsg = xMsgs[i];
+
+            switch (pMsg->nType)
             {
-                if (mRecvCB)
+            case RECIVEDATA:
                 {
-                    mRecvCB(pMsg->xHead, pMsg->xHead.GetMsgID(), pMsg->strMsg.c_str(), pMsg->strMsg.size(), pEntity->GetClientID());
+                    if (mRecvCB)
+                    {
+                        DispatchFrames(pMsg->pData, pMsg->nLen, pEntity->GetClientID(), mRecvCB);
+                    }
                 }
-            }
-            break;
+                break;
 
-        case CONNECTED:
-            mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
-            break;
+            case CONNECTED:
+                {
+                    mnConnectFailCount = 0;
+                    mnConnectState = ARK_NET_CONNECT_CONNECTED;
+                    mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                }
+                break;
 
-        case DISCONNECTED:
-            {
-                mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
-                pEntity->SetNeedRemove(true);
+            case DISCONNECTED:
+                {
+                    mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                    pEntity->SetNeedRemove(true);
+
+                    //the entity goes away in this update, ProcessConnect schedules the reconnect after
+                    int nState = ARK_NET_CONNECT_CONNECTED;
+                    mnConnectState.compare_exchange_strong(nState, ARK_NET_CONNECT_FAILED);
+                }
+                break;
+
+            default:
+                break;
             }
-            break;
 
-        default:
-            break;
+            AFTCPMsg::Release(pMsg);
         }
-
-        delete pMsg;
     }
 }
 
@@ -99,33 +113,91 @@ void AFCNetClient::ProcessMsgLogicThread(AFTCPEntity* pEntity)
 void AFCNetClient::Start(const std::string& strAddrPort, const int nServerID)
 {
     mnServerID = nServerID;
+    mstrIPPort = strAddrPort;
+    SplitHostPort(strAddrPort, mstrIP, mnPort);
+
     m_pServer->startWorkThread(1);
     m_pConector->startWorkerThread();
+    SetWorking(true);
 
-    std::string strIp;
-    int nPort(0);
-    const int nTimeOut(20);
+    Connect();
+}
 
-    SplitHostPort(strAddrPort, strIp, nPort);
-    brynet::net::TcpSocket::PTR SocketPtr = brynet::net::SyncConnectSocket(strIp, nPort, std::chrono::milliseconds(nTimeOut), m_pConector);
+void AFCNetClient::SetReconnect(const bool bReconnect, const int64_t nMinDelay, const int64_t nMaxDelay)
+{
+    mbReconnect = bReconnect;
+    mnReconnectMinDelay = std::max<int64_t>(nMinDelay, 1);
+    mnReconnectMaxDelay = std::max<int64_t>(nMaxDelay, mnReconnectMinDelay);
+}
 
-    if (SocketPtr == nullptr)
-    {
-        return;
-    }
+void AFCNetClient::Connect()
+{
+    mnConnectState = ARK_NET_CONNECT_PENDING;
 
-    CONSOLE_LOG_NO_FILE << "connect success" << std::endl;
-    SocketPtr->SocketNodelay();
+    //both callbacks run in the connector thread, the session enters in the service thread and pushes CONNECTED
     auto enterCallback = std::bind(&AFCNetClient::OnClientConnectionInner, this, std::placeholders::_1);
 
-    m_pServer->addSession(std::move(SocketPtr),
-                          brynet::net::AddSessionOption::WithEnterCallback(enterCallback),
-                          brynet::net::AddSessionOption::WithMaxRecvBufferSize(1024 * 1024));
-    SetWorking(true);
+    m_pConector->asyncConnect(mstrIP, mnPort, std::chrono::milliseconds(ARK_NET_CONNECT_TIMEOUT),
+                              [this, enterCallback](brynet::net::TcpSocket::PTR SocketPtr)
+    {
+        SocketPtr->SocketNodelay();
+
+        if (!m_pServer->addSession(std::move(SocketPtr),
+                                   brynet::net::AddSessionOption::WithEnterCallback(enterCallback),
+                                   brynet::net::AddSessionOption::WithMaxRecvBufferSize(1024 * 1024)))
+        {
+            mnConnectState = ARK_NET_CONNECT_FAILED;
+        }
+    },
+    [this]()
+    {
+        mnConnectState = ARK_NET_CONNECT_FAILED;
+    });
+}
+
+void AFCNetClient::ProcessConnect()
+{
+    switch (mnConnectState.load())
+    {
+    case ARK_NET_CONNECT_FAILED:
+        {
+            if (!mbReconnect)
+            {
+                CONSOLE_LOG_NO_FILE << "connect " << mstrIPPort << " failed" << std::endl;
+                mnConnectState = ARK_NET_CONNECT_IDLE;
+                break;
+            }
+
+            //exponential backoff, the half of the delay is random
+            const int nShift = std::min(mnConnectFailCount, 20);
+            const int64_t nDelay = std::min<int64_t>(mnReconnectMinDelay << nShift, mnReconnectMaxDelay);
+            const int64_t nJitterDelay = nDelay / 2 + std::uniform_int_distribution<int64_t>(0, nDelay - nDelay / 2)(mxRandom);
+
+            ++mnConnectFailCount;
+            mnNextConnectTime = GetCorkTime() + nJitterDelay;
+            mnConnectState = ARK_NET_CONNECT_WAITING;
+            CONSOLE_LOG_NO_FILE << "connect " << mstrIPPort << " failed, try again in " << nJitterDelay << "ms" << std::endl;
+        }
+        break;
+
+    case ARK_NET_CONNECT_WAITING:
+        {
+            if (GetCorkTime() >= mnNextConnectTime)
+            {
+                Connect();
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
 }
 
 bool AFCNetClient::Final()
 {
+    mbReconnect = false;
+
     if (!CloseSocketAll())
     {
         //add log
@@ -157,6 +229,61 @@ bool AFCNetClient::SendMsg(const char* msg, const size_t nLen, const AFGUID& xCl
     return true;
 }
 
+bool AFCNetClient::SendMsg(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClient)
+{
+    if (nullptr == m_pClientEntity || !m_pClientEntity->GetSession())
+    {
+        return true;
+    }
+
+    AFNetStats::RecordSend(GetPacketMsgID(xPacket), xPacket->size());
+
+    if (!mbCork)
+    {
+        m_pClientEntity->Send(xPacket);
+        return true;
+    }
+
+    const int64_t nNow = GetCorkTime();
+    AFNetCorkBuffer& xCorkBuffer = m_pClientEntity->mxCorkBuffer;
+    xCorkBuffer.Add(xPacket, nNow);
+    ++mxCorkStats.nMsgCount;
+
+    if (xCorkBuffer.GetBytes() >= mnCorkFlushBytes || nNow - xCorkBuffer.GetFirstTime() >= mnCorkMaxDelay)
+    {
+        Flush();
+    }
+
+    return true;
+}
+
+void AFCNetClient::Flush()
+{
+    if (nullptr == m_pClientEntity || m_pClientEntity->mxCorkBuffer.Empty())
+    {
+        return;
+    }
+
+    mxCorkStats.nSendCount += m_pClientEntity->mxCorkBuffer.Flush(m_pClientEntity);
+    ++mxCorkStats.nFlushCount;
+}
+
+void AFCNetClient::GetSessionStats(std::vector<AFNetSessionStat>& xList)
+{
+    AFScopeRdLock xGuard(mRWLock);
+
+    if (nullptr == m_pClientEntity)
+    {
+        return;
+    }
+
+    AFNetSessionStat xStat;
+    xStat.xClientID = m_pClientEntity->GetClientID();
+    xStat.nRecvQueue = m_pClientEntity->mxNetMsgMQ.Count();
+    xStat.nSendBacklog = m_pClientEntity->GetSendBacklog();
+    xList.push_back(xStat);
+}
+
 bool AFCNetClient::CloseNetEntity(const AFGUID& xClient)
 {
     if (nullptr != m_pClientEntity && m_pClientEntity->GetClientID() == xClient)
@@ -169,26 +296,35 @@ bool AFCNetClient::CloseNetEntity(const AFGUID& xClient)
 
 bool AFCNetClient::DismantleNet(AFTCPEntity* pEntity)
 {
-    while (pEntity->GetBuffLen() >= AFIMsgHead::ARK_MSG_HEAD_LENGTH)
+    //plain whole frames go to the logic thread in one slice of the receive block, without copy
+    AFBufferChunk* pChunk = nullptr;
+    const char* pData = nullptr;
+    size_t nLen = 0;
+    uint8_t nPeerCaps = 0;
+
+    if (!AFNetFrameCodec::Take(pEntity, IsCompactHead(), IsCompress() || pEntity->IsPeerCompress(), pChunk, pData, nLen, nPeerCaps))
     {
-        AFCMsgHead xHead;
-        int nMsgBodyLength = DeCode(pEntity->GetBuff(), pEntity->GetBuffLen(), xHead);
+        pEntity->GetSession()->postDisConnect();
+        return false;
+    }
 
-        if (nMsgBodyLength >= 0 && xHead.GetMsgID() > 0)
-        {
-            AFTCPMsg* pMsg = ARK_NEW AFTCPMsg(pEntity->GetSession());
-            pMsg->xHead = xHead;
-            pMsg->nType = RECIVEDATA;
-            pMsg->strMsg.append(pEntity->GetBuff() + AFIMsgHead::ARK_MSG_HEAD_LENGTH, nMsgBodyLength);
-            pEntity->mxNetMsgMQ.Push(pMsg);
-            pEntity->RemoveBuff(nMsgBodyLength + AFIMsgHead::ARK_MSG_HEAD_LENGTH);
-        }
-        else
-        {
-            break;
-        }
+    if ((nPeerCaps & AFNetCompress::ARK_NET_CAPS_LZ4) != 0 && IsCompress())
+    {
+        pEntity->SetPeerCompress(true);
     }
 
+    if (pChunk == nullptr)
+    {
+        return true;
+    }
+
+    AFTCPMsg* pMsg = AFTCPMsg::Create(pEntity->GetSession());
+    pMsg->nType = RECIVEDATA;
+    pMsg->pChunk = pChunk;
+    pMsg->pData = pData;
+    pMsg->nLen = nLen;
+    pEntity->mxNetMsgMQ.Push(pMsg);
+
     return true;
 }
 
@@ -213,7 +349,11 @@ void AFCNetClient::OnClientConnectionInner(const brynet::net::TCPSession::PTR& s
     session->setDataCallback(std::bind(&AFCNetClient::OnMessageInner, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     session->setDisConnectCallback(std::bind(&AFCNetClient::OnClientDisConnectionInner, this, std::placeholders::_1));
 
-    AFTCPMsg* pMsg = new AFTCPMsg(session);
+    CONSOLE_LOG_NO_FILE << "connect " << mstrIPPort << " success" << std::endl;
+
+    //the link id carries the server id, so the receivers can tell the servers of one client module apart
+    AFTCPMsg* pMsg = AFTCPMsg::Create(session);
+    pMsg->xClientID.nHigh = mnServerID;
     pMsg->xClientID.nLow = (++mnNextID);
     session->setUD(static_cast<int64_t>(pMsg->xClientID.nLow));
     pMsg->nType = CONNECTED;
@@ -226,14 +366,20 @@ void AFCNetClient::OnClientConnectionInner(const brynet::net::TCPSession::PTR& s
         m_pClientEntity.reset(pEntity);
         pEntity->mxNetMsgMQ.Push(pMsg);
     } while (0);
+
+    //the server answers with its caps when it compresses too
+    if (IsCompress())
+    {
+        session->send(IsCompactHead() ? AFNetFrameCodec::PackCompact(AFNetCompress::MakeCapsFrame()) : AFNetCompress::MakeCapsFrame());
+    }
 }
 
 void AFCNetClient::OnClientDisConnectionInner(const brynet::net::TCPSession::PTR& session)
 {
     const auto ud = brynet::net::cast<brynet::net::TcpService::SESSION_TYPE>(session->getUD());
-    AFGUID xClient(0, *ud);
+    AFGUID xClient(mnServerID, *ud);
 
-    AFTCPMsg* pMsg = new AFTCPMsg(session);
+    AFTCPMsg* pMsg = AFTCPMsg::Create(session);
     pMsg->xClientID = xClient;
     pMsg->nType = DISCONNECTED;
 
@@ -247,7 +393,7 @@ void AFCNetClient::OnClientDisConnectionInner(const brynet::net::TCPSession::PTR
 size_t AFCNetClient::OnMessageInner(const brynet::net::TCPSession::PTR& session, const char* buffer, size_t len)
 {
     const auto ud = brynet::net::cast<brynet::net::TcpService::SESSION_TYPE>(session->getUD());
-    AFGUID xClient(0, *ud);
+    AFGUID xClient(mnServerID, *ud);
 
     AFScopeRdLock xGuard(mRWLock);
 
@@ -262,22 +408,64 @@ size_t AFCNetClient::OnMessageInner(const brynet::net::TCPSession::PTR& session,
 
 bool AFCNetClient::SendMsgWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID)
 {
-    std::string strOutData;
     AFCMsgHead xHead;
     xHead.SetMsgID(nMsgID);
     xHead.SetPlayerID(xPlayerID);
     xHead.SetBodyLength(nLen);
 
-    int nAllLen = EnCode(xHead, msg, nLen, strOutData);
+    //head and body go to one pooled packet, and the session queues it without copy
+    return SendMsg(AFNetPacketPool::GetInstance().EnCode(xHead, msg, nLen), xClientID);
+}
 
-    if (nAllLen == nLen + AFIMsgHead::ARK_MSG_HEAD_LENGTH)
+bool AFCNetClient::SendMsgFrame(const AFIMsgHead& xHead, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID)
+{
+    if (nullptr == m_pClientEntity || !m_pClientEntity->GetSession())
     {
-        return SendMsg(strOutData.c_str(), strOutData.length(), xClientID);
+        return true;
     }
-    else
+
+    const char* pFrame = msg - AFIMsgHead::ARK_MSG_HEAD_LENGTH;
+    const size_t nFrameLen = AFIMsgHead::ARK_MSG_HEAD_LENGTH + nLen;
+    AFNetStats::RecordSend(xHead.GetMsgID(), nFrameLen);
+
+    AFCMsgHead xNewHead;
+    xNewHead.SetPlayerID(xPlayerID);
+
+    if (!mbCork)
     {
-        return false;
+        brynet::net::DataSocket::PACKET_PTR xPacket = AFNetPacketPool::GetInstance().Alloc(nFrameLen);
+        xPacket->assign(pFrame, nFrameLen);
+
+        if (xPlayerID != xHead.GetPlayerID())
+        {
+            xNewHead.EnCodePlayerID(&(*xPacket)[0]);
+        }
+
+        m_pClientEntity->Send(xPacket);
+        return true;
+    }
+
+    const int64_t nNow = GetCorkTime();
+    AFNetCorkBuffer& xCorkBuffer = m_pClientEntity->mxCorkBuffer;
+    char* pData = xCorkBuffer.Append(pFrame, nFrameLen, nNow);
+    ++mxCorkStats.nMsgCount;
+
+    if (xPlayerID != xHead.GetPlayerID())
+    {
+        xNewHead.EnCodePlayerID(pData);
+    }
+
+    if (xCorkBuffer.GetBytes() >= mnCorkFlushBytes || nNow - xCorkBuffer.GetFirstTime() >= mnCorkMaxDelay)
+    {
+        Flush();
     }
+
+    return true;
+}
+
+bool AFCNetClient::SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID)
+{
+    return SendMsg(xPacket, xClientID);
 }
 
 int AFCNetClient::EnCode(const AFCMsgHead& xHead, const char* strData, const size_t len, std::string& strOutData)
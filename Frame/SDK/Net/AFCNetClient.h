@@ -27,7 +27,15 @@
 #include <brynet/net/WrapTCPService.h>
 #include <brynet/net/Connector.h>
 
-#pragma pack(push, 1)
+//connect state of AFCNetClient, the connector thread moves PENDING to FAILED, the rest is moved by logic thread
+enum AFNetConnectState
+{
+    ARK_NET_CONNECT_IDLE = 0,       //not started, or failed without reconnect
+    ARK_NET_CONNECT_PENDING = 1,    //connect in flight
+    ARK_NET_CONNECT_FAILED = 2,     //connect failed or link lost, the next try is not scheduled yet
+    ARK_NET_CONNECT_WAITING = 3,    //waiting for the backoff delay of the next try
+    ARK_NET_CONNECT_CONNECTED = 4,
+};
 
 class AFCNetClient : public AFINet
 {
@@ -65,29 +73,59 @@ public:
         m_pConector = brynet::net::AsyncConnector::Create();
     }
 
+    enum
+    {
+        ARK_NET_CONNECT_TIMEOUT = 3000,         //ms
+        ARK_NET_RECONNECT_MIN_DELAY = 100,      //ms
+        ARK_NET_RECONNECT_MAX_DELAY = 5000,     //ms
+    };
+
     virtual ~AFCNetClient()
     {
         Final();
     }
 
     virtual void Update();
+    //returns at once, the connect goes on in the connector thread and CONNECTED comes in Update
     virtual void Start(const std::string& strAddrPort, const int nServerID);
     virtual bool Final() final;
     virtual bool SendMsgWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID = 0, const AFGUID& xPlayerID = 0);
+    virtual bool SendMsgFrame(const AFIMsgHead& xHead, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID);
+    virtual bool SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID = 0);
 
     virtual bool CloseNetEntity(const AFGUID& xClient);
+    virtual void Flush();
+    virtual void GetSessionStats(std::vector<AFNetSessionStat>& xList);
 
     virtual bool IsServer();
     virtual bool Log(int severity, const char* msg);
 
+    //call before Start. A failed connect or a lost link is tried again after a delay,
+    //doubled every failure from nMinDelay up to nMaxDelay ms and randomized in [delay / 2, delay] so the clients of a restarted server spread out
+    void SetReconnect(const bool bReconnect, const int64_t nMinDelay = ARK_NET_RECONNECT_MIN_DELAY, const int64_t nMaxDelay = ARK_NET_RECONNECT_MAX_DELAY);
+
+    AFNetConnectState GetConnectState() const
+    {
+        return (AFNetConnectState)mnConnectState.load();
+    }
+
+    //failed tries since the last connected one
+    int GetConnectFailCount() const
+    {
+        return mnConnectFailCount;
+    }
+
     void OnClientConnectionInner(const brynet::net::TCPSession::PTR& session);
     void OnClientDisConnectionInner(const brynet::net::TCPSession::PTR& session);
     size_t OnMessageInner(const brynet::net::TCPSession::PTR& session, const char* buffer, size_t len);
 
 private:
     bool SendMsg(const char* msg, const size_t nLen, const AFGUID& xClient = 0);
+    bool SendMsg(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClient = 0);
 
     bool DismantleNet(AFTCPEntity* pEntity);
+    void Connect();
+    void ProcessConnect();
     void ProcessMsgLogicThread();
     void ProcessMsgLogicThread(AFTCPEntity* pEntity);
     bool CloseSocketAll();
@@ -101,9 +139,19 @@ protected:
 private:
     std::unique_ptr<AFTCPEntity> m_pClientEntity{ nullptr };
     std::string mstrIPPort{ "" };
+    std::string mstrIP{ "" };
+    int mnPort{ 0 };
     int mnServerID{ 0 };
     std::atomic<uint64_t> mnNextID{ 0 };
 
+    std::atomic<int> mnConnectState{ ARK_NET_CONNECT_IDLE };
+    bool mbReconnect{ false };
+    int64_t mnReconnectMinDelay{ ARK_NET_RECONNECT_MIN_DELAY };
+    int64_t mnReconnectMaxDelay{ ARK_NET_RECONNECT_MAX_DELAY };
+    int mnConnectFailCount{ 0 };
+    int64_t mnNextConnectTime{ 0 };
+    std::mt19937 mxRandom{ std::random_device {}() };
+
     NET_RECEIVE_FUNCTOR mRecvCB;
     NET_EVENT_FUNCTOR mEventCB;
     AFCReaderWriterLock mRWLock;
@@ -111,6 +159,4 @@ private:
     brynet::net::WrapTcpService::PTR m_pServer{ nullptr };
     brynet::net::AsyncConnector::PTR m_pConector{ nullptr };
     //brynet::net::TCPSession::PTR m_Session = nullptr; //will delete
-};
-
-#pragma pack(pop)
\ No newline at end of file
+};
\ No newline at end of file
@@ -35,6 +35,10 @@
 void AFCNetServer::Update()
 {
     ProcessMsgLogicThread();
+    Flush();
+    PumpBulk();
+    ProcessSendLowWater();
+    UpdateStats();
 }
 
 int AFCNetServer::Start(const unsigned int nMaxClient, const std::string& strAddrPort, const int nServerID, const int nThreadCount)
@@ -42,13 +46,79 @@ int AFCNetServer::Start(const unsigned int nMaxClient, const std::string& strAdd
     std::string strHost;
     int port;
     SplitHostPort(strAddrPort, strHost, port);
-    m_plistenThread->startListen(false, strHost, port, std::bind(&AFCNetServer::OnAcceptConnectionInner, this, std::placeholders::_1));
 
-    m_pServer->startWorkThread(nThreadCount);
+    if (mnListenerCount <= 1 || !StartReusePort(strHost, port, nThreadCount))
+    {
+        m_plistenThread->startListen(false, strHost, port, std::bind(static_cast<void (AFCNetServer::*)(brynet::net::TcpSocket::PTR)>(&AFCNetServer::OnAcceptConnectionInner), this, std::placeholders::_1));
+        m_pServer->startWorkThread(nThreadCount);
+    }
+
     SetWorking(true);
     return 0;
 }
 
+bool AFCNetServer::StartReusePort(const std::string& strHost, const int nPort, const int nThreadCount)
+{
+    if (!AFNetAcceptor::IsReusePortSupported())
+    {
+        return false;
+    }
+
+    //the worker threads are split between the listeners, at least one for every listener
+    const int nShardThread = std::max(1, nThreadCount / mnListenerCount);
+
+    for (int i = 0; i < mnListenerCount; ++i)
+    {
+        const int nCpuIndex = (mbBindCpu ? i % AFNetAcceptor::GetCpuCount() : -1);
+
+        brynet::net::WrapTcpService::PTR pServer = std::make_shared<brynet::net::WrapTcpService>();
+        pServer->startWorkThread(nShardThread, [nCpuIndex](const brynet::net::EventLoop::PTR&)
+        {
+            //called every loop of worker thread, bind once
+            static thread_local bool bBound = false;
+
+            if (!bBound)
+            {
+                bBound = true;
+                AFNetAcceptor::BindCpu(nCpuIndex);
+            }
+        });
+        mxShardServerList.push_back(pServer);
+
+        std::unique_ptr<AFNetAcceptor> pAcceptor(new AFNetAcceptor());
+        bool bRet = pAcceptor->Start(strHost, nPort, nCpuIndex, [this, pServer](int fd)
+        {
+            OnAcceptConnectionInner(pServer, brynet::net::TcpSocket::Create(fd, true));
+        });
+
+        if (!bRet)
+        {
+            StopReusePort();
+            return false;
+        }
+
+        mxAcceptorList.push_back(std::move(pAcceptor));
+    }
+
+    return true;
+}
+
+void AFCNetServer::StopReusePort()
+{
+    for (auto& pAcceptor : mxAcceptorList)
+    {
+        pAcceptor->Stop();
+    }
+
+    for (auto& pServer : mxShardServerList)
+    {
+        pServer->stopWorkThread();
+    }
+
+    mxAcceptorList.clear();
+    mxShardServerList.clear();
+}
+
 
 size_t AFCNetServer::OnMessageInner(const brynet::net::TCPSession::PTR& session, const char* buffer, size_t len)
 {
@@ -65,9 +135,14 @@ size_t AFCNetServer::OnMessageInner(const brynet::net::TCPSession::PTR& session,
 }
 
 void AFCNetServer::OnAcceptConnectionInner(brynet::net::TcpSocket::PTR socket)
+{
+    OnAcceptConnectionInner(m_pServer, std::move(socket));
+}
+
+void AFCNetServer::OnAcceptConnectionInner(const brynet::net::WrapTcpService::PTR& pServer, brynet::net::TcpSocket::PTR socket)
 {
     socket->SocketNodelay();
-    m_pServer->addSession(std::move(socket),
+    pServer->addSession(std::move(socket),
                           brynet::net::AddSessionOption::WithEnterCallback(std::bind(&AFCNetServer::OnClientConnectionInner, this, std::placeholders::_1)),
                           brynet::net::AddSessionOption::WithMaxRecvBufferSize(1024 * 1024));
 }
@@ -77,22 +152,28 @@ void AFCNetServer::OnClientConnectionInner(const brynet::net::TCPSession::PTR& s
     session->setDataCallback(std::bind(&AFCNetServer::OnMessageInner, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     session->setDisConnectCallback(std::bind(&AFCNetServer::OnClientDisConnectionInner, this, std::placeholders::_1));
 
-    AFTCPMsg* pMsg = new AFTCPMsg(session);
-    pMsg->xClientID.nLow = mnNextID++;
-    pMsg->nType = CONNECTED;
+    AFTCPEntityPtr pEntity = ARK_NEW AFTCPEntity(this, AFGUID(0), session);
+    //the id is set before the entity is visible to the broadcasts of logic thread
+    const uint64_t nHandle = mxEntitySlots.Add(pEntity, [pEntity](const uint64_t nNewHandle)
+    {
+        pEntity->SetClientID(AFGUID(0, nNewHandle));
+    });
 
-    do
+    if (nHandle == 0)
     {
-        AFScopeWrLock xGuard(mRWLock);
+        ARK_DELETE(pEntity);
+        session->postDisConnect();
+        return;
+    }
 
-        AFTCPEntityPtr pEntity = ARK_NEW AFTCPEntity(this, pMsg->xClientID, session);
-        session->setUD(int64_t(pEntity));
+    session->setUD(int64_t(pEntity));
 
-        if (AddNetEntity(pMsg->xClientID, pEntity))
-        {
-            pEntity->mxNetMsgMQ.Push(pMsg);
-        }
-    } while (0);
+    AFTCPMsg* pMsg = AFTCPMsg::Create(session);
+    pMsg->xClientID = pEntity->GetClientID();
+    pMsg->nType = CONNECTED;
+
+    pEntity->mxNetMsgMQ.Push(pMsg);
+    AddReadyEntity(pEntity);
 }
 
 void AFCNetServer::OnClientDisConnectionInner(const brynet::net::TCPSession::PTR& session)
@@ -105,115 +186,134 @@ void AFCNetServer::OnClientDisConnectionInner(const brynet::net::TCPSession::PTR
     }
 
     const AFTCPEntityPtr pEntity = (AFTCPEntityPtr) * pUD;
-    AFTCPMsg* pMsg = new AFTCPMsg(session);
+    AFTCPMsg* pMsg = AFTCPMsg::Create(session);
     pMsg->xClientID = pEntity->GetClientID();
     pMsg->nType = DISCONNECTED;
 
     pEntity->mxNetMsgMQ.Push(pMsg);
+
+    //the last touch of the entity in worker thread, logic thread will delete it
+    AddRemoveEntity(pEntity);
 }
 
-void AFCNetServer::ProcessMsgLogicThread()
+void AFCNetServer::AddReadyEntity(AFTCPEntityPtr pEntity)
+{
+    if (pEntity->MarkReady())
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxReadyLock);
+        mxReadyList.push_back(pEntity);
+    }
+}
+
+void AFCNetServer::AddRemoveEntity(AFTCPEntityPtr pEntity)
 {
-    std::list<AFGUID> xNeedRemoveList;
+    std::lock_guard<AFSpinLock> xGuard(mxReadyLock);
+    mxRemoveList.push_back(pEntity);
+}
 
+void AFCNetServer::ProcessMsgLogicThread()
+{
     do
     {
-        AFScopeRdLock xGuard(mRWLock);
-
-        for (std::map<AFGUID, AFTCPEntityPtr>::iterator iter = mmObject.begin(); iter != mmObject.end(); ++iter)
-        {
-            ProcessMsgLogicThread(iter->second);
+        std::lock_guard<AFSpinLock> xGuard(mxReadyLock);
+        mxProcessReadyList.swap(mxReadyList);
+        mxProcessRemoveList.swap(mxRemoveList);
+    } while (0);
 
-            if (!iter->second->NeedRemove())
-            {
-                continue;
-            }
+    //only visit the entities which have messages
+    for (auto pEntity : mxProcessReadyList)
+    {
+        pEntity->ClearReady();
+        ProcessMsgLogicThread(pEntity);
+    }
 
-            xNeedRemoveList.push_back(iter->second->GetClientID());
-        }
-    } while (0);
+    mxProcessReadyList.clear();
 
-    for (std::list<AFGUID>::iterator iter = xNeedRemoveList.begin(); iter != xNeedRemoveList.end(); ++iter)
+    //worker threads never touch the entities in remove list again
+    for (auto pEntity : mxProcessRemoveList)
     {
-        AFScopeWrLock xGuard(mRWLock);
-        RemoveNetEntity(*iter);
+        ProcessMsgLogicThread(pEntity);
+        RemoveNetEntity(pEntity->GetClientID());
     }
+
+    mxProcessRemoveList.clear();
 }
 
 void AFCNetServer::ProcessMsgLogicThread(AFTCPEntityPtr pEntity)
 {
-    //Handle Msg
+    //Handle Msg, only the ones already in queue, the worker thread keeps pushing
     size_t nReceiveCount = pEntity->mxNetMsgMQ.Count();
+    AFTCPMsg* xMsgs[AFNetMsgPool<AFTCPMsg>::ARK_NET_MSG_BATCH];
 
-    for (size_t i = 0; i < nReceiveCount; ++i)
+    while (nReceiveCount > 0)
     {
-        AFTCPMsg* pMsg(nullptr);
+        size_t nPopCount = pEntity->mxNetMsgMQ.Pop(xMsgs, std::min<size_t>(nReceiveCount, AFNetMsgPool<AFTCPMsg>::ARK_NET_MSG_BATCH));
 
-        if (!pEntity->mxNetMsgMQ.Pop(pMsg))
+        if (nPopCount == 0)
         {
             break;
         }
 
-        if (pMsg == nullptr)
-        {
-            continue;
-        }
+        nReceiveCount -= nPopCount;
 
-        switch (pMsg->nType)
+        for (size_t i = 0; i < nPopCount; ++i)
         {
-        case RECIVEDATA:
+            AFTCPMsg* pMsg = xMsgs[i];
+
+            switch (pMsg->nType)
             {
-                if (mRecvCB)
+            case RECIVEDATA:
                 {
-                    mRecvCB(pMsg->xHead, pMsg->xHead.GetMsgID(), pMsg->strMsg.c_str(), pMsg->strMsg.size(), pEntity->GetClientID());
+                    if (mRecvCB)
+                    {
+                        DispatchFrames(pMsg->pData, pMsg->nLen, pEntity->GetClientID(), mRecvCB);
+                    }
                 }
-            }
-            break;
+                break;
 
-        case CONNECTED:
-            mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
-            break;
-
-        case DISCONNECTED:
-            {
+            case CONNECTED:
                 mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
-                pEntity->SetNeedRemove(true);
+                break;
+
+            case DISCONNECTED:
+                {
+                    mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                    pEntity->SetNeedRemove(true);
+                }
+                break;
+
+            default:
+                break;
             }
-            break;
 
-        default:
-            break;
+            AFTCPMsg::Release(pMsg);
         }
-
-        ARK_DELETE(pMsg);
     }
 }
 
 bool AFCNetServer::Final()
 {
     SetWorking(false);
+    StopReusePort();
     return true;
 }
 
-bool AFCNetServer::SendMsgToAllClient(const char* msg, const size_t nLen)
+bool AFCNetServer::SendMsgToAllClient(const brynet::net::DataSocket::PACKET_PTR& xPacket)
 {
-    for (auto it : mmObject)
+    //every session only holds a reference of the same packet
+    mxEntitySlots.ForEach([this, &xPacket](AFTCPEntityPtr pNetObject)
     {
-        AFTCPEntityPtr pNetObject = (AFTCPEntityPtr)it.second;
-
-        if (pNetObject != nullptr && !pNetObject->NeedRemove())
+        if (!pNetObject->NeedRemove())
         {
-            pNetObject->GetSession()->send(msg, nLen);
+            SendPacket(pNetObject, xPacket);
         }
-    }
+    });
 
     return true;
 }
 
 bool AFCNetServer::SendMsg(const char* msg, const size_t nLen, const AFGUID& xClient)
 {
-    AFScopeRdLock xGuard(mRWLock);
-
     AFTCPEntityPtr pNetObject = GetNetEntity(xClient);
 
     if (pNetObject == nullptr)
@@ -222,26 +322,264 @@ bool AFCNetServer::SendMsg(const char* msg, const size_t nLen, const AFGUID& xCl
     }
     else
     {
-        pNetObject->GetSession()->send(msg, nLen);
+        brynet::net::DataSocket::PACKET_PTR xPacket = AFNetPacketPool::GetInstance().Alloc(nLen);
+        xPacket->append(msg, nLen);
+        return SendPacket(pNetObject, xPacket);
+    }
+}
+
+bool AFCNetServer::SendMsg(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClient)
+{
+    AFTCPEntityPtr pNetObject = GetNetEntity(xClient);
+
+    if (pNetObject == nullptr)
+    {
+        return false;
+    }
+
+    return SendPacket(pNetObject, xPacket);
+}
+
+bool AFCNetServer::SendPacket(AFTCPEntityPtr pEntity, const brynet::net::DataSocket::PACKET_PTR& xPacket)
+{
+    if (!CheckSendBacklog(pEntity, xPacket->size()))
+    {
+        return false;
+    }
+
+    const uint16_t nMsgID = GetPacketMsgID(xPacket);
+    AFNetStats::RecordSend(nMsgID, xPacket->size());
+
+    if (IsBulkMsg(nMsgID))
+    {
+        return SendBulk(pEntity, xPacket);
+    }
+
+    if (!mbCork)
+    {
+        pEntity->Send(xPacket);
         return true;
     }
+
+    const int64_t nNow = GetCorkTime();
+
+    if (pEntity->mxCorkBuffer.Empty())
+    {
+        mxCorkList.emplace_back(pEntity->GetClientID(), nNow);
+    }
+
+    pEntity->mxCorkBuffer.Add(xPacket, nNow);
+    ++mxCorkStats.nMsgCount;
+
+    if (pEntity->mxCorkBuffer.GetBytes() >= mnCorkFlushBytes || nNow - pEntity->mxCorkBuffer.GetFirstTime() >= mnCorkMaxDelay)
+    {
+        FlushEntity(pEntity);
+    }
+
+    FlushExpired(nNow);
+
+    return true;
+}
+
+void AFCNetServer::FlushEntity(AFTCPEntityPtr pEntity)
+{
+    if (pEntity->mxCorkBuffer.Empty())
+    {
+        return;
+    }
+
+    mxCorkStats.nSendCount += pEntity->mxCorkBuffer.Flush(pEntity);
+    ++mxCorkStats.nFlushCount;
+}
+
+bool AFCNetServer::SendBulk(AFTCPEntityPtr pEntity, const brynet::net::DataSocket::PACKET_PTR& xPacket)
+{
+    const bool bWasEmpty = pEntity->mxBulkLane.Empty();
+    pEntity->mxBulkLane.Add(xPacket);
+
+    //realtime frames gathered by cork go first, Update flushes them before the bulk lanes
+    if (pEntity->mxCorkBuffer.Empty())
+    {
+        pEntity->mxBulkLane.Pump(pEntity, mnBulkChunkBytes);
+    }
+
+    if (bWasEmpty && !pEntity->mxBulkLane.Empty())
+    {
+        mxBulkList.push_back(pEntity->GetClientID());
+    }
+
+    return true;
 }
 
-bool AFCNetServer::AddNetEntity(const AFGUID& xClientID, AFTCPEntityPtr pEntity)
+void AFCNetServer::PumpBulk()
 {
-    return mmObject.insert(std::make_pair(xClientID, pEntity)).second;
+    //the io threads drain the sessions, so the lanes go on by polling
+    for (size_t i = 0; i < mxBulkList.size();)
+    {
+        AFTCPEntityPtr pEntity = GetNetEntity(mxBulkList[i]);
+
+        if (pEntity != nullptr && !pEntity->NeedRemove())
+        {
+            pEntity->mxBulkLane.Pump(pEntity, mnBulkChunkBytes);
+
+            if (!pEntity->mxBulkLane.Empty())
+            {
+                ++i;
+                continue;
+            }
+        }
+
+        mxBulkList[i] = mxBulkList.back();
+        mxBulkList.pop_back();
+    }
+}
+
+bool AFCNetServer::CheckSendBacklog(AFTCPEntityPtr pEntity, const size_t nLen)
+{
+    if (pEntity->NeedRemove())
+    {
+        return false;
+    }
+
+    if (mnSendHighWater == 0 && mnSendLimit == 0)
+    {
+        return true;
+    }
+
+    const size_t nBacklog = pEntity->GetSendBacklog() + nLen;
+
+    if (mnSendLimit > 0 && nBacklog > mnSendLimit)
+    {
+        //slow consumer, stop queueing for it and let the disconnect event clean it up
+        pEntity->SetNeedRemove(true);
+        pEntity->GetSession()->postDisConnect();
+        return false;
+    }
+
+    if (mnSendHighWater > 0 && nBacklog > mnSendHighWater && !pEntity->mbSendHighWater)
+    {
+        pEntity->mbSendHighWater = true;
+        mxHighWaterList.push_back(pEntity->GetClientID());
+
+        if (mEventCB)
+        {
+            mEventCB(SENDHIGHWATER, pEntity->GetClientID(), mnServerID);
+        }
+    }
+
+    return true;
+}
+
+void AFCNetServer::ProcessSendLowWater()
+{
+    if (mxHighWaterList.empty())
+    {
+        return;
+    }
+
+    //the io threads drain the sessions, so the low water mark can only be found by polling
+    for (size_t i = 0; i < mxHighWaterList.size();)
+    {
+        const AFGUID xClientID = mxHighWaterList[i];
+        AFTCPEntityPtr pEntity = GetNetEntity(xClientID);
+
+        if (pEntity != nullptr && !pEntity->NeedRemove() && pEntity->GetSendBacklog() > mnSendLowWater)
+        {
+            ++i;
+            continue;
+        }
+
+        mxHighWaterList[i] = mxHighWaterList.back();
+        mxHighWaterList.pop_back();
+
+        if (pEntity != nullptr && !pEntity->NeedRemove())
+        {
+            pEntity->mbSendHighWater = false;
+
+            if (mEventCB)
+            {
+                mEventCB(SENDLOWWATER, xClientID, mnServerID);
+            }
+        }
+    }
+}
+
+void AFCNetServer::GetSessionStats(std::vector<AFNetSessionStat>& xList)
+{
+    xList.reserve(mxEntitySlots.Count());
+
+    mxEntitySlots.ForEach([&xList](AFTCPEntityPtr pEntity)
+    {
+        AFNetSessionStat xStat;
+        xStat.xClientID = pEntity->GetClientID();
+        xStat.nRecvQueue = pEntity->mxNetMsgMQ.Count();
+        xStat.nSendBacklog = pEntity->GetSendBacklog();
+        xList.push_back(xStat);
+    });
+}
+
+//the sessions which are not sent to again are past their deadline too, the oldest ones are checked on every corked send
+void AFCNetServer::FlushExpired(const int64_t nNow)
+{
+    while (mnCorkExpireIndex < mxCorkList.size())
+    {
+        const auto& xCork = mxCorkList[mnCorkExpireIndex];
+
+        if (nNow - xCork.second < mnCorkMaxDelay)
+        {
+            break;
+        }
+
+        //an entry is stale when its session was flushed after it, the session has a later entry then
+        AFTCPEntityPtr pEntity = GetNetEntity(xCork.first);
+
+        if (pEntity != nullptr && !pEntity->mxCorkBuffer.Empty() && pEntity->mxCorkBuffer.GetFirstTime() == xCork.second)
+        {
+            FlushEntity(pEntity);
+        }
+
+        ++mnCorkExpireIndex;
+    }
+}
+
+void AFCNetServer::Flush()
+{
+    mnCorkExpireIndex = 0;
+
+    if (mxCorkList.empty())
+    {
+        return;
+    }
+
+    for (const auto& xCork : mxCorkList)
+    {
+        AFTCPEntityPtr pEntity = GetNetEntity(xCork.first);
+
+        if (pEntity != nullptr)
+        {
+            FlushEntity(pEntity);
+        }
+    }
+
+    mxCorkList.clear();
 }
 
 bool AFCNetServer::RemoveNetEntity(const AFGUID& xClientID)
 {
-    AFTCPEntityPtr pEntity = GetNetEntity(xClientID);
+    if (xClientID.nHigh != 0)
+    {
+        return false;
+    }
 
-    if (pEntity != nullptr)
+    AFTCPEntityPtr pEntity = mxEntitySlots.Remove(xClientID.nLow);
+
+    if (pEntity == nullptr)
     {
-        ARK_DELETE(pEntity);
+        return false;
     }
 
-    return mmObject.erase(xClientID);
+    ARK_DELETE(pEntity);
+    return true;
 }
 
 bool AFCNetServer::CloseNetEntity(const AFGUID& xClientID)
@@ -261,84 +599,178 @@ bool AFCNetServer::CloseNetEntity(const AFGUID& xClientID)
 
 bool AFCNetServer::DismantleNet(AFTCPEntityPtr pEntity)
 {
-    while (pEntity->GetBuffLen() >= AFIMsgHead::ARK_MSG_HEAD_LENGTH)
+    //plain whole frames go to the logic thread in one slice of the receive block, without copy
+    AFBufferChunk* pChunk = nullptr;
+    const char* pData = nullptr;
+    size_t nLen = 0;
+    uint8_t nPeerCaps = 0;
+
+    if (!AFNetFrameCodec::Take(pEntity, IsCompactHead(), IsCompress() || pEntity->IsPeerCompress(), pChunk, pData, nLen, nPeerCaps))
     {
-        AFCMsgHead xHead;
-        int nMsgBodyLength = DeCode(pEntity->GetBuff(), pEntity->GetBuffLen(), xHead);
+        pEntity->GetSession()->postDisConnect();
+        return false;
+    }
 
-        if (nMsgBodyLength >= 0 && xHead.GetMsgID() > 0)
-        {
-            AFTCPMsg* pNetInfo = new AFTCPMsg(pEntity->GetSession());
-            pNetInfo->xHead = xHead;
-            pNetInfo->nType = RECIVEDATA;
-            pNetInfo->strMsg.append(pEntity->GetBuff() + AFIMsgHead::ARK_MSG_HEAD_LENGTH, nMsgBodyLength);
-            pEntity->mxNetMsgMQ.Push(pNetInfo);
-            pEntity->RemoveBuff(nMsgBodyLength + AFIMsgHead::ARK_MSG_HEAD_LENGTH);
-        }
-        else
-        {
-            break;
-        }
+    if ((nPeerCaps & AFNetCompress::ARK_NET_CAPS_LZ4) != 0 && IsCompress() && !pEntity->IsPeerCompress())
+    {
+        pEntity->SetPeerCompress(true);
+        pEntity->GetSession()->send(IsCompactHead() ? AFNetFrameCodec::PackCompact(AFNetCompress::MakeCapsFrame()) : AFNetCompress::MakeCapsFrame());
+    }
+
+    if (pChunk == nullptr)
+    {
+        return true;
     }
 
+    AFTCPMsg* pNetInfo = AFTCPMsg::Create(pEntity->GetSession());
+    pNetInfo->nType = RECIVEDATA;
+    pNetInfo->pChunk = pChunk;
+    pNetInfo->pData = pData;
+    pNetInfo->nLen = nLen;
+    pEntity->mxNetMsgMQ.Push(pNetInfo);
+    AddReadyEntity(pEntity);
+
     return true;
 }
 
 bool AFCNetServer::CloseSocketAll()
 {
-    for (auto it : mmObject)
+    //io threads still use the entities until their DISCONNECTED, they are deleted by the remove list like a closed one
+    mxEntitySlots.ForEach([](AFTCPEntityPtr pEntity)
     {
-        it.second->GetSession()->postDisConnect();
-        ARK_DELETE(it.second);
-    }
+        pEntity->GetSession()->postDisConnect();
+    });
 
-    mmObject.clear();
     return true;
 }
 
 AFCNetServer::AFTCPEntityPtr AFCNetServer::GetNetEntity(const AFGUID& xClientID)
 {
-    auto it = mmObject.find(xClientID);
-    return (it != mmObject.end() ? it->second : nullptr);
+    //stale ids of closed connections are rejected by the slot generation
+    return (xClientID.nHigh == 0 ? mxEntitySlots.Get(xClientID.nLow) : nullptr);
 }
 
 bool AFCNetServer::SendMsgWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID)
 {
-    std::string strOutData;
     AFCMsgHead xHead;
     xHead.SetMsgID(nMsgID);
     xHead.SetPlayerID(xPlayerID);
     xHead.SetBodyLength(nLen);
 
-    int nAllLen = EnCode(xHead, msg, nLen, strOutData);
-
-    if (nAllLen == nLen + AFIMsgHead::ARK_MSG_HEAD_LENGTH)
-    {
-        return SendMsg(strOutData.c_str(), strOutData.length(), xClientID);
-    }
-    else
-    {
-        return false;
-    }
+    //head and body go to one pooled packet, and the session queues it without copy
+    return SendMsg(AFNetPacketPool::GetInstance().EnCode(xHead, msg, nLen), xClientID);
 }
 
 bool AFCNetServer::SendMsgToAllClientWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xPlayerID)
 {
-    std::string strOutData;
     AFCMsgHead xHead;
     xHead.SetMsgID(nMsgID);
     xHead.SetPlayerID(xPlayerID);
+    xHead.SetBodyLength(nLen);
+
+    return SendMsgToAllClient(AFNetPacketPool::GetInstance().EnCode(xHead, msg, nLen));
+}
+
+bool AFCNetServer::SendMsgToClientListWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const std::vector<AFGUID>& xClientIDList, const AFGUID& xPlayerID)
+{
+    AFCMsgHead xHead;
+    xHead.SetMsgID(nMsgID);
+    xHead.SetPlayerID(xPlayerID);
+    xHead.SetBodyLength(nLen);
+
+    return SendMsgPacketToClientList(AFNetPacketPool::GetInstance().EnCode(xHead, msg, nLen), xClientIDList);
+}
 
-    int nAllLen = EnCode(xHead, msg, nLen, strOutData);
+bool AFCNetServer::SendMsgFrame(const AFIMsgHead& xHead, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID)
+{
+    AFTCPEntityPtr pEntity = GetNetEntity(xClientID);
 
-    if (nAllLen == nLen + AFIMsgHead::ARK_MSG_HEAD_LENGTH)
+    if (pEntity == nullptr)
     {
-        return SendMsgToAllClient(strOutData.c_str(), strOutData.length());
+        return false;
     }
-    else
+
+    const char* pFrame = msg - AFIMsgHead::ARK_MSG_HEAD_LENGTH;
+    const size_t nFrameLen = AFIMsgHead::ARK_MSG_HEAD_LENGTH + nLen;
+
+    if (!CheckSendBacklog(pEntity, nFrameLen))
     {
         return false;
     }
+
+    AFNetStats::RecordSend(xHead.GetMsgID(), nFrameLen);
+
+    AFCMsgHead xNewHead;
+    xNewHead.SetPlayerID(xPlayerID);
+
+    if (!mbCork || IsBulkMsg(xHead.GetMsgID()))
+    {
+        brynet::net::DataSocket::PACKET_PTR xPacket = AFNetPacketPool::GetInstance().Alloc(nFrameLen);
+        xPacket->assign(pFrame, nFrameLen);
+
+        if (xPlayerID != xHead.GetPlayerID())
+        {
+            xNewHead.EnCodePlayerID(&(*xPacket)[0]);
+        }
+
+        if (IsBulkMsg(xHead.GetMsgID()))
+        {
+            return SendBulk(pEntity, xPacket);
+        }
+
+        pEntity->Send(xPacket);
+        return true;
+    }
+
+    //copied to the end of the pending output of the session directly
+    const int64_t nNow = GetCorkTime();
+
+    if (pEntity->mxCorkBuffer.Empty())
+    {
+        mxCorkList.emplace_back(pEntity->GetClientID(), nNow);
+    }
+
+    char* pData = pEntity->mxCorkBuffer.Append(pFrame, nFrameLen, nNow);
+    ++mxCorkStats.nMsgCount;
+
+    if (xPlayerID != xHead.GetPlayerID())
+    {
+        xNewHead.EnCodePlayerID(pData);
+    }
+
+    if (pEntity->mxCorkBuffer.GetBytes() >= mnCorkFlushBytes || nNow - pEntity->mxCorkBuffer.GetFirstTime() >= mnCorkMaxDelay)
+    {
+        FlushEntity(pEntity);
+    }
+
+    FlushExpired(nNow);
+
+    return true;
+}
+
+bool AFCNetServer::SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID)
+{
+    return SendMsg(xPacket, xClientID);
+}
+
+bool AFCNetServer::SendMsgPacketToAllClient(const brynet::net::DataSocket::PACKET_PTR& xPacket)
+{
+    return SendMsgToAllClient(xPacket);
+}
+
+bool AFCNetServer::SendMsgPacketToClientList(const brynet::net::DataSocket::PACKET_PTR& xPacket, const std::vector<AFGUID>& xClientIDList)
+{
+    for (const auto& xClientID : xClientIDList)
+    {
+        AFTCPEntityPtr pNetObject = GetNetEntity(xClientID);
+
+        if (pNetObject != nullptr)
+        {
+            SendPacket(pNetObject, xPacket);
+        }
+    }
+
+    return true;
 }
 
 int AFCNetServer::EnCode(const AFCMsgHead& xHead, const char* strData, const size_t len, std::string& strOutData)
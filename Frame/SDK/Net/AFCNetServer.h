@@ -22,15 +22,15 @@
 
 #include "AFINet.h"
 #include "SDK/Core/AFQueue.h"
-#include "SDK/Core/AFRWLock.hpp"
+#include "SDK/Core/AFSpinLock.hpp"
+#include "AFNetAcceptor.hpp"
+#include "AFNetSlotMap.hpp"
 #include <brynet/net/SocketLibFunction.h>
 #include <brynet/net/EventLoop.h>
 #include <brynet/net/WrapTCPService.h>
 #include <brynet/net/ListenThread.h>
 #include <brynet/net/Socket.h>
 
-#pragma pack(push, 1)
-
 class AFCNetServer : public AFINet
 {
 public:
@@ -40,7 +40,6 @@ public:
         : mnMaxConnect(0)
         , mnCpuCount(0)
         , mnServerID(0)
-        , mnNextID(1)
     {
 
         m_pServer = std::make_shared<brynet::net::WrapTcpService>();
@@ -52,7 +51,6 @@ public:
         : mnMaxConnect(0)
         , mnCpuCount(0)
         , mnServerID(0)
-        , mnNextID(1)
     {
         mRecvCB = std::bind(handleRecieve, pBaseType, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5);
         mEventCB = std::bind(handleEvent, pBaseType, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
@@ -78,8 +76,15 @@ public:
 
     virtual bool SendMsgWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID);
     virtual bool SendMsgToAllClientWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xPlayerID);
+    virtual bool SendMsgToClientListWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const std::vector<AFGUID>& xClientIDList, const AFGUID& xPlayerID);
+    virtual bool SendMsgFrame(const AFIMsgHead& xHead, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID);
+    virtual bool SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID);
+    virtual bool SendMsgPacketToAllClient(const brynet::net::DataSocket::PACKET_PTR& xPacket);
+    virtual bool SendMsgPacketToClientList(const brynet::net::DataSocket::PACKET_PTR& xPacket, const std::vector<AFGUID>& xClientIDList);
 
     virtual bool CloseNetEntity(const AFGUID& xClientID);
+    virtual void Flush();
+    virtual void GetSessionStats(std::vector<AFNetSessionStat>& xList);
     virtual bool Log(int severity, const char* msg)
     {
         return true;
@@ -90,18 +95,30 @@ public:
 
     //From ListenThread
     void OnAcceptConnectionInner(brynet::net::TcpSocket::PTR session);
+    void OnAcceptConnectionInner(const brynet::net::WrapTcpService::PTR& pServer, brynet::net::TcpSocket::PTR session);
     void OnClientConnectionInner(const brynet::net::TCPSession::PTR& session);
     void OnClientDisConnectionInner(const brynet::net::TCPSession::PTR& session);
 
 private:
-    bool SendMsgToAllClient(const char* msg, const size_t nLen);
+    bool StartReusePort(const std::string& strHost, const int nPort, const int nThreadCount);
+    void StopReusePort();
+    bool SendMsgToAllClient(const brynet::net::DataSocket::PACKET_PTR& xPacket);
     bool SendMsg(const char* msg, const size_t nLen, const AFGUID& xClient);
-    bool AddNetEntity(const AFGUID& xClientID, AFTCPEntityPtr pEntity);
+    bool SendMsg(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClient);
+    bool SendPacket(AFTCPEntityPtr pEntity, const brynet::net::DataSocket::PACKET_PTR& xPacket);
+    bool SendBulk(AFTCPEntityPtr pEntity, const brynet::net::DataSocket::PACKET_PTR& xPacket);
+    void PumpBulk();
+    bool CheckSendBacklog(AFTCPEntityPtr pEntity, const size_t nLen);
+    void ProcessSendLowWater();
+    void FlushEntity(AFTCPEntityPtr pEntity);
+    void FlushExpired(const int64_t nNow);
     bool RemoveNetEntity(const AFGUID& xClientID);
     AFTCPEntityPtr GetNetEntity(const AFGUID& xClientID);
 
     void ProcessMsgLogicThread();
     void ProcessMsgLogicThread(AFTCPEntityPtr pEntity);
+    void AddReadyEntity(AFTCPEntityPtr pEntity);
+    void AddRemoveEntity(AFTCPEntityPtr pEntity);
     bool CloseSocketAll();
     bool DismantleNet(AFTCPEntityPtr pEntity);
 
@@ -110,8 +127,29 @@ protected:
     int EnCode(const AFCMsgHead& xHead, const char* strData, const size_t len, std::string& strOutData);
 
 private:
-    std::map<AFGUID, AFTCPEntityPtr> mmObject;
-    AFCReaderWriterLock mRWLock;
+    //connection id is AFGUID(0, slot handle). Entities are added by worker threads, removed by logic thread,
+    //and the sends of logic thread look them up without lock
+    AFNetSlotMap<AFTCPEntity> mxEntitySlots;
+
+    //entities with new messages and disconnected entities, filled by worker threads
+    AFSpinLock mxReadyLock;
+    std::vector<AFTCPEntityPtr> mxReadyList;
+    std::vector<AFTCPEntityPtr> mxRemoveList;
+    //only used by logic thread, swapped with the lists above every update
+    std::vector<AFTCPEntityPtr> mxProcessReadyList;
+    std::vector<AFTCPEntityPtr> mxProcessRemoveList;
+
+    //entities with pending output in cork mode and the time of their first pending send, in the order they got it,
+    //only used by logic thread. Entries before mnCorkExpireIndex are flushed or stale
+    std::vector<std::pair<AFGUID, int64_t>> mxCorkList;
+    size_t mnCorkExpireIndex{ 0 };
+
+    //entities with bulk frames waiting, only used by logic thread
+    std::vector<AFGUID> mxBulkList;
+
+    //entities over the send high water mark, checked every update for the low water mark, only used by logic thread
+    std::vector<AFGUID> mxHighWaterList;
+
     int mnMaxConnect;
     std::string mstrIPPort;
     int mnCpuCount;
@@ -122,7 +160,8 @@ private:
 
     brynet::net::WrapTcpService::PTR m_pServer;
     brynet::net::ListenThread::PTR m_plistenThread;
-    std::atomic<std::int64_t> mnNextID;
-};
 
-#pragma pack(pop)
\ No newline at end of file
+    //SO_REUSEPORT mode, listener i hands its connections to worker service i
+    std::vector<std::unique_ptr<AFNetAcceptor>> mxAcceptorList;
+    std::vector<brynet::net::WrapTcpService::PTR> mxShardServerList;
+};
\ No newline at end of file
@@ -0,0 +1,96 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include "AFCNetStatsServer.h"
+
+AFCNetStatsServer::AFCNetStatsServer() : mbWorking(false)
+{
+    m_pServer = std::make_shared<brynet::net::WrapTcpService>();
+    m_plistenThread = brynet::net::ListenThread::Create();
+}
+
+AFCNetStatsServer::~AFCNetStatsServer()
+{
+    Final();
+}
+
+bool AFCNetStatsServer::Start(const std::string& strHost, const int nPort)
+{
+    if (mbWorking)
+    {
+        return false;
+    }
+
+    //scraped a few times per minute, one thread is enough
+    m_pServer->startWorkThread(1);
+    m_plistenThread->startListen(false, strHost, nPort, std::bind(&AFCNetStatsServer::OnAcceptConnectionInner, this, std::placeholders::_1));
+    mbWorking = true;
+
+    return true;
+}
+
+void AFCNetStatsServer::Final()
+{
+    if (!mbWorking)
+    {
+        return;
+    }
+
+    m_plistenThread->stopListen();
+    m_pServer->stopWorkThread();
+    mbWorking = false;
+}
+
+void AFCNetStatsServer::OnAcceptConnectionInner(brynet::net::TcpSocket::PTR socket)
+{
+    m_pServer->addSession(std::move(socket),
+                          brynet::net::AddSessionOption::WithEnterCallback(
+                              [this](const brynet::net::TCPSession::PTR & session)
+    {
+        brynet::net::HttpService::setup(session, std::bind(&AFCNetStatsServer::OnHttpConnect, this, std::placeholders::_1));
+    }), brynet::net::AddSessionOption::WithMaxRecvBufferSize(64 * 1024));
+}
+
+void AFCNetStatsServer::OnHttpConnect(const brynet::net::HttpSession::PTR& httpSession)
+{
+    httpSession->setHttpCallback(std::bind(&AFCNetStatsServer::OnHttpMessageCallBack, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void AFCNetStatsServer::OnHttpMessageCallBack(const brynet::net::HTTPParser& httpParser, const brynet::net::HttpSession::PTR& session)
+{
+    brynet::net::HttpResponse response;
+
+    if (httpParser.getPath() == "/metrics")
+    {
+        response.setContentType("text/plain; version=0.0.4");
+        response.setBody(AFNetStats::GetInstance().ToPrometheus());
+    }
+    else
+    {
+        response.setContentType("text/plain");
+        response.setBody("use /metrics\n");
+    }
+
+    std::string result = response.getResult();
+    session->send(result.c_str(), result.size(), [session]()
+    {
+        session->postShutdown();
+    });
+}
@@ -0,0 +1,48 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "AFNetStats.hpp"
+#include <brynet/net/WrapTCPService.h>
+#include <brynet/net/ListenThread.h>
+#include <brynet/net/Socket.h>
+#include <brynet/net/http/HttpService.h>
+#include <brynet/net/http/HttpFormat.h>
+
+//Serves the snapshot of AFNetStats in Prometheus text format at http://host:port/metrics
+class AFCNetStatsServer
+{
+public:
+    AFCNetStatsServer();
+    ~AFCNetStatsServer();
+
+    bool Start(const std::string& strHost, const int nPort);
+    void Final();
+
+private:
+    void OnAcceptConnectionInner(brynet::net::TcpSocket::PTR socket);
+    void OnHttpConnect(const brynet::net::HttpSession::PTR& httpSession);
+    void OnHttpMessageCallBack(const brynet::net::HTTPParser& httpParser, const brynet::net::HttpSession::PTR& session);
+
+    bool mbWorking;
+    brynet::net::WrapTcpService::PTR m_pServer;
+    brynet::net::ListenThread::PTR m_plistenThread;
+};
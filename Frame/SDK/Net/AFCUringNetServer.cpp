@@ -0,0 +1,787 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include "AFCUringNetServer.h"
+
+#if ARK_HAVE_IO_URING
+
+void AFCUringNetServer::Update()
+{
+    ProcessMsgLogicThread();
+    Flush();
+    ProcessSendLowWater();
+    UpdateStats();
+}
+
+int AFCUringNetServer::Start(const unsigned int nMaxClient, const std::string& strAddrPort, const int nServerID, const int nThreadCount)
+{
+    std::string strHost;
+    int nPort = 0;
+
+    if (mbRunning || !SplitHostPort(strAddrPort, strHost, nPort))
+    {
+        return -1;
+    }
+
+    mnMaxConnect = nMaxClient;
+    mnServerID = nServerID;
+    mbRunning = true;
+
+    const int nWorkerCount = std::max(1, nThreadCount);
+
+    for (int i = 0; i < nWorkerCount; ++i)
+    {
+        std::unique_ptr<Worker> pWorker(new Worker());
+        pWorker->nIndex = (size_t)i;
+        pWorker->nListenFD = AFNetAcceptor::Listen(strHost, nPort);
+        pWorker->nEventFD = eventfd(0, EFD_CLOEXEC);
+
+        Worker* pRawWorker = pWorker.get();
+        mxWorkers.push_back(std::move(pWorker));
+
+        if (pRawWorker->nListenFD < 0 || pRawWorker->nEventFD < 0)
+        {
+            Final();
+            return -1;
+        }
+
+        //the ring is set up by its io thread, the only one which submits to it
+        std::future<bool> xResult = pRawWorker->xReady.get_future();
+        pRawWorker->xThread = std::thread(&AFCUringNetServer::Run, this, pRawWorker);
+
+        if (!xResult.get())
+        {
+            Final();
+            return -1;
+        }
+    }
+
+    SetWorking(true);
+    return 0;
+}
+
+bool AFCUringNetServer::Final()
+{
+    mbRunning = false;
+
+    for (auto& pWorker : mxWorkers)
+    {
+        if (pWorker->nEventFD >= 0)
+        {
+            WakeWorker(pWorker.get());
+        }
+
+        if (pWorker->xThread.joinable())
+        {
+            pWorker->xThread.join();
+        }
+
+        if (pWorker->nListenFD >= 0)
+        {
+            close(pWorker->nListenFD);
+        }
+
+        if (pWorker->nEventFD >= 0)
+        {
+            close(pWorker->nEventFD);
+        }
+    }
+
+    //the io threads closed their sessions before they stopped, the entities are deleted here
+    mxWorkers.clear();
+
+    mxEntitySlots.ForEach([](AFUringEntityPtr pEntity)
+    {
+        ARK_DELETE(pEntity);
+    });
+
+    mxEntitySlots.Clear();
+    mxReadyList.clear();
+    mxRemoveList.clear();
+    mxProcessReadyList.clear();
+    mxProcessRemoveList.clear();
+    mxHighWaterList.clear();
+    mnConnectCount = 0;
+
+    SetWorking(false);
+    return true;
+}
+
+void AFCUringNetServer::Run(Worker* pWorker)
+{
+    if (mbBindCpu)
+    {
+        AFNetAcceptor::BindCpu((int)pWorker->nIndex);
+    }
+
+    if (!pWorker->xRing.Init(ARK_URING_ENTRIES) || !pWorker->xBufRing.Init(pWorker->xRing, ARK_URING_BUF_GROUP, ARK_URING_BUF_COUNT, ARK_URING_BUF_SIZE))
+    {
+        pWorker->xReady.set_value(false);
+        return;
+    }
+
+    pWorker->xReady.set_value(true);
+
+    AFNetUring& xRing = pWorker->xRing;
+    xRing.PrepAcceptMultishot(pWorker->nListenFD, ARK_URING_OP_ACCEPT);
+    xRing.PrepRead(pWorker->nEventFD, &pWorker->nEventValue, sizeof(pWorker->nEventValue), ARK_URING_OP_WAKE);
+
+    while (mbRunning)
+    {
+        //submit the sqes of the last batch and sleep until a completion comes
+        xRing.Submit(1);
+
+        xRing.ForEachCqe([this, pWorker](const io_uring_cqe & xCqe)
+        {
+            OnCompletion(pWorker, xCqe);
+        });
+
+        //the buffers given back by the batch go to the kernel at once
+        pWorker->xBufRing.Commit();
+    }
+
+    //close the sessions and wait for their ops, the kernel must not touch an entity after Final deleted it
+    std::vector<AFUringEntityPtr> xCloseList;
+
+    for (auto& iter : pWorker->xEntities)
+    {
+        xCloseList.push_back(iter.second);
+    }
+
+    for (auto pEntity : xCloseList)
+    {
+        CloseEntity(pWorker, pEntity);
+    }
+
+    while (!pWorker->xEntities.empty() && xRing.Submit(1) >= 0)
+    {
+        xRing.ForEachCqe([this, pWorker](const io_uring_cqe & xCqe)
+        {
+            OnCompletion(pWorker, xCqe);
+        });
+
+        pWorker->xBufRing.Commit();
+    }
+}
+
+void AFCUringNetServer::OnCompletion(Worker* pWorker, const io_uring_cqe& xCqe)
+{
+    const uint64_t nOp = xCqe.user_data & ARK_URING_OP_MASK;
+    AFUringEntityPtr pEntity = reinterpret_cast<AFUringEntityPtr>((uintptr_t)(xCqe.user_data & ~(uint64_t)ARK_URING_OP_MASK));
+
+    switch (nOp)
+    {
+    case ARK_URING_OP_ACCEPT:
+        {
+            if (xCqe.res >= 0)
+            {
+                OnAccept(pWorker, xCqe.res);
+            }
+
+            //the multishot accept stops on errors, e.g. out of fd
+            if ((xCqe.flags & IORING_CQE_F_MORE) == 0 && mbRunning)
+            {
+                pWorker->xRing.PrepAcceptMultishot(pWorker->nListenFD, ARK_URING_OP_ACCEPT);
+            }
+        }
+        break;
+
+    case ARK_URING_OP_RECV:
+        OnRecv(pWorker, pEntity, xCqe);
+        break;
+
+    case ARK_URING_OP_SEND:
+        OnSend(pWorker, pEntity, xCqe.res);
+        break;
+
+    case ARK_URING_OP_WAKE:
+        {
+            if (mbRunning)
+            {
+                pWorker->xRing.PrepRead(pWorker->nEventFD, &pWorker->nEventValue, sizeof(pWorker->nEventValue), ARK_URING_OP_WAKE);
+                ProcessSendList(pWorker);
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void AFCUringNetServer::OnAccept(Worker* pWorker, const int nFD)
+{
+    if (!mbRunning || mnConnectCount >= mnMaxConnect)
+    {
+        close(nFD);
+        return;
+    }
+
+    int nOpt = 1;
+    setsockopt(nFD, IPPROTO_TCP, TCP_NODELAY, &nOpt, sizeof(nOpt));
+
+    AFUringEntityPtr pEntity = ARK_NEW AFUringEntity(this, AFGUID(0), nFD, pWorker->nIndex);
+    //the id is set before the entity is visible to the broadcasts of logic thread
+    const uint64_t nHandle = mxEntitySlots.Add(pEntity, [pEntity](const uint64_t nNewHandle)
+    {
+        pEntity->SetClientID(AFGUID(0, nNewHandle));
+    });
+
+    if (nHandle == 0)
+    {
+        ARK_DELETE(pEntity);
+        close(nFD);
+        return;
+    }
+
+    ++mnConnectCount;
+    pWorker->xEntities[nHandle] = pEntity;
+
+    AFUringMsg* pMsg = AFUringMsg::Create(pEntity);
+    pMsg->xClientID = pEntity->GetClientID();
+    pMsg->nType = CONNECTED;
+
+    pEntity->mxNetMsgMQ.Push(pMsg);
+    AddReadyEntity(pEntity);
+
+    ArmRecv(pWorker, pEntity);
+}
+
+void AFCUringNetServer::OnRecv(Worker* pWorker, AFUringEntityPtr pEntity, const io_uring_cqe& xCqe)
+{
+    if (xCqe.res > 0 && (xCqe.flags & IORING_CQE_F_BUFFER) != 0)
+    {
+        const uint16_t nBufID = (uint16_t)(xCqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+        if (!pEntity->mbClosing)
+        {
+            pEntity->AddBuff(pWorker->xBufRing.GetBuffer(nBufID), xCqe.res);
+        }
+
+        //the data are copied, the buffer can take the next recv
+        pWorker->xBufRing.Add(nBufID);
+
+        if (!pEntity->mbClosing && !DismantleNet(pEntity))
+        {
+            CloseEntity(pWorker, pEntity);
+        }
+    }
+
+    if ((xCqe.flags & IORING_CQE_F_MORE) != 0)
+    {
+        return;
+    }
+
+    pEntity->mbRecvArmed = false;
+    --pEntity->mnPendingOps;
+
+    //out of buffers or stopped by the kernel, the recv goes on. 0 is the FIN of the peer
+    if (xCqe.res > 0 || xCqe.res == -ENOBUFS)
+    {
+        ArmRecv(pWorker, pEntity);
+    }
+    else
+    {
+        CloseEntity(pWorker, pEntity);
+    }
+
+    TryFinishClose(pWorker, pEntity);
+}
+
+void AFCUringNetServer::OnSend(Worker* pWorker, AFUringEntityPtr pEntity, const int nResult)
+{
+    pEntity->mbWriting = false;
+    --pEntity->mnPendingOps;
+
+    if (nResult < 0)
+    {
+        CloseEntity(pWorker, pEntity);
+        TryFinishClose(pWorker, pEntity);
+        return;
+    }
+
+    //a short write is continued from where it stopped, the packets queued meanwhile go with it
+    pEntity->OnWritten((size_t)nResult);
+    StartWrite(pWorker, pEntity);
+
+    if (!pEntity->mbWriting && pEntity->IsCloseRequested())
+    {
+        CloseEntity(pWorker, pEntity);
+    }
+
+    TryFinishClose(pWorker, pEntity);
+}
+
+void AFCUringNetServer::ProcessSendList(Worker* pWorker)
+{
+    do
+    {
+        std::lock_guard<AFSpinLock> xGuard(pWorker->xSendLock);
+        pWorker->xProcessList.swap(pWorker->xSendList);
+    } while (0);
+
+    //the handles of closed sessions find nothing, their entities may be deleted already
+    for (const uint64_t nHandle : pWorker->xProcessList)
+    {
+        auto iter = pWorker->xEntities.find(nHandle);
+
+        if (iter == pWorker->xEntities.end())
+        {
+            continue;
+        }
+
+        AFUringEntityPtr pEntity = iter->second;
+        pEntity->ClearSendQueued();
+        StartWrite(pWorker, pEntity);
+
+        //closed after the sends queued before the request
+        if (!pEntity->mbWriting && pEntity->IsCloseRequested())
+        {
+            CloseEntity(pWorker, pEntity);
+            TryFinishClose(pWorker, pEntity);
+        }
+    }
+
+    pWorker->xProcessList.clear();
+}
+
+void AFCUringNetServer::ArmRecv(Worker* pWorker, AFUringEntityPtr pEntity)
+{
+    if (pEntity->mbRecvArmed || pEntity->mbClosing)
+    {
+        return;
+    }
+
+    pWorker->xRing.PrepRecvMultishot(pEntity->GetFD(), ARK_URING_BUF_GROUP, (uint64_t)(uintptr_t)pEntity | ARK_URING_OP_RECV);
+    pEntity->mbRecvArmed = true;
+    ++pEntity->mnPendingOps;
+}
+
+void AFCUringNetServer::StartWrite(Worker* pWorker, AFUringEntityPtr pEntity)
+{
+    if (pEntity->mbWriting || pEntity->mbClosing || !pEntity->PrepareWrite())
+    {
+        return;
+    }
+
+    //the iovecs stay in the entity until the write completes
+    pWorker->xRing.PrepWritev(pEntity->GetFD(), pEntity->GetIovecs(), pEntity->GetIovecCount(), (uint64_t)(uintptr_t)pEntity | ARK_URING_OP_SEND);
+    pEntity->mbWriting = true;
+    ++pEntity->mnPendingOps;
+}
+
+void AFCUringNetServer::CloseEntity(Worker* pWorker, AFUringEntityPtr pEntity)
+{
+    if (pEntity->mbClosing)
+    {
+        return;
+    }
+
+    //the ops in flight complete with an error or 0, the fd is closed after the last one
+    pEntity->mbClosing = true;
+    shutdown(pEntity->GetFD(), SHUT_RDWR);
+}
+
+void AFCUringNetServer::TryFinishClose(Worker* pWorker, AFUringEntityPtr pEntity)
+{
+    if (!pEntity->mbClosing || pEntity->mnPendingOps > 0)
+    {
+        return;
+    }
+
+    close(pEntity->GetFD());
+    pWorker->xEntities.erase(pEntity->GetClientID().nLow);
+    --mnConnectCount;
+    pEntity->SetClosed();
+
+    AFUringMsg* pMsg = AFUringMsg::Create(pEntity);
+    pMsg->xClientID = pEntity->GetClientID();
+    pMsg->nType = DISCONNECTED;
+
+    pEntity->mxNetMsgMQ.Push(pMsg);
+
+    //the last touch of the entity in io thread, logic thread will delete it
+    AddRemoveEntity(pEntity);
+}
+
+bool AFCUringNetServer::DismantleNet(AFUringEntityPtr pEntity)
+{
+    AFBufferChunk* pChunk = nullptr;
+    const char* pData = nullptr;
+    size_t nLen = 0;
+    uint8_t nPeerCaps = 0;
+
+    if (!AFNetFrameCodec::Take(pEntity, IsCompactHead(), IsCompress(), pChunk, pData, nLen, nPeerCaps))
+    {
+        return false;
+    }
+
+    if (pChunk == nullptr)
+    {
+        return true;
+    }
+
+    AFUringMsg* pNetInfo = AFUringMsg::Create(pEntity);
+    pNetInfo->nType = RECIVEDATA;
+    pNetInfo->pChunk = pChunk;
+    pNetInfo->pData = pData;
+    pNetInfo->nLen = nLen;
+    pEntity->mxNetMsgMQ.Push(pNetInfo);
+    AddReadyEntity(pEntity);
+
+    return true;
+}
+
+void AFCUringNetServer::AddReadyEntity(AFUringEntityPtr pEntity)
+{
+    if (pEntity->MarkReady())
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxReadyLock);
+        mxReadyList.push_back(pEntity);
+    }
+}
+
+void AFCUringNetServer::AddRemoveEntity(AFUringEntityPtr pEntity)
+{
+    std::lock_guard<AFSpinLock> xGuard(mxReadyLock);
+    mxRemoveList.push_back(pEntity);
+}
+
+void AFCUringNetServer::Flush()
+{
+    for (auto& pWorker : mxWorkers)
+    {
+        if (pWorker->xPostList.empty())
+        {
+            continue;
+        }
+
+        do
+        {
+            std::lock_guard<AFSpinLock> xGuard(pWorker->xSendLock);
+            pWorker->xSendList.insert(pWorker->xSendList.end(), pWorker->xPostList.begin(), pWorker->xPostList.end());
+        } while (0);
+
+        pWorker->xPostList.clear();
+
+        //one wakeup of the worker for all the sessions of this update
+        WakeWorker(pWorker.get());
+    }
+}
+
+void AFCUringNetServer::WakeWorker(Worker* pWorker)
+{
+    //the eventfd counter adds up, a failed write means it is full and the worker is woken anyway
+    const uint64_t nValue = 1;
+    const ssize_t nRet = write(pWorker->nEventFD, &nValue, sizeof(nValue));
+    (void)nRet;
+}
+
+void AFCUringNetServer::PostEntity(AFUringEntityPtr pEntity)
+{
+    mxWorkers[pEntity->GetWorker()]->xPostList.push_back(pEntity->GetClientID().nLow);
+}
+
+void AFCUringNetServer::ProcessMsgLogicThread()
+{
+    do
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxReadyLock);
+        mxProcessReadyList.swap(mxReadyList);
+        mxProcessRemoveList.swap(mxRemoveList);
+    } while (0);
+
+    for (auto pEntity : mxProcessReadyList)
+    {
+        //a closed entity in both lists is handled once, with the remove list
+        if (!pEntity->IsClosed())
+        {
+            pEntity->ClearReady();
+            ProcessMsgLogicThread(pEntity);
+        }
+    }
+
+    mxProcessReadyList.clear();
+
+    //io threads never touch the entities in remove list again
+    for (auto pEntity : mxProcessRemoveList)
+    {
+        ProcessMsgLogicThread(pEntity);
+        RemoveNetEntity(pEntity->GetClientID());
+    }
+
+    mxProcessRemoveList.clear();
+}
+
+void AFCUringNetServer::ProcessMsgLogicThread(AFUringEntityPtr pEntity)
+{
+    //only the messages already in queue, the io thread keeps pushing
+    size_t nReceiveCount = pEntity->mxNetMsgMQ.Count();
+    AFUringMsg* xMsgs[AFNetMsgPool<AFUringMsg>::ARK_NET_MSG_BATCH];
+
+    while (nReceiveCount > 0)
+    {
+        size_t nPopCount = pEntity->mxNetMsgMQ.Pop(xMsgs, std::min<size_t>(nReceiveCount, AFNetMsgPool<AFUringMsg>::ARK_NET_MSG_BATCH));
+
+        if (nPopCount == 0)
+        {
+            break;
+        }
+
+        nReceiveCount -= nPopCount;
+
+        for (size_t i = 0; i < nPopCount; ++i)
+        {
+            AFUringMsg* pMsg = xMsgs[i];
+
+            switch (pMsg->nType)
+            {
+            case RECIVEDATA:
+                {
+                    if (mRecvCB)
+                    {
+                        DispatchFrames(pMsg->pData, pMsg->nLen, pEntity->GetClientID(), mRecvCB);
+                    }
+                }
+                break;
+
+            case CONNECTED:
+                mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                break;
+
+            case DISCONNECTED:
+                {
+                    mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                    pEntity->SetNeedRemove(true);
+                }
+                break;
+
+            default:
+                break;
+            }
+
+            AFUringMsg::Release(pMsg);
+        }
+    }
+}
+
+bool AFCUringNetServer::SendPacket(AFUringEntityPtr pEntity, const brynet::net::DataSocket::PACKET_PTR& xPacket)
+{
+    if (pEntity->IsClosed() || !CheckSendBacklog(pEntity, xPacket->size()))
+    {
+        return false;
+    }
+
+    AFNetStats::RecordSend(GetPacketMsgID(xPacket), xPacket->size());
+
+    //queued as it is, the worker writes the packets of a session with one writev
+    const bool bPost = (IsCompactHead() ? pEntity->QueueSend(AFNetFrameCodec::PackCompact(xPacket)) : pEntity->QueueSend(xPacket));
+
+    if (bPost)
+    {
+        PostEntity(pEntity);
+    }
+
+    return true;
+}
+
+bool AFCUringNetServer::CheckSendBacklog(AFUringEntityPtr pEntity, const size_t nLen)
+{
+    if (pEntity->NeedRemove() || pEntity->IsCloseRequested())
+    {
+        return false;
+    }
+
+    if (mnSendHighWater == 0 && mnSendLimit == 0)
+    {
+        return true;
+    }
+
+    const size_t nBacklog = pEntity->GetSendBacklog() + nLen;
+
+    if (mnSendLimit > 0 && nBacklog > mnSendLimit)
+    {
+        //slow consumer, stop queueing for it and let the disconnect event clean it up
+        pEntity->SetNeedRemove(true);
+
+        if (pEntity->RequestClose())
+        {
+            PostEntity(pEntity);
+        }
+
+        return false;
+    }
+
+    if (mnSendHighWater > 0 && nBacklog > mnSendHighWater && !pEntity->mbSendHighWater)
+    {
+        pEntity->mbSendHighWater = true;
+        mxHighWaterList.push_back(pEntity->GetClientID());
+
+        if (mEventCB)
+        {
+            mEventCB(SENDHIGHWATER, pEntity->GetClientID(), mnServerID);
+        }
+    }
+
+    return true;
+}
+
+void AFCUringNetServer::ProcessSendLowWater()
+{
+    if (mxHighWaterList.empty())
+    {
+        return;
+    }
+
+    //the io threads drain the sessions, so the low water mark can only be found by polling
+    for (size_t i = 0; i < mxHighWaterList.size();)
+    {
+        const AFGUID xClientID = mxHighWaterList[i];
+        AFUringEntityPtr pEntity = GetNetEntity(xClientID);
+
+        if (pEntity != nullptr && !pEntity->NeedRemove() && pEntity->GetSendBacklog() > mnSendLowWater)
+        {
+            ++i;
+            continue;
+        }
+
+        mxHighWaterList[i] = mxHighWaterList.back();
+        mxHighWaterList.pop_back();
+
+        if (pEntity != nullptr && !pEntity->NeedRemove())
+        {
+            pEntity->mbSendHighWater = false;
+
+            if (mEventCB)
+            {
+                mEventCB(SENDLOWWATER, xClientID, mnServerID);
+            }
+        }
+    }
+}
+
+bool AFCUringNetServer::RemoveNetEntity(const AFGUID& xClientID)
+{
+    if (xClientID.nHigh != 0)
+    {
+        return false;
+    }
+
+    AFUringEntityPtr pEntity = mxEntitySlots.Remove(xClientID.nLow);
+
+    if (pEntity == nullptr)
+    {
+        return false;
+    }
+
+    ARK_DELETE(pEntity);
+    return true;
+}
+
+AFCUringNetServer::AFUringEntityPtr AFCUringNetServer::GetNetEntity(const AFGUID& xClientID)
+{
+    return (xClientID.nHigh == 0 ? mxEntitySlots.Get(xClientID.nLow) : nullptr);
+}
+
+bool AFCUringNetServer::CloseNetEntity(const AFGUID& xClientID)
+{
+    AFUringEntityPtr pEntity = GetNetEntity(xClientID);
+
+    if (pEntity != nullptr && !pEntity->IsClosed() && pEntity->RequestClose())
+    {
+        PostEntity(pEntity);
+    }
+
+    return true;
+}
+
+void AFCUringNetServer::GetSessionStats(std::vector<AFNetSessionStat>& xList)
+{
+    xList.reserve(mxEntitySlots.Count());
+
+    mxEntitySlots.ForEach([&xList](AFUringEntityPtr pEntity)
+    {
+        AFNetSessionStat xStat;
+        xStat.xClientID = pEntity->GetClientID();
+        xStat.nRecvQueue = pEntity->mxNetMsgMQ.Count();
+        xStat.nSendBacklog = pEntity->GetSendBacklog();
+        xList.push_back(xStat);
+    });
+}
+
+bool AFCUringNetServer::SendMsgWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID)
+{
+    AFCMsgHead xHead;
+    xHead.SetMsgID(nMsgID);
+    xHead.SetPlayerID(xPlayerID);
+    xHead.SetBodyLength(nLen);
+
+    return SendMsgPacket(AFNetPacketPool::GetInstance().EnCode(xHead, msg, nLen), xClientID);
+}
+
+bool AFCUringNetServer::SendMsgToAllClientWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xPlayerID)
+{
+    AFCMsgHead xHead;
+    xHead.SetMsgID(nMsgID);
+    xHead.SetPlayerID(xPlayerID);
+    xHead.SetBodyLength(nLen);
+
+    return SendMsgPacketToAllClient(AFNetPacketPool::GetInstance().EnCode(xHead, msg, nLen));
+}
+
+bool AFCUringNetServer::SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID)
+{
+    AFUringEntityPtr pEntity = GetNetEntity(xClientID);
+
+    if (pEntity == nullptr)
+    {
+        return false;
+    }
+
+    return SendPacket(pEntity, xPacket);
+}
+
+bool AFCUringNetServer::SendMsgPacketToAllClient(const brynet::net::DataSocket::PACKET_PTR& xPacket)
+{
+    //one packet shared by all the sessions, it goes back to the pool after the last write
+    mxEntitySlots.ForEach([this, &xPacket](AFUringEntityPtr pEntity)
+    {
+        SendPacket(pEntity, xPacket);
+    });
+
+    return true;
+}
+
+bool AFCUringNetServer::SendMsgPacketToClientList(const brynet::net::DataSocket::PACKET_PTR& xPacket, const std::vector<AFGUID>& xClientIDList)
+{
+    for (const auto& xClientID : xClientIDList)
+    {
+        AFUringEntityPtr pEntity = GetNetEntity(xClientID);
+
+        if (pEntity != nullptr)
+        {
+            SendPacket(pEntity, xPacket);
+        }
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,184 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "AFINet.h"
+#include "AFNetUring.hpp"
+#include "AFNetSlotMap.hpp"
+#include "AFNetAcceptor.hpp"
+#include "SDK/Core/AFSpinLock.hpp"
+
+#if ARK_HAVE_IO_URING
+
+//Tcp server on io_uring, linux 6.0 or later, a drop-in for AFCNetServer with the same callbacks.
+//Every worker thread has its own ring and its own SO_REUSEPORT listener: a multishot accept takes the connections,
+//a multishot recv per session reads into the buffers registered to the ring, so an idle session holds no buffer.
+//Sends are queued by logic thread and handed to the workers once per Update, every worker submits the writes of all
+//its sessions with one syscall. Cork, bulk lanes and compression are not used on these links, the compact head is.
+class AFCUringNetServer : public AFINet
+{
+public:
+    using AFUringEntityPtr = AFUringEntity*;
+
+    AFCUringNetServer()
+        : mnMaxConnect(0)
+        , mnServerID(0)
+        , mnConnectCount(0)
+        , mbRunning(false)
+    {
+    }
+
+    template<typename BaseType>
+    AFCUringNetServer(BaseType* pBaseType, void (BaseType::*handleRecieve)(const AFIMsgHead& xHead, const int, const char*, const size_t, const AFGUID&), void (BaseType::*handleEvent)(const NetEventType, const AFGUID&, const int))
+        : mnMaxConnect(0)
+        , mnServerID(0)
+        , mnConnectCount(0)
+        , mbRunning(false)
+    {
+        mRecvCB = std::bind(handleRecieve, pBaseType, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5);
+        mEventCB = std::bind(handleEvent, pBaseType, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+        SetWorking(false);
+    }
+
+    virtual ~AFCUringNetServer()
+    {
+        Final();
+    }
+
+    virtual void Update();
+
+    //nThreadCount workers, each with its own ring and listener, -1 when the kernel has no io_uring
+    virtual int Start(const unsigned int nMaxClient, const std::string& strAddrPort, const int nServerID, const int nThreadCount);
+    virtual bool Final() final;
+    virtual bool IsServer()
+    {
+        return true;
+    }
+
+    virtual bool SendMsgWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID);
+    virtual bool SendMsgToAllClientWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const AFGUID& xPlayerID);
+    virtual bool SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID);
+    virtual bool SendMsgPacketToAllClient(const brynet::net::DataSocket::PACKET_PTR& xPacket);
+    virtual bool SendMsgPacketToClientList(const brynet::net::DataSocket::PACKET_PTR& xPacket, const std::vector<AFGUID>& xClientIDList);
+
+    //hand the sessions with new sends to the workers, called by Update
+    virtual void Flush();
+
+    virtual bool CloseNetEntity(const AFGUID& xClientID);
+    virtual void GetSessionStats(std::vector<AFNetSessionStat>& xList);
+    virtual bool Log(int severity, const char* msg)
+    {
+        return true;
+    };
+
+private:
+    enum
+    {
+        ARK_URING_ENTRIES = 1024,
+        ARK_URING_BUF_COUNT = 1024,     //power of 2
+        ARK_URING_BUF_SIZE = 4096,
+        ARK_URING_BUF_GROUP = 0,
+
+        //low bits of the user data, the entities are aligned to 8 bytes
+        ARK_URING_OP_ACCEPT = 1,
+        ARK_URING_OP_RECV = 2,
+        ARK_URING_OP_SEND = 3,
+        ARK_URING_OP_WAKE = 4,
+        ARK_URING_OP_MASK = 7,
+    };
+
+    struct Worker
+    {
+        size_t nIndex{ 0 };
+        int nListenFD{ -1 };
+        int nEventFD{ -1 };
+        uint64_t nEventValue{ 0 };
+        std::thread xThread;
+        std::promise<bool> xReady; //set by io thread when its ring is up
+
+        //only used by io thread, the buffer ring is released after the ring
+        AFNetUringBufRing xBufRing;
+        AFNetUring xRing;
+        std::unordered_map<uint64_t, AFUringEntityPtr> xEntities;
+        std::vector<uint64_t> xProcessList;
+
+        //handles of the sessions with new sends or close requests, filled by Flush
+        AFSpinLock xSendLock;
+        std::vector<uint64_t> xSendList;
+
+        //only used by logic thread, gathered until the next Flush
+        std::vector<uint64_t> xPostList;
+    };
+
+    //io thread
+    void Run(Worker* pWorker);
+    void OnCompletion(Worker* pWorker, const io_uring_cqe& xCqe);
+    void OnAccept(Worker* pWorker, const int nFD);
+    void OnRecv(Worker* pWorker, AFUringEntityPtr pEntity, const io_uring_cqe& xCqe);
+    void OnSend(Worker* pWorker, AFUringEntityPtr pEntity, const int nResult);
+    void ProcessSendList(Worker* pWorker);
+    void ArmRecv(Worker* pWorker, AFUringEntityPtr pEntity);
+    void StartWrite(Worker* pWorker, AFUringEntityPtr pEntity);
+    void CloseEntity(Worker* pWorker, AFUringEntityPtr pEntity);
+    void TryFinishClose(Worker* pWorker, AFUringEntityPtr pEntity);
+    bool DismantleNet(AFUringEntityPtr pEntity);
+    void AddReadyEntity(AFUringEntityPtr pEntity);
+    void AddRemoveEntity(AFUringEntityPtr pEntity);
+
+    //logic thread
+    bool SendPacket(AFUringEntityPtr pEntity, const brynet::net::DataSocket::PACKET_PTR& xPacket);
+    bool CheckSendBacklog(AFUringEntityPtr pEntity, const size_t nLen);
+    void ProcessSendLowWater();
+    void PostEntity(AFUringEntityPtr pEntity);
+    void WakeWorker(Worker* pWorker);
+    bool RemoveNetEntity(const AFGUID& xClientID);
+    AFUringEntityPtr GetNetEntity(const AFGUID& xClientID);
+    void ProcessMsgLogicThread();
+    void ProcessMsgLogicThread(AFUringEntityPtr pEntity);
+
+private:
+    //connection id is AFGUID(0, slot handle) like AFCNetServer. Entities are added by io threads, removed by logic thread
+    AFNetSlotMap<AFUringEntity> mxEntitySlots;
+
+    std::vector<std::unique_ptr<Worker>> mxWorkers;
+
+    //entities with new messages and closed entities, filled by io threads
+    AFSpinLock mxReadyLock;
+    std::vector<AFUringEntityPtr> mxReadyList;
+    std::vector<AFUringEntityPtr> mxRemoveList;
+    //only used by logic thread, swapped with the lists above every update
+    std::vector<AFUringEntityPtr> mxProcessReadyList;
+    std::vector<AFUringEntityPtr> mxProcessRemoveList;
+
+    //sessions over the high water mark, checked every Update until they drain
+    std::vector<AFGUID> mxHighWaterList;
+
+    unsigned int mnMaxConnect;
+    int mnServerID;
+    std::atomic<unsigned int> mnConnectCount;
+
+    NET_RECEIVE_FUNCTOR mRecvCB;
+    NET_EVENT_FUNCTOR mEventCB;
+
+    std::atomic<bool> mbRunning;
+};
+
+#endif
@@ -49,49 +49,53 @@ void AFCWebSocktClient::ProcessMsgLogicThread(AFHttpEntity* pEntity)
     }
 
     //Handle messages
+    //only handle the messages already in queue, the worker thread keeps pushing
     size_t nReceiveCount = pEntity->mxNetMsgMQ.Count();
+    AFHttpMsg* xMsgs[AFNetMsgPool<AFHttpMsg>::ARK_NET_MSG_BATCH];
 
-    for (size_t i = 0; i < nReceiveCount; ++i)
+    while (nReceiveCount > 0)
     {
-        AFHttpMsg* pMsg(nullptr);
+        size_t nPopCount = pEntity->mxNetMsgMQ.Pop(xMsgs, std::min<size_t>(nReceiveCount, AFNetMsgPool<AFHttpMsg>::ARK_NET_MSG_BATCH));
 
-        if (!pEntity->mxNetMsgMQ.Pop(pMsg))
+        if (nPopCount == 0)
         {
             break;
         }
 
-        if (pMsg == nullptr)
-        {
-            continue;
-        }
+        nReceiveCount -= nPopCount;
 
-        switch (pMsg->nType)
+        for (size_t i = 0; i < nPopCount; ++i)
         {
-        case RECIVEDATA:
+            AFHttpMsg* pMsg = xMsgs[i];
+
+            switch (pMsg->nType)
             {
-                if (mRecvCB)
+            case RECIVEDATA:
                 {
-                    mRecvCB(pMsg->xHead, pMsg->xHead.GetMsgID(), pMsg->strMsg.c_str(), pMsg->strMsg.size(), pEntity->GetClientID());
+                    if (mRecvCB)
+                    {
+                        DispatchFrames(pMsg->pData, pMsg->nLen, pEntity->GetClientID(), mRecvCB);
+                    }
                 }
-            }
-            break;
-
-        case CONNECTED:
-            mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
-            break;
+                break;
 
-        case DISCONNECTED:
-            {
+            case CONNECTED:
                 mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
-                pEntity->SetNeedRemove(true);
+                break;
+
+            case DISCONNECTED:
+                {
+                    mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                    pEntity->SetNeedRemove(true);
+                }
+                break;
+
+            default:
+                break;
             }
-            break;
 
-        default:
-            break;
+            AFHttpMsg::Release(pMsg);
         }
-
-        delete pMsg;
     }
 }
 
@@ -138,7 +142,7 @@ void AFCWebSocktClient::OnHttpConnect(const brynet::net::HttpSession::PTR& httpS
 
     httpSession->setWSConnected([this](const brynet::net::HttpSession::PTR & httpSession, const brynet::net::HTTPParser&)
     {
-        AFHttpMsg* pMsg = new AFHttpMsg(httpSession);
+        AFHttpMsg* pMsg = AFHttpMsg::Create(httpSession);
         httpSession->setUD(static_cast<int64_t>(pMsg->xClientID.nLow));
         pMsg->nType = CONNECTED;
 
@@ -189,7 +193,7 @@ void AFCWebSocktClient::OnHttpDisConnection(const brynet::net::HttpSession::PTR&
     xClient.nLow = *ud;
     AFScopeWrLock xGuard(mRWLock);
 
-    AFHttpMsg* pMsg = new AFHttpMsg(httpSession);
+    AFHttpMsg* pMsg = AFHttpMsg::Create(httpSession);
     pMsg->xClientID = xClient;
     pMsg->nType = DISCONNECTED;
 
@@ -231,26 +235,22 @@ bool AFCWebSocktClient::CloseNetEntity(const AFGUID& xClient)
 
 bool AFCWebSocktClient::DismantleNet(AFHttpEntity* pEntity)
 {
-    while (pEntity->GetBuffLen() >= AFIMsgHead::ARK_MSG_HEAD_LENGTH)
-    {
-        AFCMsgHead xHead;
-        int nMsgBodyLength = DeCode(pEntity->GetBuff(), pEntity->GetBuffLen(), xHead);
+    //all whole frames go to the logic thread in one slice of the receive block, without copy
+    size_t nFramesLen = GetFramesLength(pEntity->GetBuff(), pEntity->GetBuffLen());
 
-        if (nMsgBodyLength >= 0 && xHead.GetMsgID() > 0)
-        {
-            AFHttpMsg* pMsg = new AFHttpMsg(pEntity->GetSession());
-            pMsg->xHead = xHead;
-            pMsg->nType = RECIVEDATA;
-            pMsg->strMsg.append(pEntity->GetBuff() + AFIMsgHead::ARK_MSG_HEAD_LENGTH, nMsgBodyLength);
-            pEntity->mxNetMsgMQ.Push(pMsg);
-            pEntity->RemoveBuff(nMsgBodyLength + AFIMsgHead::ARK_MSG_HEAD_LENGTH);
-        }
-        else
-        {
-            break;
-        }
+    if (nFramesLen == 0)
+    {
+        return true;
     }
 
+    AFHttpMsg* pMsg = AFHttpMsg::Create(pEntity->GetSession());
+    pMsg->nType = RECIVEDATA;
+    pMsg->pChunk = pEntity->ShareBuff();
+    pMsg->pData = pEntity->GetBuff();
+    pMsg->nLen = nFramesLen;
+    pEntity->mxNetMsgMQ.Push(pMsg);
+    pEntity->RemoveBuff(nFramesLen);
+
     return true;
 }
 
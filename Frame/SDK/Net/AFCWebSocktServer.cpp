@@ -23,6 +23,7 @@
 void AFCWebSocktServer::Update()
 {
     ProcessMsgLogicThread();
+    UpdateStats();
 }
 
 int AFCWebSocktServer::Start(const unsigned int nMaxClient, const std::string& strAddrPort, const int nServerID, const int nThreadCount)
@@ -122,7 +123,7 @@ void AFCWebSocktServer::OnHttpConnect(const brynet::net::HttpSession::PTR& httpS
     httpSession->setWSCallback(std::bind(&AFCWebSocktServer::OnWebSockMessageCallBack, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     httpSession->setCloseCallback(std::bind(&AFCWebSocktServer::OnHttpDisConnection, this, std::placeholders::_1));
 
-    AFHttpMsg* pMsg = new AFHttpMsg(httpSession);
+    AFHttpMsg* pMsg = AFHttpMsg::Create(httpSession);
     pMsg->xClientID.nLow = nNextID++;
     httpSession->setUD(static_cast<int64_t>(pMsg->xClientID.nLow));
     pMsg->nType = CONNECTED;
@@ -154,7 +155,7 @@ void AFCWebSocktServer::OnHttpDisConnection(const brynet::net::HttpSession::PTR&
         return ;
     }
 
-    AFHttpMsg* pMsg = new AFHttpMsg(httpSession);
+    AFHttpMsg* pMsg = AFHttpMsg::Create(httpSession);
     pMsg->xClientID = xClient;
     pMsg->nType = DISCONNECTED;
 
@@ -191,50 +192,53 @@ void AFCWebSocktServer::ProcessMsgLogicThread()
 
 void AFCWebSocktServer::ProcessMsgLogicThread(AFHttpEntity* pEntity)
 {
-    //Handle Msg
+    //Handle Msg, only the ones already in queue, the worker thread keeps pushing
     size_t nReceiveCount = pEntity->mxNetMsgMQ.Count();
+    AFHttpMsg* xMsgs[AFNetMsgPool<AFHttpMsg>::ARK_NET_MSG_BATCH];
 
-    for (size_t i = 0; i < nReceiveCount; ++i)
+    while (nReceiveCount > 0)
     {
-        AFHttpMsg* pMsg(nullptr);
+        size_t nPopCount = pEntity->mxNetMsgMQ.Pop(xMsgs, std::min<size_t>(nReceiveCount, AFNetMsgPool<AFHttpMsg>::ARK_NET_MSG_BATCH));
 
-        if (!pEntity->mxNetMsgMQ.Pop(pMsg))
+        if (nPopCount == 0)
         {
             break;
         }
 
-        if (pMsg == nullptr)
-        {
-            continue;
-        }
+        nReceiveCount -= nPopCount;
 
-        switch (pMsg->nType)
+        for (size_t i = 0; i < nPopCount; ++i)
         {
-        case RECIVEDATA:
+            AFHttpMsg* pMsg = xMsgs[i];
+
+            switch (pMsg->nType)
             {
-                if (mRecvCB)
+            case RECIVEDATA:
                 {
-                    mRecvCB(pMsg->xHead, pMsg->xHead.GetMsgID(), pMsg->strMsg.c_str(), pMsg->strMsg.size(), pEntity->GetClientID());
+                    if (mRecvCB)
+                    {
+                        DispatchFrames(pMsg->pData, pMsg->nLen, pEntity->GetClientID(), mRecvCB);
+                    }
                 }
-            }
-            break;
-
-        case CONNECTED:
-            mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
-            break;
+                break;
 
-        case DISCONNECTED:
-            {
+            case CONNECTED:
                 mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
-                pEntity->SetNeedRemove(true);
+                break;
+
+            case DISCONNECTED:
+                {
+                    mEventCB((NetEventType)pMsg->nType, pMsg->xClientID, mnServerID);
+                    pEntity->SetNeedRemove(true);
+                }
+                break;
+
+            default:
+                break;
             }
-            break;
 
-        default:
-            break;
+            AFHttpMsg::Release(pMsg);
         }
-
-        delete pMsg;
     }
 }
 
@@ -254,6 +258,9 @@ bool AFCWebSocktServer::SendMsgToAllClient(const char* msg, const size_t nLen)
             true,
             false);
 
+    AFScopeRdLock xGuard(mRWLock);
+
+    //the frame is built once and every session only holds a reference of it
     std::map<AFGUID, AFHttpEntity*>::iterator it = mxNetEntities.begin();
 
     for (; it != mxNetEntities.end(); ++it)
@@ -323,26 +330,22 @@ bool AFCWebSocktServer::CloseNetEntity(const AFGUID& xClientID)
 
 bool AFCWebSocktServer::DismantleNet(AFHttpEntity* pEntity)
 {
-    while (pEntity->GetBuffLen() >= AFIMsgHead::ARK_MSG_HEAD_LENGTH)
-    {
-        AFCMsgHead xHead;
-        int nMsgBodyLength = DeCode(pEntity->GetBuff(), pEntity->GetBuffLen(), xHead);
+    //all whole frames go to the logic thread in one slice of the receive block, without copy
+    size_t nFramesLen = GetFramesLength(pEntity->GetBuff(), pEntity->GetBuffLen());
 
-        if (nMsgBodyLength >= 0 && xHead.GetMsgID() > 0)
-        {
-            AFHttpMsg* pMsg = new AFHttpMsg(pEntity->GetSession());
-            pMsg->xHead = xHead;
-            pMsg->nType = RECIVEDATA;
-            pMsg->strMsg.append(pEntity->GetBuff() + AFIMsgHead::ARK_MSG_HEAD_LENGTH, nMsgBodyLength);
-            pEntity->mxNetMsgMQ.Push(pMsg);
-            pEntity->RemoveBuff(nMsgBodyLength + AFIMsgHead::ARK_MSG_HEAD_LENGTH);
-        }
-        else
-        {
-            break;
-        }
+    if (nFramesLen == 0)
+    {
+        return true;
     }
 
+    AFHttpMsg* pMsg = AFHttpMsg::Create(pEntity->GetSession());
+    pMsg->nType = RECIVEDATA;
+    pMsg->pChunk = pEntity->ShareBuff();
+    pMsg->pData = pEntity->GetBuff();
+    pMsg->nLen = nFramesLen;
+    pEntity->mxNetMsgMQ.Push(pMsg);
+    pEntity->RemoveBuff(nFramesLen);
+
     return true;
 }
 
@@ -396,6 +399,7 @@ bool AFCWebSocktServer::SendMsgToAllClientWithOutHead(const uint16_t nMsgID, con
     AFCMsgHead xHead;
     xHead.SetMsgID(nMsgID);
     xHead.SetPlayerID(xPlayerID);
+    xHead.SetBodyLength(nLen);
 
     int nAllLen = EnCode(xHead, msg, nLen, strOutData);
 
@@ -24,6 +24,9 @@
 #include "SDK/Core/AFGUID.h"
 #include "SDK/Core/AFLockFreeQueue.h"
 #include "SDK/Core/AFBuffer.hpp"
+#include "SDK/Core/AFSpinLock.hpp"
+#include "AFNetStats.hpp"
+#include "common/lz4_block.hpp"
 #include "brynet/net/WrapTCPService.h"
 #include "brynet/net/http/HttpService.h"
 
@@ -122,7 +125,10 @@ public:
 class AFCMsgHead : public AFIMsgHead
 {
 public:
-    AFCMsgHead(): munSize(0), munMsgID(0), mxPlayerID(0)
+    //highest bit of MsgSize, set for a frame compressed by AFNetCompress
+    static const uint32_t ARK_MSG_COMPRESS_FLAG = 0x80000000;
+
+    AFCMsgHead(): munSize(0), munMsgID(0), mxPlayerID(0), mbCompressed(false)
     {
     }
 
@@ -137,7 +143,7 @@ public:
         memcpy(strData + nOffset, (void*)(&nMsgID), sizeof(munMsgID));
         nOffset += sizeof(munMsgID);
 
-        uint32_t nPackSize = munSize + ARK_MSG_HEAD_LENGTH;
+        uint32_t nPackSize = (munSize + ARK_MSG_HEAD_LENGTH) | (mbCompressed ? ARK_MSG_COMPRESS_FLAG : 0);
         uint32_t nSize = ARK_HTONL(nPackSize);
         memcpy(strData + nOffset, (void*)(&nSize), sizeof(munSize));
         nOffset += sizeof(munSize);
@@ -158,6 +164,19 @@ public:
         return nOffset;
     }
 
+    //write PlayerID only, into a head already encoded at strData
+    void EnCodePlayerID(char* strData) const
+    {
+        uint32_t nOffset = sizeof(munMsgID) + sizeof(munSize);
+
+        uint64_t nHightData = ARK_HTONLL(mxPlayerID.nHigh);
+        memcpy(strData + nOffset, (void*)(&nHightData), sizeof(nHightData));
+        nOffset += sizeof(nHightData);
+
+        uint64_t nLowData = ARK_HTONLL(mxPlayerID.nLow);
+        memcpy(strData + nOffset, (void*)(&nLowData), sizeof(nLowData));
+    }
+
     // Message Head[ MsgID(2) | MsgSize(4) | PlayerID(16) ]
     virtual int DeCode(const char* strData)
     {
@@ -170,7 +189,9 @@ public:
 
         uint32_t nPackSize(0);
         memcpy(&nPackSize, strData + nOffset, sizeof(munSize));
-        munSize = ARK_NTOHL(nPackSize) - ARK_MSG_HEAD_LENGTH;
+        nPackSize = (uint32_t)ARK_NTOHL(nPackSize);
+        mbCompressed = ((nPackSize & ARK_MSG_COMPRESS_FLAG) != 0);
+        munSize = (nPackSize & ~ARK_MSG_COMPRESS_FLAG) - ARK_MSG_HEAD_LENGTH;
         nOffset += sizeof(munSize);
 
 
@@ -220,17 +241,185 @@ public:
         mxPlayerID = xPlayerID;
     }
 
+    bool IsCompressed() const
+    {
+        return mbCompressed;
+    }
+
+    void SetCompressed(bool bCompressed)
+    {
+        mbCompressed = bCompressed;
+    }
+
+private:
+    uint32_t munSize;
+    uint16_t munMsgID;
+    AFGUID mxPlayerID;
+    bool mbCompressed;
+};
+
+//Compact head of client links[ BodyLength << 1 | Compressed (varint) | MsgID (varint) ], 2 or 3 bytes for small frames.
+//There is no PlayerID, the session already tells the player, so it is 0 after DeCode
+class AFCCompactMsgHead : public AFIMsgHead
+{
+public:
+    enum
+    {
+        ARK_COMPACT_HEAD_MAX_LENGTH = 8, //5 bytes of size and 3 bytes of msg id
+    };
+
+    AFCCompactMsgHead() : munSize(0), munMsgID(0), mxPlayerID(0), mbCompressed(false)
+    {
+    }
+
+    virtual ~AFCCompactMsgHead() {}
+
+    virtual int EnCode(char* strData) const
+    {
+        int nOffset = WriteVarint(strData, (uint64_t(munSize) << 1) | (mbCompressed ? 1 : 0));
+        nOffset += WriteVarint(strData + nOffset, munMsgID);
+        return nOffset;
+    }
+
+    //strData must hold a whole head, see PeekHead
+    virtual int DeCode(const char* strData)
+    {
+        return PeekHead(strData, ARK_COMPACT_HEAD_MAX_LENGTH);
+    }
+
+    //decode the head at the beginning of nLen bytes, return its length, 0 when it is not whole yet, -1 when it is bad
+    int PeekHead(const char* strData, const size_t nLen)
+    {
+        uint64_t nSizeField = 0;
+        uint64_t nMsgID = 0;
+
+        int nSizeLen = ReadVarint(strData, nLen, 5, nSizeField);
+
+        if (nSizeLen <= 0)
+        {
+            return nSizeLen;
+        }
+
+        int nMsgIDLen = ReadVarint(strData + nSizeLen, nLen - nSizeLen, 3, nMsgID);
+
+        if (nMsgIDLen <= 0)
+        {
+            return nMsgIDLen;
+        }
+
+        if ((nSizeField >> 1) > 0x7FFFFFFF || nMsgID > 0xFFFF)
+        {
+            return -1;
+        }
+
+        munSize = uint32_t(nSizeField >> 1);
+        mbCompressed = ((nSizeField & 1) != 0);
+        munMsgID = uint16_t(nMsgID);
+        mxPlayerID = AFGUID(0);
+
+        return nSizeLen + nMsgIDLen;
+    }
+
+    virtual uint16_t GetMsgID() const
+    {
+        return munMsgID;
+    }
+
+    virtual void SetMsgID(uint16_t nMsgID)
+    {
+        munMsgID = nMsgID;
+    }
+
+    virtual uint32_t GetBodyLength() const
+    {
+        return munSize;
+    }
+
+    virtual void SetBodyLength(size_t nLength)
+    {
+        munSize = (uint32_t)nLength;
+    }
+
+    //kept for the caller only, never on the wire
+    virtual const AFGUID& GetPlayerID() const
+    {
+        return mxPlayerID;
+    }
+
+    virtual void SetPlayerID(const AFGUID& xPlayerID)
+    {
+        mxPlayerID = xPlayerID;
+    }
+
+    bool IsCompressed() const
+    {
+        return mbCompressed;
+    }
+
+    void SetCompressed(bool bCompressed)
+    {
+        mbCompressed = bCompressed;
+    }
+
 private:
+    static int WriteVarint(char* strData, uint64_t nValue)
+    {
+        int nOffset = 0;
+
+        while (nValue >= 0x80)
+        {
+            strData[nOffset++] = char((nValue & 0x7F) | 0x80);
+            nValue >>= 7;
+        }
+
+        strData[nOffset++] = char(nValue);
+        return nOffset;
+    }
+
+    static int ReadVarint(const char* strData, const size_t nLen, const int nMaxBytes, uint64_t& nValue)
+    {
+        nValue = 0;
+
+        for (int i = 0; i < nMaxBytes; ++i)
+        {
+            if (size_t(i) >= nLen)
+            {
+                return 0;
+            }
+
+            const uint8_t nByte = uint8_t(strData[i]);
+            nValue |= uint64_t(nByte & 0x7F) << (7 * i);
+
+            if ((nByte & 0x80) == 0)
+            {
+                return i + 1;
+            }
+        }
+
+        return -1;
+    }
+
     uint32_t munSize;
     uint16_t munMsgID;
     AFGUID mxPlayerID;
+    bool mbCompressed;
 };
+
 enum NetEventType
 {
     NONE = 0,
     CONNECTED = 1,
     DISCONNECTED = 2,
     RECIVEDATA = 3,
+    SENDHIGHWATER = 4, //send backlog of the session went over the high water mark
+    SENDLOWWATER = 5,  //send backlog of the session is back under the low water mark
+};
+
+//outbound lanes of a session, see AFINet::SetMsgLane
+enum AFNetLane
+{
+    ARK_NET_LANE_REALTIME = 0,
+    ARK_NET_LANE_BULK = 1,
 };
 
 typedef std::function<void(const AFIMsgHead& xHead, const int nMsgID, const char* msg, const size_t nLen, const AFGUID& nClientID)> NET_RECEIVE_FUNCTOR;
@@ -282,6 +471,12 @@ public:
         return mstrBuff.getdata();
     }
 
+    //reference of the block holding GetBuff(), the data stay valid until it is released
+    AFBufferChunk* ShareBuff()
+    {
+        return mstrBuff.sharechunk();
+    }
+
     size_t GetBuffLen()
     {
         return mstrBuff.getlength();
@@ -328,12 +523,52 @@ private:
     mutable bool bNeedRemove;
 };
 
+//Counters of cork mode
+struct AFNetCorkStats
+{
+    uint64_t nMsgCount{ 0 };   //packets queued while corked
+    uint64_t nSendCount{ 0 };  //packets really handed to sessions, every one is a wakeup and a write of io thread
+    uint64_t nFlushCount{ 0 }; //session flushes
+};
+
+//Options of the reliable udp links of AFCKcpNetServer/AFCKcpNetClient, see AFNetKcp
+struct AFNetKcpConfig
+{
+    bool bNoDelay{ true };    //min rto of 30ms, and acks and sends are flushed at once
+    int nInterval{ 10 };      //ms between flushes
+    int nResend{ 2 };         //fast retransmit after this many acks skip a segment, 0 disables
+    bool bNoCwnd{ true };     //only the send and receive windows limit sending
+    uint32_t nSndWnd{ 256 };  //segments
+    uint32_t nRcvWnd{ 256 };  //segments
+    uint32_t nMtu{ 1200 };    //bytes of a datagram
+    uint32_t nTimeout{ 10000 }; //ms without any datagram of the peer
+};
+
+//Artificial loss and delay of the udp datagrams a side sends, for tests on loopback.
+//Set it on both sides for a lossy link in both directions
+struct AFNetFaultConfig
+{
+    double dLoss{ 0.0 };    //0 - 1
+    uint32_t nDelay{ 0 };   //ms
+    uint32_t nJitter{ 0 };  //ms, a random 0 - nJitter is added to nDelay
+};
+
 class AFINet
 {
 public:
-    AFINet() : bWorking(false), nReceiverSize(0), nSendSize(0) {}
+    AFINet() : bWorking(false), mbCork(false), mnCorkFlushBytes(ARK_CORK_FLUSH_BYTES), mnCorkMaxDelay(ARK_CORK_MAX_DELAY), mnListenerCount(1), mbBindCpu(false), mnSendLowWater(0), mnSendHighWater(0), mnSendLimit(0), mnBulkChunkBytes(ARK_BULK_CHUNK_BYTES), mnCompressMinSize(0), mbCompactHead(false), mnStatsTime(0), nReceiverSize(0), nSendSize(0) {}
+
+    enum
+    {
+        ARK_CORK_FLUSH_BYTES = 16 * 1024,
+        ARK_CORK_MAX_DELAY = 50, //ms
+        ARK_BULK_CHUNK_BYTES = 32 * 1024,
+    };
 
-    virtual ~AFINet() = default;
+    virtual ~AFINet()
+    {
+        AFNetStats::GetInstance().RemoveSessionStats(this);
+    }
 
     //need to call this function every frame to drive network library
     virtual void Update() = 0;
@@ -360,8 +595,198 @@ public:
         return false;
     }
 
+    //send a message with out msg-head to the clients in list[auto add msg-head in this function, only encode once]
+    virtual bool SendMsgToClientListWithOutHead(const uint16_t nMsgID, const char* msg, const size_t nLen, const std::vector<AFGUID>& xClientIDList, const AFGUID& xPlayerID)
+    {
+        for (const auto& xClientID : xClientIDList)
+        {
+            SendMsgWithOutHead(nMsgID, msg, nLen, xClientID, xPlayerID);
+        }
+
+        return true;
+    }
+
+    //forward a received frame: msg must be the body handed to a receive callback, its head is right before it.
+    //The frame is queued as it is with only PlayerID rewritten, no head encoding and no parse
+    virtual bool SendMsgFrame(const AFIMsgHead& xHead, const char* msg, const size_t nLen, const AFGUID& xClientID, const AFGUID& xPlayerID)
+    {
+        return SendMsgWithOutHead(xHead.GetMsgID(), msg, nLen, xClientID, xPlayerID);
+    }
+
+    //send a packet which already has msg-head[the session queues the packet itself, no copy]
+    virtual bool SendMsgPacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, const AFGUID& xClientID)
+    {
+        AFCMsgHead xHead;
+
+        if (!DeCodePacket(xPacket, xHead))
+        {
+            return false;
+        }
+
+        return SendMsgWithOutHead(xHead.GetMsgID(), xPacket->data() + AFIMsgHead::ARK_MSG_HEAD_LENGTH, xHead.GetBodyLength(), xClientID, xHead.GetPlayerID());
+    }
+
+    //send a packet which already has msg-head to all client
+    virtual bool SendMsgPacketToAllClient(const brynet::net::DataSocket::PACKET_PTR& xPacket)
+    {
+        AFCMsgHead xHead;
+
+        if (!DeCodePacket(xPacket, xHead))
+        {
+            return false;
+        }
+
+        return SendMsgToAllClientWithOutHead(xHead.GetMsgID(), xPacket->data() + AFIMsgHead::ARK_MSG_HEAD_LENGTH, xHead.GetBodyLength(), xHead.GetPlayerID());
+    }
+
+    //send a packet which already has msg-head to the clients in list
+    virtual bool SendMsgPacketToClientList(const brynet::net::DataSocket::PACKET_PTR& xPacket, const std::vector<AFGUID>& xClientIDList)
+    {
+        AFCMsgHead xHead;
+
+        if (!DeCodePacket(xPacket, xHead))
+        {
+            return false;
+        }
+
+        return SendMsgToClientListWithOutHead(xHead.GetMsgID(), xPacket->data() + AFIMsgHead::ARK_MSG_HEAD_LENGTH, xHead.GetBodyLength(), xClientIDList, xHead.GetPlayerID());
+    }
+
     virtual bool CloseNetEntity(const AFGUID& xClientID) = 0;
 
+    //cork mode: sends are gathered per session and flushed once every Update,
+    //or when a session has nFlushBytes pending or its oldest pending send is older than nMaxDelay(ms).
+    //The delay is checked by the sends of logic thread, so a frame which sends nothing after it is flushed by Update:
+    //the delay is bounded by the logic frame then
+    void SetCork(bool bEnable, size_t nFlushBytes = ARK_CORK_FLUSH_BYTES, uint32_t nMaxDelay = ARK_CORK_MAX_DELAY)
+    {
+        mbCork = bEnable;
+        mnCorkFlushBytes = nFlushBytes;
+        mnCorkMaxDelay = nMaxDelay;
+
+        if (!bEnable)
+        {
+            Flush();
+        }
+    }
+
+    bool IsCork() const
+    {
+        return mbCork;
+    }
+
+    //send all the gathered data now
+    virtual void Flush() {}
+
+    const AFNetCorkStats& GetCorkStats() const
+    {
+        return mxCorkStats;
+    }
+
+    //server only, limits of the bytes queued to every session and not written to the socket yet, 0 disables a limit.
+    //Over nHighWater the handlers get SENDHIGHWATER and can send less to the session, SENDLOWWATER comes when the
+    //backlog is under nLowWater again. Over nLimit the packet is dropped and the session is disconnected
+    void SetSendWaterMark(size_t nLowWater, size_t nHighWater, size_t nLimit)
+    {
+        mnSendLowWater = nLowWater;
+        mnSendHighWater = nHighWater;
+        mnSendLimit = nLimit;
+    }
+
+    //server only. Frames of the bulk msg ids (e.g. logs, mail or ranking pages) wait in a lane of the session and are handed
+    //to it while it has less than nBulkChunkBytes in flight, so the realtime frames sent later are not queued behind them.
+    //Realtime frames may overtake bulk ones, the order is kept inside a lane: a msg which later realtime frames depend on,
+    //like the entering snapshot of an entity and its deltas, must stay in the realtime lane
+    void SetMsgLane(const uint16_t nMsgID, const AFNetLane eLane)
+    {
+        mxBulkMsgIDs.set(nMsgID, eLane == ARK_NET_LANE_BULK);
+    }
+
+    void SetBulkChunk(const size_t nBulkChunkBytes)
+    {
+        mnBulkChunkBytes = (nBulkChunkBytes > 0 ? nBulkChunkBytes : (size_t)ARK_BULK_CHUNK_BYTES);
+    }
+
+    bool IsBulkMsg(const uint16_t nMsgID) const
+    {
+        return mxBulkMsgIDs.test(nMsgID);
+    }
+
+    //Frames of the opted in msg ids with a body of at least nMinSize are compressed on the io thread, only for the
+    //peers which announced they can read them. A client with compression announces it on connect, a server with
+    //compression answers the announce. 0 disables. Compressed frames are only read when
+    //compression is on here or the peer announced it, other peers are disconnected for them
+    void SetCompress(const size_t nMinSize)
+    {
+        mnCompressMinSize = nMinSize;
+    }
+
+    void SetMsgCompress(const uint16_t nMsgID, const bool bCompress)
+    {
+        mxCompressMsgIDs.set(nMsgID, bCompress);
+    }
+
+    bool IsCompress() const
+    {
+        return mnCompressMinSize > 0;
+    }
+
+    //a packet of one frame which should be compressed
+    bool NeedCompress(const brynet::net::DataSocket::PACKET_PTR& xPacket) const
+    {
+        if (mnCompressMinSize == 0 || xPacket->size() < AFIMsgHead::ARK_MSG_HEAD_LENGTH + mnCompressMinSize)
+        {
+            return false;
+        }
+
+        AFCMsgHead xHead;
+
+        if (!DeCodePacket(xPacket, xHead))
+        {
+            return false;
+        }
+
+        return (!xHead.IsCompressed() && mxCompressMsgIDs.test(xHead.GetMsgID()));
+    }
+
+    //call before Start, all the links of this net use AFCCompactMsgHead on the wire, the peers must be set the same.
+    //Received frames are still handed over with AFCMsgHead and PlayerID 0, sends are converted at the session
+    void SetCompactHead(bool bCompact)
+    {
+        mbCompactHead = bCompact;
+    }
+
+    bool IsCompactHead() const
+    {
+        return mbCompactHead;
+    }
+
+    //udp links only, call before Start
+    void SetKcpConfig(const AFNetKcpConfig& xConfig)
+    {
+        mxKcpConfig = xConfig;
+    }
+
+    const AFNetKcpConfig& GetKcpConfig() const
+    {
+        return mxKcpConfig;
+    }
+
+    //udp links only, call before Start
+    void SetFaultInjection(const AFNetFaultConfig& xConfig)
+    {
+        mxFaultConfig = xConfig;
+    }
+
+    //server only, call before Start
+    //nCount > 1 starts nCount listeners on the same port with SO_REUSEPORT, each feeds its own worker threads,
+    //bBindCpu pins the listener and its workers to one core. Falls back to one listener where SO_REUSEPORT is not supported
+    void SetListener(int nCount, bool bBindCpu = false)
+    {
+        mnListenerCount = (nCount > 0 ? nCount : 1);
+        mbBindCpu = bBindCpu;
+    }
+
     virtual bool IsServer() = 0;
 
     virtual bool Log(int severity, const char* msg) = 0;
@@ -427,28 +852,1001 @@ public:
         bWorking = value;
     }
 
-private:
-    bool bWorking;
+    //head of a packet made by AFNetPacketPool
+    static bool DeCodePacket(const brynet::net::DataSocket::PACKET_PTR& xPacket, AFCMsgHead& xHead)
+    {
+        if (xPacket == nullptr || xPacket->size() < AFIMsgHead::ARK_MSG_HEAD_LENGTH)
+        {
+            return false;
+        }
 
-public:
-    size_t nReceiverSize;
-    size_t nSendSize;
-};
+        xHead.DeCode(xPacket->data());
+        return (xHead.GetBodyLength() + AFIMsgHead::ARK_MSG_HEAD_LENGTH == xPacket->size());
+    }
 
-//////////////////////////////////////////////////////////////////////////
+    //length of the whole frames at the beginning of pData
+    static size_t GetFramesLength(const char* pData, const size_t nLen)
+    {
+        size_t nOffset = 0;
 
-template <typename SessionPTR>
-class AFNetMsg
-{
-public:
-    AFNetMsg(const SessionPTR session_ptr) : nType(NONE), mxSession(session_ptr) {}
+        while (nLen - nOffset >= AFIMsgHead::ARK_MSG_HEAD_LENGTH)
+        {
+            AFCMsgHead xHead;
+            xHead.DeCode(pData + nOffset);
 
-    NetEventType nType;
-    AFGUID xClientID;
-    SessionPTR mxSession;
-    std::string strMsg;
-    AFCMsgHead xHead;
-};
+            size_t nFrameLen = xHead.GetBodyLength() + AFIMsgHead::ARK_MSG_HEAD_LENGTH;
+
+            if (xHead.GetMsgID() <= 0 || nFrameLen > nLen - nOffset)
+            {
+                break;
+            }
+
+            nOffset += nFrameLen;
+        }
+
+        return nOffset;
+    }
+
+    //call back every frame of the data counted by GetFramesLength
+    static void DispatchFrames(const char* pData, const size_t nLen, const AFGUID& xClientID, const NET_RECEIVE_FUNCTOR& cb)
+    {
+        size_t nOffset = 0;
+
+        while (nOffset < nLen)
+        {
+            AFCMsgHead xHead;
+            nOffset += xHead.DeCode(pData + nOffset);
+
+            const auto xStart = std::chrono::steady_clock::now();
+            cb(xHead, xHead.GetMsgID(), pData + nOffset, xHead.GetBodyLength(), xClientID);
+            const auto xUsed = std::chrono::steady_clock::now() - xStart;
+
+            AFNetStats::RecordRecv(xHead.GetMsgID(), xHead.GetBodyLength() + AFIMsgHead::ARK_MSG_HEAD_LENGTH, std::chrono::duration_cast<std::chrono::nanoseconds>(xUsed).count());
+            nOffset += xHead.GetBodyLength();
+        }
+    }
+
+    //gauges of every session, used by telemetry
+    virtual void GetSessionStats(std::vector<AFNetSessionStat>& xList) {}
+
+private:
+    bool bWorking;
+
+protected:
+    static int64_t GetCorkTime()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //called by Update of logic thread, publish the session gauges and merge the counters once per second
+    void UpdateStats()
+    {
+        const int64_t nNow = GetCorkTime();
+
+        if (nNow - mnStatsTime < AFNetStats::ARK_STATS_INTERVAL)
+        {
+            return;
+        }
+
+        mnStatsTime = nNow;
+
+        std::vector<AFNetSessionStat> xList;
+        GetSessionStats(xList);
+        AFNetStats::GetInstance().SetSessionStats(this, xList);
+        AFNetStats::GetInstance().Merge(nNow);
+    }
+
+    //msg id of a packet starting with msg-head
+    static uint16_t GetPacketMsgID(const brynet::net::DataSocket::PACKET_PTR& xPacket)
+    {
+        uint16_t nMsgID(0);
+
+        if (xPacket->size() >= sizeof(nMsgID))
+        {
+            memcpy(&nMsgID, xPacket->data(), sizeof(nMsgID));
+        }
+
+        return ntohs(nMsgID);
+    }
+
+    bool mbCork;
+    size_t mnCorkFlushBytes;
+    uint32_t mnCorkMaxDelay;
+    AFNetCorkStats mxCorkStats;
+
+    int mnListenerCount;
+    bool mbBindCpu;
+
+    size_t mnSendLowWater;
+    size_t mnSendHighWater;
+    size_t mnSendLimit;
+
+    std::bitset<65536> mxBulkMsgIDs;
+    size_t mnBulkChunkBytes;
+
+    std::bitset<65536> mxCompressMsgIDs;
+    size_t mnCompressMinSize;
+
+    bool mbCompactHead;
+
+    AFNetKcpConfig mxKcpConfig;
+    AFNetFaultConfig mxFaultConfig;
+
+    int64_t mnStatsTime;
+
+public:
+    size_t nReceiverSize;
+    size_t nSendSize;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+//Pool of outbound packets.
+//A frame[head + body] is built once in a pooled string and queued to the session as it is,
+//brynet gathers the queued packets of a session into one writev, the string comes back here after sent.
+class AFNetPacketPool
+{
+public:
+    enum
+    {
+        ARK_PACKET_MAX_CACHE = 4096,
+        ARK_PACKET_MAX_SIZE = 64 * 1024, //bigger strings are not cached
+    };
+
+    static AFNetPacketPool& GetInstance()
+    {
+        static AFNetPacketPool xPool;
+        return xPool;
+    }
+
+    ~AFNetPacketPool()
+    {
+        for (auto pData : mxFreeList)
+        {
+            delete pData;
+        }
+
+        mxFreeList.clear();
+    }
+
+    brynet::net::DataSocket::PACKET_PTR Alloc(const size_t nSize)
+    {
+        std::string* pData = nullptr;
+
+        do
+        {
+            std::lock_guard<AFSpinLock> xGuard(mxLock);
+
+            if (!mxFreeList.empty())
+            {
+                pData = mxFreeList.back();
+                mxFreeList.pop_back();
+            }
+        } while (0);
+
+        if (pData == nullptr)
+        {
+            pData = new std::string();
+        }
+
+        pData->reserve(nSize);
+        return brynet::net::DataSocket::PACKET_PTR(pData, [](std::string * pData)
+        {
+            AFNetPacketPool::GetInstance().Free(pData);
+        });
+    }
+
+    //xHead must have the body length set
+    brynet::net::DataSocket::PACKET_PTR EnCode(const AFIMsgHead& xHead, const char* msg, const size_t nLen)
+    {
+        brynet::net::DataSocket::PACKET_PTR xPacket = Alloc(AFIMsgHead::ARK_MSG_HEAD_LENGTH + nLen);
+        xPacket->resize(AFIMsgHead::ARK_MSG_HEAD_LENGTH);
+        xHead.EnCode(&(*xPacket)[0]);
+        xPacket->append(msg, nLen);
+        return xPacket;
+    }
+
+private:
+    void Free(std::string* pData)
+    {
+        if (pData->capacity() <= ARK_PACKET_MAX_SIZE)
+        {
+            pData->clear();
+
+            std::lock_guard<AFSpinLock> xGuard(mxLock);
+
+            if (mxFreeList.size() < ARK_PACKET_MAX_CACHE)
+            {
+                mxFreeList.push_back(pData);
+                return;
+            }
+        }
+
+        delete pData;
+    }
+
+    AFSpinLock mxLock;
+    std::vector<std::string*> mxFreeList;
+};
+
+//Compression of big frames, used by io threads.
+//A compressed frame has ARK_MSG_COMPRESS_FLAG in the MsgSize of its head and its body is [ RawLength(4) | LZ4 block ].
+//A peer announces it can read compressed frames with a ARK_NET_MSG_CAPS frame, the frame is handled here
+//and never reaches the receive callbacks
+class AFNetCompress
+{
+public:
+    enum
+    {
+        ARK_NET_MSG_CAPS = 0xFFFF,
+        ARK_NET_CAPS_LZ4 = 1,
+        ARK_RAW_LENGTH_SIZE = 4,
+        ARK_COMPRESS_MAX_SIZE = 16 * 1024 * 1024, //bigger bodies are not compressed, and not accepted
+        ARK_COMPRESS_MAX_RATIO = 255,             //lz4 can not inflate a block more than this
+        ARK_UNPACK_MAX_SIZE = 32 * 1024 * 1024,   //output of the frames of one read, more is bad data
+    };
+
+    static brynet::net::DataSocket::PACKET_PTR MakeCapsFrame()
+    {
+        const char nCaps = ARK_NET_CAPS_LZ4;
+
+        AFCMsgHead xHead;
+        xHead.SetMsgID(ARK_NET_MSG_CAPS);
+        xHead.SetBodyLength(sizeof(nCaps));
+
+        return AFNetPacketPool::GetInstance().EnCode(xHead, &nCaps, sizeof(nCaps));
+    }
+
+    //compressed copy of a packet of one frame, nullptr when it does not get smaller
+    static brynet::net::DataSocket::PACKET_PTR Compress(const brynet::net::DataSocket::PACKET_PTR& xPacket)
+    {
+        AFCMsgHead xHead;
+        xHead.DeCode(xPacket->data());
+
+        const size_t nBodyLen = xHead.GetBodyLength();
+
+        if (nBodyLen > ARK_COMPRESS_MAX_SIZE)
+        {
+            return nullptr;
+        }
+
+        const auto xStart = std::chrono::steady_clock::now();
+
+        const int nBound = lz4::compress_bound((int)nBodyLen);
+        const size_t nBlockOffset = AFIMsgHead::ARK_MSG_HEAD_LENGTH + ARK_RAW_LENGTH_SIZE;
+        brynet::net::DataSocket::PACKET_PTR xOut = AFNetPacketPool::GetInstance().Alloc(nBlockOffset + nBound);
+        xOut->resize(nBlockOffset + nBound);
+
+        const int nBlockLen = lz4::compress(xPacket->data() + AFIMsgHead::ARK_MSG_HEAD_LENGTH, &(*xOut)[nBlockOffset], (int)nBodyLen, nBound);
+        const bool bSmaller = (nBlockLen > 0 && (size_t)nBlockLen + ARK_RAW_LENGTH_SIZE < nBodyLen);
+
+        if (bSmaller)
+        {
+            xOut->resize(nBlockOffset + nBlockLen);
+
+            xHead.SetCompressed(true);
+            xHead.SetBodyLength(ARK_RAW_LENGTH_SIZE + nBlockLen);
+            xHead.EnCode(&(*xOut)[0]);
+            WriteRawLength(&(*xOut)[AFIMsgHead::ARK_MSG_HEAD_LENGTH], (uint32_t)nBodyLen);
+        }
+
+        const auto xUsed = std::chrono::steady_clock::now() - xStart;
+        AFNetStats::RecordCompress(xHead.GetMsgID(), nBodyLen, (bSmaller ? ARK_RAW_LENGTH_SIZE + nBlockLen : nBodyLen), std::chrono::duration_cast<std::chrono::nanoseconds>(xUsed).count());
+
+        return (bSmaller ? xOut : nullptr);
+    }
+
+    //whole frames with compressed or caps frames, which must go through Unpack
+    static bool NeedUnpack(const char* pData, const size_t nLen)
+    {
+        size_t nOffset = 0;
+
+        while (nOffset < nLen)
+        {
+            AFCMsgHead xHead;
+            xHead.DeCode(pData + nOffset);
+
+            if (xHead.IsCompressed() || xHead.GetMsgID() == ARK_NET_MSG_CAPS)
+            {
+                return true;
+            }
+
+            nOffset += AFIMsgHead::ARK_MSG_HEAD_LENGTH + xHead.GetBodyLength();
+        }
+
+        return false;
+    }
+
+    //copy the whole frames to a new chunk with the bodies decompressed and the caps frames taken out.
+    //Compressed frames are bad data unless bAcceptCompressed or the peer announced compression, the raw length of a
+    //frame is checked against its block before anything is allocated. pChunk is nullptr when nothing is left, return false for bad data
+    static bool Unpack(const char* pData, const size_t nLen, const bool bAcceptCompressed, AFBufferChunk*& pChunk, size_t& nOutLen, uint8_t& nPeerCaps)
+    {
+        pChunk = nullptr;
+        nOutLen = 0;
+
+        size_t nOffset = 0;
+
+        while (nOffset < nLen)
+        {
+            AFCMsgHead xHead;
+            xHead.DeCode(pData + nOffset);
+
+            const char* pBody = pData + nOffset + AFIMsgHead::ARK_MSG_HEAD_LENGTH;
+            const size_t nBodyLen = xHead.GetBodyLength();
+
+            if (xHead.GetMsgID() == ARK_NET_MSG_CAPS)
+            {
+                nPeerCaps |= (nBodyLen > 0 ? (uint8_t)pBody[0] : 0);
+            }
+            else if (xHead.IsCompressed())
+            {
+                if (!bAcceptCompressed && (nPeerCaps & ARK_NET_CAPS_LZ4) == 0)
+                {
+                    return false;
+                }
+
+                if (nBodyLen <= ARK_RAW_LENGTH_SIZE)
+                {
+                    return false;
+                }
+
+                const size_t nRawLen = ReadRawLength(pBody);
+
+                if (nRawLen > ARK_COMPRESS_MAX_SIZE || nRawLen > (nBodyLen - ARK_RAW_LENGTH_SIZE) * ARK_COMPRESS_MAX_RATIO)
+                {
+                    return false;
+                }
+
+                nOutLen += AFIMsgHead::ARK_MSG_HEAD_LENGTH + nRawLen;
+            }
+            else
+            {
+                nOutLen += AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen;
+            }
+
+            if (nOutLen > ARK_UNPACK_MAX_SIZE)
+            {
+                return false;
+            }
+
+            nOffset += AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen;
+        }
+
+        if (nOutLen == 0)
+        {
+            return true;
+        }
+
+        pChunk = AFBufferChunk::Create(nOutLen);
+
+        if (pChunk == nullptr)
+        {
+            return false;
+        }
+
+        char* pOut = pChunk->GetData();
+        nOffset = 0;
+
+        while (nOffset < nLen)
+        {
+            AFCMsgHead xHead;
+            xHead.DeCode(pData + nOffset);
+
+            const char* pBody = pData + nOffset + AFIMsgHead::ARK_MSG_HEAD_LENGTH;
+            const size_t nBodyLen = xHead.GetBodyLength();
+            nOffset += AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen;
+
+            if (xHead.GetMsgID() == ARK_NET_MSG_CAPS)
+            {
+                continue;
+            }
+
+            if (!xHead.IsCompressed())
+            {
+                memcpy(pOut, pBody - AFIMsgHead::ARK_MSG_HEAD_LENGTH, AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen);
+                pOut += AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen;
+                continue;
+            }
+
+            const auto xStart = std::chrono::steady_clock::now();
+            const uint32_t nRawLen = ReadRawLength(pBody);
+
+            xHead.SetCompressed(false);
+            xHead.SetBodyLength(nRawLen);
+            xHead.EnCode(pOut);
+            pOut += AFIMsgHead::ARK_MSG_HEAD_LENGTH;
+
+            if (lz4::decompress(pBody + ARK_RAW_LENGTH_SIZE, pOut, (int)(nBodyLen - ARK_RAW_LENGTH_SIZE), (int)nRawLen) != (int)nRawLen)
+            {
+                pChunk->Release();
+                pChunk = nullptr;
+                return false;
+            }
+
+            pOut += nRawLen;
+
+            const auto xUsed = std::chrono::steady_clock::now() - xStart;
+            AFNetStats::RecordDecompress(xHead.GetMsgID(), std::chrono::duration_cast<std::chrono::nanoseconds>(xUsed).count());
+        }
+
+        return true;
+    }
+
+private:
+    static void WriteRawLength(char* pData, const uint32_t nLen)
+    {
+        pData[0] = (char)(nLen >> 24);
+        pData[1] = (char)(nLen >> 16);
+        pData[2] = (char)(nLen >> 8);
+        pData[3] = (char)nLen;
+    }
+
+    static uint32_t ReadRawLength(const char* pData)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(pData);
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+};
+
+//Conversion between the wire formats and the AFCMsgHead frames used inside
+class AFNetFrameCodec
+{
+public:
+    //io thread: take the whole frames out of the entity buffer as AFCMsgHead frames, compact heads expanded,
+    //compressed frames inflated and caps frames taken out. pChunk keeps pData alive and is nullptr when nothing is left.
+    //Plain frames are not copied, compact frames are, see ExpandCompact. Compressed frames are only read with bAcceptCompressed,
+    //see Unpack. Return false for bad data
+    static bool Take(AFBaseNetEntity* pEntity, const bool bCompactHead, const bool bAcceptCompressed, AFBufferChunk*& pChunk, const char*& pData, size_t& nLen, uint8_t& nPeerCaps)
+    {
+        pChunk = nullptr;
+        pData = nullptr;
+        nLen = 0;
+
+        size_t nFramesLen = 0;
+
+        if (bCompactHead)
+        {
+            size_t nFullLen = 0;
+
+            if (!GetCompactFramesLength(pEntity->GetBuff(), pEntity->GetBuffLen(), nFramesLen, nFullLen))
+            {
+                return false;
+            }
+
+            if (nFramesLen == 0)
+            {
+                return true;
+            }
+
+            pChunk = ExpandCompact(pEntity->GetBuff(), nFramesLen, nFullLen);
+
+            if (pChunk == nullptr)
+            {
+                return false;
+            }
+
+            pData = pChunk->GetData();
+            nLen = nFullLen;
+        }
+        else
+        {
+            nFramesLen = AFINet::GetFramesLength(pEntity->GetBuff(), pEntity->GetBuffLen());
+
+            if (nFramesLen == 0)
+            {
+                return true;
+            }
+
+            pData = pEntity->GetBuff();
+            nLen = nFramesLen;
+        }
+
+        if (AFNetCompress::NeedUnpack(pData, nLen))
+        {
+            //compressed or caps frames are rare, only they pay a copy
+            AFBufferChunk* pUnpacked = nullptr;
+            size_t nUnpackedLen = 0;
+            bool bRet = AFNetCompress::Unpack(pData, nLen, bAcceptCompressed, pUnpacked, nUnpackedLen, nPeerCaps);
+
+            if (pChunk != nullptr)
+            {
+                pChunk->Release();
+            }
+
+            pChunk = pUnpacked;
+
+            if (!bRet)
+            {
+                return false;
+            }
+
+            pData = (pChunk != nullptr ? pChunk->GetData() : nullptr);
+            nLen = nUnpackedLen;
+        }
+        else if (pChunk == nullptr)
+        {
+            pChunk = pEntity->ShareBuff();
+        }
+
+        pEntity->RemoveBuff(nFramesLen);
+        return true;
+    }
+
+    //length of the whole compact frames at the beginning of pData, and their length with AFCMsgHead
+    static bool GetCompactFramesLength(const char* pData, const size_t nLen, size_t& nFramesLen, size_t& nFullLen)
+    {
+        nFramesLen = 0;
+        nFullLen = 0;
+
+        while (nFramesLen < nLen)
+        {
+            AFCCompactMsgHead xHead;
+            const int nHeadLen = xHead.PeekHead(pData + nFramesLen, nLen - nFramesLen);
+
+            if (nHeadLen < 0 || (nHeadLen > 0 && xHead.GetMsgID() == 0))
+            {
+                return false;
+            }
+
+            if (nHeadLen == 0 || xHead.GetBodyLength() > nLen - nFramesLen - nHeadLen)
+            {
+                break;
+            }
+
+            nFramesLen += nHeadLen + xHead.GetBodyLength();
+            nFullLen += AFIMsgHead::ARK_MSG_HEAD_LENGTH + xHead.GetBodyLength();
+        }
+
+        return true;
+    }
+
+    //compact frames counted by GetCompactFramesLength to AFCMsgHead frames in a new chunk.
+    //This is one copy of the bodies per receive, the cost of the smaller heads: the logic thread reads AFCMsgHead frames
+    //back to back, so a compact link does not get the slice of the receive block the plain links get
+    static AFBufferChunk* ExpandCompact(const char* pData, const size_t nFramesLen, const size_t nFullLen)
+    {
+        AFBufferChunk* pChunk = AFBufferChunk::Create(nFullLen);
+
+        if (pChunk == nullptr)
+        {
+            return nullptr;
+        }
+
+        char* pOut = pChunk->GetData();
+        size_t nOffset = 0;
+
+        while (nOffset < nFramesLen)
+        {
+            AFCCompactMsgHead xCompact;
+            const int nHeadLen = xCompact.PeekHead(pData + nOffset, nFramesLen - nOffset);
+
+            AFCMsgHead xHead;
+            xHead.SetMsgID(xCompact.GetMsgID());
+            xHead.SetBodyLength(xCompact.GetBodyLength());
+            xHead.SetCompressed(xCompact.IsCompressed());
+            pOut += xHead.EnCode(pOut);
+
+            memcpy(pOut, pData + nOffset + nHeadLen, xCompact.GetBodyLength());
+            pOut += xCompact.GetBodyLength();
+            nOffset += nHeadLen + xCompact.GetBodyLength();
+
+            AFNetStats::RecordHeadSaved(xCompact.GetMsgID(), AFIMsgHead::ARK_MSG_HEAD_LENGTH - nHeadLen);
+        }
+
+        return pChunk;
+    }
+
+    //copy of a packet of AFCMsgHead frames with compact heads
+    static brynet::net::DataSocket::PACKET_PTR PackCompact(const brynet::net::DataSocket::PACKET_PTR& xPacket)
+    {
+        brynet::net::DataSocket::PACKET_PTR xOut = AFNetPacketPool::GetInstance().Alloc(xPacket->size());
+        size_t nOffset = 0;
+
+        while (nOffset + AFIMsgHead::ARK_MSG_HEAD_LENGTH <= xPacket->size())
+        {
+            AFCMsgHead xHead;
+            xHead.DeCode(xPacket->data() + nOffset);
+            nOffset += AFIMsgHead::ARK_MSG_HEAD_LENGTH;
+
+            AFCCompactMsgHead xCompact;
+            xCompact.SetMsgID(xHead.GetMsgID());
+            xCompact.SetBodyLength(xHead.GetBodyLength());
+            xCompact.SetCompressed(xHead.IsCompressed());
+
+            char szHead[AFCCompactMsgHead::ARK_COMPACT_HEAD_MAX_LENGTH];
+            const int nHeadLen = xCompact.EnCode(szHead);
+            xOut->append(szHead, nHeadLen);
+            xOut->append(xPacket->data() + nOffset, xHead.GetBodyLength());
+            nOffset += xHead.GetBodyLength();
+
+            AFNetStats::RecordHeadSaved(xHead.GetMsgID(), AFIMsgHead::ARK_MSG_HEAD_LENGTH - nHeadLen);
+        }
+
+        return xOut;
+    }
+};
+
+//Pending output of one session in cork mode, only used by logic thread.
+class AFNetCorkBuffer
+{
+public:
+    enum
+    {
+        ARK_CORK_MERGE_SIZE = 1024, //smaller packets are copied together, bigger(e.g. broadcast) ones are sent as they are
+    };
+
+    AFNetCorkBuffer() : mnBytes(0), mnFirstTime(0), mbTailOwned(false) {}
+
+    bool Empty() const
+    {
+        return mxPackets.empty();
+    }
+
+    size_t GetBytes() const
+    {
+        return mnBytes;
+    }
+
+    int64_t GetFirstTime() const
+    {
+        return mnFirstTime;
+    }
+
+    void Add(const brynet::net::DataSocket::PACKET_PTR& xPacket, const int64_t nNow)
+    {
+        if (mxPackets.empty())
+        {
+            mnFirstTime = nNow;
+        }
+
+        mxPackets.push_back(xPacket);
+        mnBytes += xPacket->size();
+        mbTailOwned = false;
+    }
+
+    //copy a frame to the end of the pending output, return where it was copied to.
+    //Small frames share the last packet while it was made here and stays under ARK_CORK_MERGE_SIZE
+    char* Append(const char* pData, const size_t nLen, const int64_t nNow)
+    {
+        if (mxPackets.empty())
+        {
+            mnFirstTime = nNow;
+        }
+
+        if (!mbTailOwned || mxPackets.empty() || mxPackets.back()->size() + nLen > ARK_CORK_MERGE_SIZE)
+        {
+            mxPackets.push_back(AFNetPacketPool::GetInstance().Alloc(nLen > ARK_CORK_MERGE_SIZE ? nLen : (size_t)ARK_CORK_MERGE_SIZE));
+            mbTailOwned = true;
+        }
+
+        std::string& xTail = *mxPackets.back();
+        const size_t nOffset = xTail.size();
+        xTail.append(pData, nLen);
+        mnBytes += nLen;
+
+        return &xTail[nOffset];
+    }
+
+    //send the pending packets to the entity in order with as few packets as possible, return how many were sent
+    template<typename EntityPTR>
+    size_t Flush(const EntityPTR& pEntity)
+    {
+        size_t nSendCount = 0;
+        size_t nMergeStart = 0;
+        size_t nMergeBytes = 0;
+
+        for (size_t i = 0; i <= mxPackets.size(); ++i)
+        {
+            if (i < mxPackets.size() && mxPackets[i]->size() < ARK_CORK_MERGE_SIZE)
+            {
+                nMergeBytes += mxPackets[i]->size();
+                continue;
+            }
+
+            if (i - nMergeStart == 1)
+            {
+                pEntity->Send(mxPackets[nMergeStart]);
+                ++nSendCount;
+            }
+            else if (i - nMergeStart > 1)
+            {
+                brynet::net::DataSocket::PACKET_PTR xMerge = AFNetPacketPool::GetInstance().Alloc(nMergeBytes);
+
+                for (size_t j = nMergeStart; j < i; ++j)
+                {
+                    xMerge->append(*mxPackets[j]);
+                }
+
+                pEntity->Send(xMerge);
+                ++nSendCount;
+            }
+
+            if (i < mxPackets.size())
+            {
+                pEntity->Send(mxPackets[i]);
+                ++nSendCount;
+            }
+
+            nMergeStart = i + 1;
+            nMergeBytes = 0;
+        }
+
+        Clear();
+        return nSendCount;
+    }
+
+    void Clear()
+    {
+        mxPackets.clear();
+        mnBytes = 0;
+        mnFirstTime = 0;
+        mbTailOwned = false;
+    }
+
+private:
+    std::vector<brynet::net::DataSocket::PACKET_PTR> mxPackets;
+    size_t mnBytes;
+    int64_t mnFirstTime;
+    bool mbTailOwned; //last packet was made by Append, nobody else holds it
+};
+
+//Bulk lane of one session, only used by logic thread.
+//The packets are handed to the session in order, a chunk at a time, so the session never holds much more bulk data
+//than the chunk in front of the realtime packets. Frames are not split, the wire format stays the same
+class AFNetBulkLane
+{
+public:
+    AFNetBulkLane() : mnBytes(0) {}
+
+    bool Empty() const
+    {
+        return mxPackets.empty();
+    }
+
+    size_t GetBytes() const
+    {
+        return mnBytes;
+    }
+
+    void Add(const brynet::net::DataSocket::PACKET_PTR& xPacket)
+    {
+        mxPackets.push_back(xPacket);
+        mnBytes += xPacket->size();
+    }
+
+    //send while the entity has less than nChunkBytes in flight, return how many were sent
+    template<typename EntityPTR>
+    size_t Pump(const EntityPTR& pEntity, const size_t nChunkBytes)
+    {
+        size_t nSendCount = 0;
+
+        while (!mxPackets.empty() && pEntity->GetSendQueueBytes() < nChunkBytes)
+        {
+            mnBytes -= mxPackets.front()->size();
+            pEntity->Send(mxPackets.front());
+            mxPackets.pop_front();
+            ++nSendCount;
+        }
+
+        return nSendCount;
+    }
+
+    void Clear()
+    {
+        mxPackets.clear();
+        mnBytes = 0;
+    }
+
+private:
+    std::deque<brynet::net::DataSocket::PACKET_PTR> mxPackets;
+    size_t mnBytes;
+};
+
+//Recycling pool of net messages.
+//Every thread keeps two chains of at most ARK_NET_MSG_BATCH messages, the messages freed by
+//the logic thread go back to the io threads through the shared list one whole chain at a time.
+template <typename MsgType>
+class AFNetMsgPool
+{
+public:
+    enum
+    {
+        ARK_NET_MSG_BATCH = 64,
+        ARK_NET_MSG_MAX_BATCH = 1024, //max chains kept in the shared list
+    };
+
+    static AFNetMsgPool& GetInstance()
+    {
+        static AFNetMsgPool xPool;
+        return xPool;
+    }
+
+    ~AFNetMsgPool()
+    {
+        for (auto pChain : mxBatches)
+        {
+            DeleteChain(pChain);
+        }
+
+        mxBatches.clear();
+    }
+
+    MsgType* Alloc()
+    {
+        ThreadCache& xCache = GetCache();
+
+        if (xCache.pCurrent == nullptr)
+        {
+            if (xCache.pFull != nullptr)
+            {
+                xCache.pCurrent = xCache.pFull;
+                xCache.pFull = nullptr;
+            }
+            else
+            {
+                std::lock_guard<AFSpinLock> xGuard(mxLock);
+
+                if (!mxBatches.empty())
+                {
+                    xCache.pCurrent = mxBatches.back();
+                    mxBatches.pop_back();
+                }
+            }
+
+            xCache.nCurrentCount = (xCache.pCurrent != nullptr ? ARK_NET_MSG_BATCH : 0);
+        }
+
+        if (xCache.pCurrent == nullptr)
+        {
+            return ARK_NEW MsgType();
+        }
+
+        MsgType* pMsg = xCache.pCurrent;
+        xCache.pCurrent = pMsg->pNext;
+        --xCache.nCurrentCount;
+        pMsg->pNext = nullptr;
+        return pMsg;
+    }
+
+    void Free(MsgType* pMsg)
+    {
+        ThreadCache& xCache = GetCache();
+
+        if (xCache.nCurrentCount == ARK_NET_MSG_BATCH)
+        {
+            if (xCache.pFull != nullptr)
+            {
+                PushBatch(xCache.pFull);
+            }
+
+            xCache.pFull = xCache.pCurrent;
+            xCache.pCurrent = nullptr;
+            xCache.nCurrentCount = 0;
+        }
+
+        pMsg->pNext = xCache.pCurrent;
+        xCache.pCurrent = pMsg;
+        ++xCache.nCurrentCount;
+    }
+
+private:
+    struct ThreadCache
+    {
+        ThreadCache() : pCurrent(nullptr), nCurrentCount(0), pFull(nullptr) {}
+
+        ~ThreadCache()
+        {
+            DeleteChain(pCurrent);
+            DeleteChain(pFull);
+        }
+
+        MsgType* pCurrent;
+        size_t nCurrentCount;
+        MsgType* pFull; //always ARK_NET_MSG_BATCH messages
+    };
+
+    static ThreadCache& GetCache()
+    {
+        static thread_local ThreadCache xCache;
+        return xCache;
+    }
+
+    static void DeleteChain(MsgType* pChain)
+    {
+        while (pChain != nullptr)
+        {
+            MsgType* pNext = pChain->pNext;
+            delete pChain;
+            pChain = pNext;
+        }
+    }
+
+    void PushBatch(MsgType* pChain)
+    {
+        do
+        {
+            std::lock_guard<AFSpinLock> xGuard(mxLock);
+
+            if (mxBatches.size() < ARK_NET_MSG_MAX_BATCH)
+            {
+                mxBatches.push_back(pChain);
+                return;
+            }
+        } while (0);
+
+        DeleteChain(pChain);
+    }
+
+    AFSpinLock mxLock;
+    std::vector<MsgType*> mxBatches;
+};
+
+template <typename SessionPTR>
+class AFNetMsg
+{
+public:
+    AFNetMsg() : nType(NONE), pChunk(nullptr), pData(nullptr), nLen(0), pNext(nullptr) {}
+    AFNetMsg(const SessionPTR session_ptr) : nType(NONE), mxSession(session_ptr), pChunk(nullptr), pData(nullptr), nLen(0), pNext(nullptr) {}
+
+    ~AFNetMsg()
+    {
+        Reset();
+    }
+
+    AFNetMsg(const AFNetMsg&) = delete;
+    AFNetMsg& operator=(const AFNetMsg&) = delete;
+
+    //take a message from the pool, must be given back by Release
+    static AFNetMsg* Create(const SessionPTR& session_ptr)
+    {
+        AFNetMsg* pMsg = AFNetMsgPool<AFNetMsg>::GetInstance().Alloc();
+
+        if (pMsg != nullptr)
+        {
+            pMsg->mxSession = session_ptr;
+        }
+
+        return pMsg;
+    }
+
+    static void Release(AFNetMsg* pMsg)
+    {
+        if (pMsg == nullptr)
+        {
+            return;
+        }
+
+        pMsg->Reset();
+        AFNetMsgPool<AFNetMsg>::GetInstance().Free(pMsg);
+    }
+
+    void Reset()
+    {
+        if (pChunk != nullptr)
+        {
+            pChunk->Release();
+            pChunk = nullptr;
+        }
+
+        nType = NONE;
+        xClientID = 0;
+        mxSession = nullptr;
+        pData = nullptr;
+        nLen = 0;
+    }
+
+    NetEventType nType;
+    AFGUID xClientID;
+    SessionPTR mxSession;
+
+    //RECIVEDATA: whole frames[head + body] left in the receive block, pChunk keeps them alive
+    AFBufferChunk* pChunk;
+    const char* pData;
+    size_t nLen;
+
+    AFNetMsg* pNext; //used by AFNetMsgPool
+};
 
 using AFTCPMsg = AFNetMsg<brynet::net::TCPSession::PTR>;
 using AFHttpMsg = AFNetMsg<brynet::net::HttpSession::PTR>;
@@ -457,7 +1855,7 @@ template <typename SessionPTR>
 class AFNetEntity : public AFBaseNetEntity
 {
 public:
-    AFNetEntity(AFINet* pNet, const AFGUID& xClientID, const SessionPTR session) : AFBaseNetEntity(pNet, xClientID), mxSession(session)
+    AFNetEntity(AFINet* pNet, const AFGUID& xClientID, const SessionPTR session) : AFBaseNetEntity(pNet, xClientID), mbSendHighWater(false), mbInReadyList(false), mbPeerCompress(false), m_pSendQueueBytes(std::make_shared<std::atomic<size_t>>(0)), mxSession(session)
     {
     }
 
@@ -474,7 +1872,86 @@ public:
     AFGUID xHttpClientID;
 
     AFLockFreeQueue<AFNetMsg<SessionPTR>*> mxNetMsgMQ;
+    AFNetCorkBuffer mxCorkBuffer;
+    AFNetBulkLane mxBulkLane;
+
+    //worker thread: return true if the caller should put the entity to the ready list
+    bool MarkReady()
+    {
+        return !mbInReadyList.exchange(true);
+    }
+
+    //logic thread: call before handling the messages, so the new ones will mark it again
+    void ClearReady()
+    {
+        mbInReadyList.store(false);
+    }
+
+    //logic thread: queue a packet to the session, its bytes are counted until the io thread has written them
+    void Send(const brynet::net::DataSocket::PACKET_PTR& xPacket)
+    {
+        const size_t nSize = xPacket->size();
+        m_pSendQueueBytes->fetch_add(nSize, std::memory_order_relaxed);
+
+        //the callbacks hold the counter, not the entity, they may run after the entity is deleted
+        const std::shared_ptr<std::atomic<size_t>> pSendQueueBytes = m_pSendQueueBytes;
+
+        const bool bCompactHead = GetNet()->IsCompactHead();
+
+        if (IsPeerCompress() && GetNet()->NeedCompress(xPacket))
+        {
+            //compressed by the io thread of the session, the task is queued to its loop like the sends, so the order is kept
+            const SessionPTR xSession = mxSession;
+            mxSession->getEventLoop()->runAsyncProc([pSendQueueBytes, xSession, xPacket, nSize, bCompactHead]()
+            {
+                brynet::net::DataSocket::PACKET_PTR xOut = AFNetCompress::Compress(xPacket);
+                xOut = (xOut != nullptr ? xOut : xPacket);
+
+                xSession->send(bCompactHead ? AFNetFrameCodec::PackCompact(xOut) : xOut, [pSendQueueBytes, nSize]()
+                {
+                    pSendQueueBytes->fetch_sub(nSize, std::memory_order_relaxed);
+                });
+            });
+
+            return;
+        }
+
+        mxSession->send(bCompactHead ? AFNetFrameCodec::PackCompact(xPacket) : xPacket, [pSendQueueBytes, nSize]()
+        {
+            pSendQueueBytes->fetch_sub(nSize, std::memory_order_relaxed);
+        });
+    }
+
+    //bytes queued in the session, not written to the socket yet
+    size_t GetSendQueueBytes() const
+    {
+        return m_pSendQueueBytes->load(std::memory_order_relaxed);
+    }
+
+    //bytes gathered by cork, waiting in bulk lane and queued in the session
+    size_t GetSendBacklog() const
+    {
+        return GetSendQueueBytes() + mxCorkBuffer.GetBytes() + mxBulkLane.GetBytes();
+    }
+
+    //set by io thread when the peer announced it reads compressed frames
+    void SetPeerCompress(bool bCompress)
+    {
+        mbPeerCompress.store(bCompress, std::memory_order_relaxed);
+    }
+
+    bool IsPeerCompress() const
+    {
+        return mbPeerCompress.load(std::memory_order_relaxed);
+    }
+
+    //logic thread only, set between SENDHIGHWATER and SENDLOWWATER
+    bool mbSendHighWater;
+
 private:
+    std::atomic<bool> mbInReadyList;
+    std::atomic<bool> mbPeerCompress;
+    std::shared_ptr<std::atomic<size_t>> m_pSendQueueBytes;
     const SessionPTR mxSession;
 };
 
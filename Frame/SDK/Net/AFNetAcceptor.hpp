@@ -0,0 +1,206 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+
+#pragma once
+
+#include "SDK/Core/AFPlatform.hpp"
+#include "SDK/Core/AFNoncopyable.hpp"
+
+#if ARK_PLATFORM == PLATFORM_UNIX
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+//Listener bound with SO_REUSEPORT, several of them can listen on the same port,
+//the kernel spreads the incoming connections between them, so a login storm is not queued behind one accept loop.
+//Every acceptor has its own accept thread, the accepted fd is handed to the callback on that thread.
+class AFNetAcceptor : public AFNoncopyable
+{
+public:
+    using ACCEPT_CALLBACK = std::function<void(int)>;
+
+    AFNetAcceptor() : mnFD(-1), mnCpuIndex(-1), mbRunning(false), mnAcceptCount(0) {}
+
+    ~AFNetAcceptor()
+    {
+        Stop();
+    }
+
+    static bool IsReusePortSupported()
+    {
+#if ARK_PLATFORM == PLATFORM_UNIX && defined(SO_REUSEPORT)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static int GetCpuCount()
+    {
+        int nCount = (int)std::thread::hardware_concurrency();
+        return (nCount > 0 ? nCount : 1);
+    }
+
+    //pin the calling thread to a core, nCpuIndex < 0 means no binding
+    static bool BindCpu(int nCpuIndex)
+    {
+#if ARK_PLATFORM == PLATFORM_UNIX && defined(__linux__)
+        if (nCpuIndex < 0)
+        {
+            return false;
+        }
+
+        cpu_set_t xSet;
+        CPU_ZERO(&xSet);
+        CPU_SET(nCpuIndex % GetCpuCount(), &xSet);
+        return (pthread_setaffinity_np(pthread_self(), sizeof(xSet), &xSet) == 0);
+#else
+        return false;
+#endif
+    }
+
+    //a non-blocking listen socket bound with SO_REUSEPORT, -1 when it fails. strHost is empty or "0.0.0.0" for all address
+    static int Listen(const std::string& strHost, const int nPort)
+    {
+#if ARK_PLATFORM == PLATFORM_UNIX && defined(SO_REUSEPORT)
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        if (fd < 0)
+        {
+            return -1;
+        }
+
+        int nOpt = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &nOpt, sizeof(nOpt));
+
+        sockaddr_in xAddr;
+        memset(&xAddr, 0, sizeof(xAddr));
+        xAddr.sin_family = AF_INET;
+        xAddr.sin_port = htons((uint16_t)nPort);
+        xAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &nOpt, sizeof(nOpt)) != 0
+                || (!strHost.empty() && inet_pton(AF_INET, strHost.c_str(), &xAddr.sin_addr) != 1)
+                || bind(fd, (sockaddr*)&xAddr, sizeof(xAddr)) != 0
+                || listen(fd, SOMAXCONN) != 0
+                || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+
+        return fd;
+#else
+        return -1;
+#endif
+    }
+
+    //strHost is empty or "0.0.0.0" for all address, nCpuIndex is the core of accept thread
+    bool Start(const std::string& strHost, const int nPort, const int nCpuIndex, const ACCEPT_CALLBACK& cb)
+    {
+        if (mbRunning || cb == nullptr)
+        {
+            return false;
+        }
+
+        int fd = Listen(strHost, nPort);
+
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        mnFD = fd;
+        mnCpuIndex = nCpuIndex;
+        mxCallBack = cb;
+        mbRunning = true;
+        mxThread = std::thread(&AFNetAcceptor::Run, this);
+        return true;
+    }
+
+    void Stop()
+    {
+#if ARK_PLATFORM == PLATFORM_UNIX
+        mbRunning = false;
+
+        if (mxThread.joinable())
+        {
+            mxThread.join();
+        }
+
+        if (mnFD >= 0)
+        {
+            close(mnFD);
+            mnFD = -1;
+        }
+#endif
+    }
+
+    uint64_t GetAcceptCount() const
+    {
+        return mnAcceptCount;
+    }
+
+private:
+    void Run()
+    {
+#if ARK_PLATFORM == PLATFORM_UNIX
+        BindCpu(mnCpuIndex);
+
+        pollfd xPoll;
+        xPoll.fd = mnFD;
+        xPoll.events = POLLIN;
+
+        while (mbRunning)
+        {
+            //wake up in time to check stop
+            if (poll(&xPoll, 1, 100) <= 0)
+            {
+                continue;
+            }
+
+            //drain the accept queue of this listener
+            while (mbRunning)
+            {
+                int fd = accept(mnFD, nullptr, nullptr);
+
+                if (fd < 0)
+                {
+                    break;
+                }
+
+                ++mnAcceptCount;
+                mxCallBack(fd);
+            }
+        }
+#endif
+    }
+
+    int mnFD;
+    int mnCpuIndex;
+    std::atomic<bool> mbRunning;
+    std::atomic<uint64_t> mnAcceptCount;
+    ACCEPT_CALLBACK mxCallBack;
+    std::thread mxThread;
+};
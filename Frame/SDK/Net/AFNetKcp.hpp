@@ -0,0 +1,855 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "SDK/Core/AFPlatform.hpp"
+#include "SDK/Core/AFNoncopyable.hpp"
+
+//ARQ over datagrams in the way of KCP, in stream mode: the bytes of Send come out of Recv in the same order,
+//cut into segments of at most mss bytes. The wire format is the one of KCP, 24 bytes of segment head in little endian.
+//Selective and cumulative acks, rto from the measured rtt, fast retransmit after nResend acks skip a segment,
+//and a congestion window which can be turned off. Not thread safe, the owner locks it.
+class AFNetKcp : public AFNoncopyable
+{
+public:
+    using OUTPUT_FUNCTOR = std::function<void(const char*, const size_t)>;
+
+    enum
+    {
+        ARK_KCP_CMD_PUSH = 81,
+        ARK_KCP_CMD_ACK = 82,
+        ARK_KCP_CMD_WASK = 83, //ask the window size of the remote
+        ARK_KCP_CMD_WINS = 84, //tell the window size
+        ARK_KCP_ASK_SEND = 1,
+        ARK_KCP_ASK_TELL = 2,
+        ARK_KCP_OVERHEAD = 24,
+        ARK_KCP_RTO_NDL = 30, //min rto in no delay mode
+        ARK_KCP_RTO_MIN = 100,
+        ARK_KCP_RTO_DEF = 200,
+        ARK_KCP_RTO_MAX = 60000,
+        ARK_KCP_WND_SND = 32,
+        ARK_KCP_WND_RCV = 128,
+        ARK_KCP_MTU_DEF = 1400,
+        ARK_KCP_INTERVAL = 100,
+        ARK_KCP_DEAD_LINK = 20, //transmissions of one segment
+        ARK_KCP_THRESH_INIT = 2,
+        ARK_KCP_THRESH_MIN = 2,
+        ARK_KCP_PROBE_INIT = 7000,
+        ARK_KCP_PROBE_LIMIT = 120000,
+        ARK_KCP_FAST_LIMIT = 5,
+    };
+
+    AFNetKcp(const uint32_t nConv, const OUTPUT_FUNCTOR& xOutput) :
+        mnConv(nConv),
+        mnMtu(ARK_KCP_MTU_DEF),
+        mnMss(ARK_KCP_MTU_DEF - ARK_KCP_OVERHEAD),
+        mnState(0),
+        mnSndUna(0),
+        mnSndNxt(0),
+        mnRcvNxt(0),
+        mnSsthresh(ARK_KCP_THRESH_INIT),
+        mnRxRttVal(0),
+        mnRxSrtt(0),
+        mnRxRto(ARK_KCP_RTO_DEF),
+        mnRxMinRto(ARK_KCP_RTO_MIN),
+        mnSndWnd(ARK_KCP_WND_SND),
+        mnRcvWnd(ARK_KCP_WND_RCV),
+        mnRmtWnd(ARK_KCP_WND_RCV),
+        mnCwnd(0),
+        mnProbe(0),
+        mnCurrent(0),
+        mnInterval(ARK_KCP_INTERVAL),
+        mnTsFlush(ARK_KCP_INTERVAL),
+        mnXmit(0),
+        mbNoDelay(false),
+        mbUpdated(false),
+        mnTsProbe(0),
+        mnProbeWait(0),
+        mnDeadLink(ARK_KCP_DEAD_LINK),
+        mnIncr(0),
+        mnFastResend(0),
+        mnFastLimit(ARK_KCP_FAST_LIMIT),
+        mbNoCwnd(false),
+        mxOutput(xOutput)
+    {
+    }
+
+    void SetConv(const uint32_t nConv)
+    {
+        mnConv = nConv;
+    }
+
+    uint32_t GetConv() const
+    {
+        return mnConv;
+    }
+
+    //ms of the steady clock, the time base of Update and Check
+    static uint32_t GetClock()
+    {
+        return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //conv of a datagram, 0 if it is too short
+    static uint32_t GetConv(const char* pData, const size_t nLen)
+    {
+        return (nLen >= sizeof(uint32_t) ? Decode32((const uint8_t*)pData) : 0);
+    }
+
+    //bNoDelay: min rto of 30ms and a slower rto backoff, nInterval: ms between flushes,
+    //nResend: retransmit a segment skipped by this many acks at once, 0 disables, bNoCwnd: only the windows limit sending
+    void SetNoDelay(const bool bNoDelay, const int nInterval, const int nResend, const bool bNoCwnd)
+    {
+        mbNoDelay = bNoDelay;
+        mnRxMinRto = (bNoDelay ? ARK_KCP_RTO_NDL : ARK_KCP_RTO_MIN);
+        mnInterval = (uint32_t)std::max(10, std::min(5000, nInterval));
+        mnFastResend = (nResend > 0 ? nResend : 0);
+        mbNoCwnd = bNoCwnd;
+    }
+
+    //in segments
+    void SetWndSize(const uint32_t nSndWnd, const uint32_t nRcvWnd)
+    {
+        if (nSndWnd > 0)
+        {
+            mnSndWnd = nSndWnd;
+        }
+
+        if (nRcvWnd > 0)
+        {
+            mnRcvWnd = nRcvWnd;
+        }
+    }
+
+    bool SetMtu(const uint32_t nMtu)
+    {
+        if (nMtu < 50)
+        {
+            return false;
+        }
+
+        mnMtu = nMtu;
+        mnMss = nMtu - ARK_KCP_OVERHEAD;
+        return true;
+    }
+
+    uint32_t GetMss() const
+    {
+        return mnMss;
+    }
+
+    uint32_t GetInterval() const
+    {
+        return mnInterval;
+    }
+
+    bool IsNoDelay() const
+    {
+        return mbNoDelay;
+    }
+
+    //a segment was sent ARK_KCP_DEAD_LINK times without an ack
+    bool IsDeadLink() const
+    {
+        return mnState < 0;
+    }
+
+    //segments not acked yet
+    size_t GetWaitSnd() const
+    {
+        return mxSndBuf.size() + mxSndQueue.size();
+    }
+
+    //queue bytes to send, they are appended to the last segment not sent yet
+    void Send(const char* pData, size_t nLen)
+    {
+        if (!mxSndQueue.empty() && mxSndQueue.back().strData.size() < mnMss)
+        {
+            std::string& strLast = mxSndQueue.back().strData;
+            const size_t nCopy = std::min<size_t>(nLen, mnMss - strLast.size());
+            strLast.append(pData, nCopy);
+            pData += nCopy;
+            nLen -= nCopy;
+        }
+
+        while (nLen > 0)
+        {
+            const size_t nCopy = std::min<size_t>(nLen, mnMss);
+            mxSndQueue.emplace_back();
+            mxSndQueue.back().strData.assign(pData, nCopy);
+            pData += nCopy;
+            nLen -= nCopy;
+        }
+    }
+
+    //hand the bytes received in order to func(const char*, size_t), return the count of bytes
+    template<typename FUNC>
+    size_t Recv(FUNC&& func)
+    {
+        if (mxRcvQueue.empty())
+        {
+            return 0;
+        }
+
+        const bool bRecover = (mxRcvQueue.size() >= mnRcvWnd);
+        size_t nBytes = 0;
+
+        for (const auto& xSeg : mxRcvQueue)
+        {
+            func(xSeg.strData.data(), xSeg.strData.size());
+            nBytes += xSeg.strData.size();
+        }
+
+        mxRcvQueue.clear();
+        MoveRcvBuf();
+
+        //the window was full, tell the remote it is open again
+        if (bRecover && mxRcvQueue.size() < mnRcvWnd)
+        {
+            mnProbe |= ARK_KCP_ASK_TELL;
+        }
+
+        return nBytes;
+    }
+
+    //a datagram from the remote, false for a bad one
+    bool Input(const char* pData, size_t nLen)
+    {
+        const uint32_t nPrevUna = mnSndUna;
+        uint32_t nMaxAck = 0;
+        bool bAck = false;
+
+        if (nLen < ARK_KCP_OVERHEAD)
+        {
+            return false;
+        }
+
+        while (nLen >= ARK_KCP_OVERHEAD)
+        {
+            const uint8_t* p = (const uint8_t*)pData;
+            Segment xSeg;
+            xSeg.nConv = Decode32(p);
+            xSeg.nCmd = p[4];
+            xSeg.nFrg = p[5];
+            xSeg.nWnd = Decode16(p + 6);
+            xSeg.nTs = Decode32(p + 8);
+            xSeg.nSn = Decode32(p + 12);
+            xSeg.nUna = Decode32(p + 16);
+            const uint32_t nDataLen = Decode32(p + 20);
+
+            pData += ARK_KCP_OVERHEAD;
+            nLen -= ARK_KCP_OVERHEAD;
+
+            if (xSeg.nConv != mnConv || nLen < nDataLen)
+            {
+                return false;
+            }
+
+            if (xSeg.nCmd < ARK_KCP_CMD_PUSH || xSeg.nCmd > ARK_KCP_CMD_WINS)
+            {
+                return false;
+            }
+
+            mnRmtWnd = xSeg.nWnd;
+            ParseUna(xSeg.nUna);
+            ShrinkBuf();
+
+            switch (xSeg.nCmd)
+            {
+            case ARK_KCP_CMD_ACK:
+                {
+                    if (TimeDiff(mnCurrent, xSeg.nTs) >= 0)
+                    {
+                        UpdateAck(TimeDiff(mnCurrent, xSeg.nTs));
+                    }
+
+                    ParseAck(xSeg.nSn);
+                    ShrinkBuf();
+
+                    if (!bAck || TimeDiff(xSeg.nSn, nMaxAck) > 0)
+                    {
+                        bAck = true;
+                        nMaxAck = xSeg.nSn;
+                    }
+                }
+                break;
+
+            case ARK_KCP_CMD_PUSH:
+                {
+                    if (TimeDiff(xSeg.nSn, mnRcvNxt + mnRcvWnd) < 0)
+                    {
+                        mxAckList.emplace_back(xSeg.nSn, xSeg.nTs);
+
+                        if (TimeDiff(xSeg.nSn, mnRcvNxt) >= 0)
+                        {
+                            xSeg.strData.assign(pData, nDataLen);
+                            ParseData(std::move(xSeg));
+                        }
+                    }
+                }
+                break;
+
+            case ARK_KCP_CMD_WASK:
+                mnProbe |= ARK_KCP_ASK_TELL;
+                break;
+
+            default:
+                break;
+            }
+
+            pData += nDataLen;
+            nLen -= nDataLen;
+        }
+
+        if (bAck)
+        {
+            ParseFastAck(nMaxAck);
+        }
+
+        //grow the congestion window with the new acks
+        if (TimeDiff(mnSndUna, nPrevUna) > 0 && mnCwnd < mnRmtWnd)
+        {
+            if (mnCwnd < mnSsthresh)
+            {
+                ++mnCwnd;
+                mnIncr += mnMss;
+            }
+            else
+            {
+                mnIncr = std::max(mnIncr, mnMss);
+                mnIncr += (mnMss * mnMss) / mnIncr + (mnMss / 16);
+
+                if ((mnCwnd + 1) * mnMss <= mnIncr)
+                {
+                    mnCwnd = (mnIncr + mnMss - 1) / mnMss;
+                }
+            }
+
+            if (mnCwnd > mnRmtWnd)
+            {
+                mnCwnd = mnRmtWnd;
+                mnIncr = mnRmtWnd * mnMss;
+            }
+        }
+
+        return true;
+    }
+
+    //acks waiting for the next flush
+    bool HasPendingAck() const
+    {
+        return !mxAckList.empty();
+    }
+
+    //call it every interval or at the time of Check, nCurrent in ms
+    void Update(const uint32_t nCurrent)
+    {
+        mnCurrent = nCurrent;
+
+        if (!mbUpdated)
+        {
+            mbUpdated = true;
+            mnTsFlush = nCurrent;
+        }
+
+        int32_t nSlap = TimeDiff(nCurrent, mnTsFlush);
+
+        if (nSlap >= 10000 || nSlap < -10000)
+        {
+            mnTsFlush = nCurrent;
+            nSlap = 0;
+        }
+
+        if (nSlap >= 0)
+        {
+            mnTsFlush += mnInterval;
+
+            if (TimeDiff(nCurrent, mnTsFlush) >= 0)
+            {
+                mnTsFlush = nCurrent + mnInterval;
+            }
+
+            Flush();
+        }
+    }
+
+    //the time Update should be called next
+    uint32_t Check(const uint32_t nCurrent) const
+    {
+        if (!mbUpdated)
+        {
+            return nCurrent;
+        }
+
+        uint32_t nTsFlush = mnTsFlush;
+
+        if (TimeDiff(nCurrent, nTsFlush) >= 10000 || TimeDiff(nCurrent, nTsFlush) < -10000)
+        {
+            nTsFlush = nCurrent;
+        }
+
+        if (TimeDiff(nCurrent, nTsFlush) >= 0)
+        {
+            return nCurrent;
+        }
+
+        uint32_t nMinimal = (uint32_t)TimeDiff(nTsFlush, nCurrent);
+
+        for (const auto& xSeg : mxSndBuf)
+        {
+            const int32_t nDiff = TimeDiff(xSeg.nResendTs, nCurrent);
+
+            if (nDiff <= 0)
+            {
+                return nCurrent;
+            }
+
+            nMinimal = std::min(nMinimal, (uint32_t)nDiff);
+        }
+
+        return nCurrent + std::min(nMinimal, mnInterval);
+    }
+
+    //send the acks, window probes and the segments allowed by the windows now
+    void Flush(const uint32_t nCurrent)
+    {
+        mnCurrent = nCurrent;
+        Flush();
+    }
+
+private:
+    struct Segment
+    {
+        Segment() : nConv(0), nCmd(0), nFrg(0), nWnd(0), nTs(0), nSn(0), nUna(0), nResendTs(0), nRto(0), nFastAck(0), nXmit(0) {}
+
+        uint32_t nConv;
+        uint32_t nCmd;
+        uint32_t nFrg;
+        uint32_t nWnd;
+        uint32_t nTs;
+        uint32_t nSn;
+        uint32_t nUna;
+        uint32_t nResendTs;
+        uint32_t nRto;
+        uint32_t nFastAck;
+        uint32_t nXmit;
+        std::string strData;
+    };
+
+    static int32_t TimeDiff(const uint32_t nLater, const uint32_t nEarlier)
+    {
+        return (int32_t)(nLater - nEarlier);
+    }
+
+    static uint16_t Decode16(const uint8_t* p)
+    {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+
+    static uint32_t Decode32(const uint8_t* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static void Encode16(std::string& strOut, const uint32_t nValue)
+    {
+        strOut.push_back((char)(nValue & 0xFF));
+        strOut.push_back((char)((nValue >> 8) & 0xFF));
+    }
+
+    static void Encode32(std::string& strOut, const uint32_t nValue)
+    {
+        Encode16(strOut, nValue & 0xFFFF);
+        Encode16(strOut, nValue >> 16);
+    }
+
+    static void EncodeSeg(std::string& strOut, const Segment& xSeg, const uint32_t nDataLen)
+    {
+        Encode32(strOut, xSeg.nConv);
+        strOut.push_back((char)xSeg.nCmd);
+        strOut.push_back((char)xSeg.nFrg);
+        Encode16(strOut, xSeg.nWnd);
+        Encode32(strOut, xSeg.nTs);
+        Encode32(strOut, xSeg.nSn);
+        Encode32(strOut, xSeg.nUna);
+        Encode32(strOut, nDataLen);
+    }
+
+    void UpdateAck(int32_t nRtt)
+    {
+        //the ts is echoed by the peer, a forged or wrapped one must not overflow the arithmetic below
+        if (nRtt < 0)
+        {
+            return;
+        }
+
+        nRtt = std::min<int32_t>(nRtt, ARK_KCP_RTO_MAX);
+
+        if (mnRxSrtt == 0)
+        {
+            mnRxSrtt = nRtt;
+            mnRxRttVal = nRtt / 2;
+        }
+        else
+        {
+            const int32_t nDelta = std::abs(nRtt - mnRxSrtt);
+            mnRxRttVal = (3 * mnRxRttVal + nDelta) / 4;
+            mnRxSrtt = std::max(1, (7 * mnRxSrtt + nRtt) / 8);
+        }
+
+        const int32_t nRto = mnRxSrtt + std::max<int32_t>(mnInterval, 4 * mnRxRttVal);
+        mnRxRto = std::max<int32_t>(mnRxMinRto, std::min<int32_t>(nRto, ARK_KCP_RTO_MAX));
+    }
+
+    void ShrinkBuf()
+    {
+        mnSndUna = (mxSndBuf.empty() ? mnSndNxt : mxSndBuf.front().nSn);
+    }
+
+    void ParseAck(const uint32_t nSn)
+    {
+        if (TimeDiff(nSn, mnSndUna) < 0 || TimeDiff(nSn, mnSndNxt) >= 0)
+        {
+            return;
+        }
+
+        for (auto iter = mxSndBuf.begin(); iter != mxSndBuf.end(); ++iter)
+        {
+            if (iter->nSn == nSn)
+            {
+                mxSndBuf.erase(iter);
+                break;
+            }
+
+            if (TimeDiff(nSn, iter->nSn) < 0)
+            {
+                break;
+            }
+        }
+    }
+
+    void ParseUna(const uint32_t nUna)
+    {
+        while (!mxSndBuf.empty() && TimeDiff(nUna, mxSndBuf.front().nSn) > 0)
+        {
+            mxSndBuf.pop_front();
+        }
+    }
+
+    void ParseFastAck(const uint32_t nSn)
+    {
+        if (TimeDiff(nSn, mnSndUna) < 0 || TimeDiff(nSn, mnSndNxt) >= 0)
+        {
+            return;
+        }
+
+        for (auto& xSeg : mxSndBuf)
+        {
+            if (TimeDiff(nSn, xSeg.nSn) < 0)
+            {
+                break;
+            }
+            else if (nSn != xSeg.nSn)
+            {
+                ++xSeg.nFastAck;
+            }
+        }
+    }
+
+    void ParseData(Segment&& xNewSeg)
+    {
+        const uint32_t nSn = xNewSeg.nSn;
+
+        if (TimeDiff(nSn, mnRcvNxt + mnRcvWnd) >= 0 || TimeDiff(nSn, mnRcvNxt) < 0)
+        {
+            return;
+        }
+
+        //segments mostly come in order, search from the end
+        auto iter = mxRcvBuf.end();
+
+        while (iter != mxRcvBuf.begin())
+        {
+            auto prev = std::prev(iter);
+
+            if (prev->nSn == nSn)
+            {
+                return;
+            }
+
+            if (TimeDiff(nSn, prev->nSn) > 0)
+            {
+                break;
+            }
+
+            iter = prev;
+        }
+
+        mxRcvBuf.insert(iter, std::move(xNewSeg));
+        MoveRcvBuf();
+    }
+
+    void MoveRcvBuf()
+    {
+        while (!mxRcvBuf.empty() && mxRcvBuf.front().nSn == mnRcvNxt && mxRcvQueue.size() < mnRcvWnd)
+        {
+            mxRcvQueue.push_back(std::move(mxRcvBuf.front()));
+            mxRcvBuf.pop_front();
+            ++mnRcvNxt;
+        }
+    }
+
+    uint32_t WndUnused() const
+    {
+        return (mxRcvQueue.size() < mnRcvWnd ? mnRcvWnd - (uint32_t)mxRcvQueue.size() : 0);
+    }
+
+    void Output()
+    {
+        if (!mxOutBuffer.empty())
+        {
+            mxOutput(mxOutBuffer.data(), mxOutBuffer.size());
+            mxOutBuffer.clear();
+        }
+    }
+
+    //datagrams are filled up to mtu
+    void Reserve(const size_t nNeed)
+    {
+        if (mxOutBuffer.size() + nNeed > mnMtu)
+        {
+            Output();
+        }
+    }
+
+    void Flush()
+    {
+        if (!mbUpdated)
+        {
+            return;
+        }
+
+        Segment xSeg;
+        xSeg.nConv = mnConv;
+        xSeg.nCmd = ARK_KCP_CMD_ACK;
+        xSeg.nWnd = WndUnused();
+        xSeg.nUna = mnRcvNxt;
+
+        for (const auto& xAck : mxAckList)
+        {
+            Reserve(ARK_KCP_OVERHEAD);
+            xSeg.nSn = xAck.first;
+            xSeg.nTs = xAck.second;
+            EncodeSeg(mxOutBuffer, xSeg, 0);
+        }
+
+        mxAckList.clear();
+
+        //probe the window of the remote while it is 0
+        if (mnRmtWnd == 0)
+        {
+            if (mnProbeWait == 0)
+            {
+                mnProbeWait = ARK_KCP_PROBE_INIT;
+                mnTsProbe = mnCurrent + mnProbeWait;
+            }
+            else if (TimeDiff(mnCurrent, mnTsProbe) >= 0)
+            {
+                mnProbeWait = std::max<uint32_t>(mnProbeWait, ARK_KCP_PROBE_INIT);
+                mnProbeWait = std::min<uint32_t>(mnProbeWait + mnProbeWait / 2, ARK_KCP_PROBE_LIMIT);
+                mnTsProbe = mnCurrent + mnProbeWait;
+                mnProbe |= ARK_KCP_ASK_SEND;
+            }
+        }
+        else
+        {
+            mnTsProbe = 0;
+            mnProbeWait = 0;
+        }
+
+        xSeg.nSn = 0;
+        xSeg.nTs = 0;
+
+        if (mnProbe & ARK_KCP_ASK_SEND)
+        {
+            xSeg.nCmd = ARK_KCP_CMD_WASK;
+            Reserve(ARK_KCP_OVERHEAD);
+            EncodeSeg(mxOutBuffer, xSeg, 0);
+        }
+
+        if (mnProbe & ARK_KCP_ASK_TELL)
+        {
+            xSeg.nCmd = ARK_KCP_CMD_WINS;
+            Reserve(ARK_KCP_OVERHEAD);
+            EncodeSeg(mxOutBuffer, xSeg, 0);
+        }
+
+        mnProbe = 0;
+
+        //move the queued segments allowed by the windows to the send buffer
+        uint32_t nCwnd = std::min(mnSndWnd, mnRmtWnd);
+
+        if (!mbNoCwnd)
+        {
+            nCwnd = std::min(mnCwnd, nCwnd);
+        }
+
+        while (TimeDiff(mnSndNxt, mnSndUna + nCwnd) < 0 && !mxSndQueue.empty())
+        {
+            Segment& xNew = mxSndQueue.front();
+            xNew.nConv = mnConv;
+            xNew.nCmd = ARK_KCP_CMD_PUSH;
+            xNew.nTs = mnCurrent;
+            xNew.nSn = mnSndNxt++;
+            xNew.nUna = mnRcvNxt;
+            xNew.nResendTs = mnCurrent;
+            xNew.nRto = mnRxRto;
+            xNew.nFastAck = 0;
+            xNew.nXmit = 0;
+            mxSndBuf.push_back(std::move(xNew));
+            mxSndQueue.pop_front();
+        }
+
+        const uint32_t nResent = (mnFastResend > 0 ? mnFastResend : 0xFFFFFFFF);
+        const uint32_t nRtoMin = (mbNoDelay ? 0 : (mnRxRto >> 3));
+        bool bLost = false;
+        bool bChange = false;
+
+        for (auto& xSend : mxSndBuf)
+        {
+            bool bNeedSend = false;
+
+            if (xSend.nXmit == 0)
+            {
+                bNeedSend = true;
+                ++xSend.nXmit;
+                xSend.nRto = mnRxRto;
+                xSend.nResendTs = mnCurrent + xSend.nRto + nRtoMin;
+            }
+            else if (TimeDiff(mnCurrent, xSend.nResendTs) >= 0)
+            {
+                //timeout
+                bNeedSend = true;
+                ++xSend.nXmit;
+                ++mnXmit;
+                xSend.nRto += (mbNoDelay ? xSend.nRto / 2 : std::max<uint32_t>(xSend.nRto, mnRxRto));
+                xSend.nResendTs = mnCurrent + xSend.nRto;
+                bLost = true;
+            }
+            else if (xSend.nFastAck >= nResent && (xSend.nXmit <= mnFastLimit || mnFastLimit == 0))
+            {
+                //skipped by enough acks
+                bNeedSend = true;
+                ++xSend.nXmit;
+                xSend.nFastAck = 0;
+                xSend.nResendTs = mnCurrent + xSend.nRto;
+                bChange = true;
+            }
+
+            if (!bNeedSend)
+            {
+                continue;
+            }
+
+            xSend.nTs = mnCurrent;
+            xSend.nWnd = xSeg.nWnd;
+            xSend.nUna = mnRcvNxt;
+
+            Reserve(ARK_KCP_OVERHEAD + xSend.strData.size());
+            EncodeSeg(mxOutBuffer, xSend, (uint32_t)xSend.strData.size());
+            mxOutBuffer.append(xSend.strData);
+
+            if (xSend.nXmit >= mnDeadLink)
+            {
+                mnState = -1;
+            }
+        }
+
+        Output();
+
+        if (bChange)
+        {
+            const uint32_t nInflight = mnSndNxt - mnSndUna;
+            mnSsthresh = std::max<uint32_t>(nInflight / 2, ARK_KCP_THRESH_MIN);
+            mnCwnd = mnSsthresh + nResent;
+            mnIncr = mnCwnd * mnMss;
+        }
+
+        if (bLost)
+        {
+            mnSsthresh = std::max<uint32_t>(mnCwnd / 2, ARK_KCP_THRESH_MIN);
+            mnCwnd = 1;
+            mnIncr = mnMss;
+        }
+
+        if (mnCwnd < 1)
+        {
+            mnCwnd = 1;
+            mnIncr = mnMss;
+        }
+    }
+
+    uint32_t mnConv;
+    uint32_t mnMtu;
+    uint32_t mnMss;
+    int mnState;
+
+    uint32_t mnSndUna;
+    uint32_t mnSndNxt;
+    uint32_t mnRcvNxt;
+
+    uint32_t mnSsthresh;
+    int32_t mnRxRttVal;
+    int32_t mnRxSrtt;
+    int32_t mnRxRto;
+    int32_t mnRxMinRto;
+
+    uint32_t mnSndWnd;
+    uint32_t mnRcvWnd;
+    uint32_t mnRmtWnd;
+    uint32_t mnCwnd;
+    uint32_t mnProbe;
+
+    uint32_t mnCurrent;
+    uint32_t mnInterval;
+    uint32_t mnTsFlush;
+    uint32_t mnXmit;
+
+    bool mbNoDelay;
+    bool mbUpdated;
+    uint32_t mnTsProbe;
+    uint32_t mnProbeWait;
+    uint32_t mnDeadLink;
+    uint32_t mnIncr;
+
+    uint32_t mnFastResend;
+    uint32_t mnFastLimit;
+    bool mbNoCwnd;
+
+    std::deque<Segment> mxSndQueue;
+    std::deque<Segment> mxRcvQueue;
+    std::deque<Segment> mxSndBuf;
+    std::deque<Segment> mxRcvBuf;
+    std::vector<std::pair<uint32_t, uint32_t>> mxAckList; //sn, ts
+
+    std::string mxOutBuffer;
+    OUTPUT_FUNCTOR mxOutput;
+};
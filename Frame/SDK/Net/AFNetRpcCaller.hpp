@@ -0,0 +1,160 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "SDK/Core/AFPlatform.hpp"
+
+enum AFNetRpcStatus
+{
+    ARK_RPC_OK = 0,
+    ARK_RPC_TIMEOUT = 1,        //no response before the deadline
+    ARK_RPC_DISCONNECTED = 2,   //the link to the server was lost with the call in flight
+    ARK_RPC_NO_METHOD = 3,      //the server has no handler of the method
+    ARK_RPC_BAD_MESSAGE = 4,    //the request or the response can not be parsed
+    ARK_RPC_FAILED = 5,         //the handler answered with an error
+};
+
+//the response body and its length, nullptr unless nStatus is ARK_RPC_OK
+using NET_RPC_CALLBACK = std::function<void(const int nStatus, const char* msg, const uint32_t nLen)>;
+
+//Calls in flight of one client module, any number per server, answered in any order.
+//Everything runs in logic thread, a callback may start new calls.
+class AFNetRpcCaller
+{
+public:
+    //the id of the new call
+    uint64_t Add(const int nServerID, const int64_t nDeadline, const NET_RPC_CALLBACK& xCallBack)
+    {
+        const uint64_t nCallID = ++mnNextCallID;
+
+        RpcCall& xCall = mxCalls[nCallID];
+        xCall.nServerID = nServerID;
+        xCall.xCallBack = xCallBack;
+        xCall.xTimer = mxTimers.emplace(nDeadline, nCallID);
+        return nCallID;
+    }
+
+    //the call is dropped without callback, e.g. its request could not be sent
+    void Remove(const uint64_t nCallID)
+    {
+        auto iter = mxCalls.find(nCallID);
+
+        if (iter != mxCalls.end())
+        {
+            mxTimers.erase(iter->second.xTimer);
+            mxCalls.erase(iter);
+        }
+    }
+
+    //a response after the deadline finds no call and is dropped, so is one from another server than the call went to
+    void OnResponse(const int nServerID, const uint64_t nCallID, const int nStatus, const char* msg, const uint32_t nLen)
+    {
+        auto iter = mxCalls.find(nCallID);
+
+        if (iter == mxCalls.end() || iter->second.nServerID != nServerID)
+        {
+            return;
+        }
+
+        if (nStatus == ARK_RPC_OK)
+        {
+            Complete(nCallID, ARK_RPC_OK, msg, nLen);
+        }
+        else
+        {
+            Complete(nCallID, nStatus, nullptr, 0);
+        }
+    }
+
+    void Update(const int64_t nNow)
+    {
+        while (!mxTimers.empty() && mxTimers.begin()->first <= nNow)
+        {
+            Complete(mxTimers.begin()->second, ARK_RPC_TIMEOUT, nullptr, 0);
+        }
+    }
+
+    //the calls to the server fail at once, their responses can not come any more
+    void OnDisconnect(const int nServerID)
+    {
+        std::vector<uint64_t> xCallIDList;
+
+        for (const auto& iter : mxCalls)
+        {
+            if (iter.second.nServerID == nServerID)
+            {
+                xCallIDList.push_back(iter.first);
+            }
+        }
+
+        //in call id order, the order the requests were sent
+        std::sort(xCallIDList.begin(), xCallIDList.end());
+
+        for (const uint64_t nCallID : xCallIDList)
+        {
+            Complete(nCallID, ARK_RPC_DISCONNECTED, nullptr, 0);
+        }
+    }
+
+    size_t GetCount() const
+    {
+        return mxCalls.size();
+    }
+
+    //deadlines are in ms of the steady clock, the frame time of the plugin manager is in seconds
+    static int64_t GetTime()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    struct RpcCall
+    {
+        int nServerID{ 0 };
+        std::multimap<int64_t, uint64_t>::iterator xTimer;
+        NET_RPC_CALLBACK xCallBack;
+    };
+
+    void Complete(const uint64_t nCallID, const int nStatus, const char* msg, const uint32_t nLen)
+    {
+        auto iter = mxCalls.find(nCallID);
+
+        if (iter == mxCalls.end())
+        {
+            return;
+        }
+
+        //removed before the callback runs, so the callback can start calls
+        NET_RPC_CALLBACK xCallBack = std::move(iter->second.xCallBack);
+        mxTimers.erase(iter->second.xTimer);
+        mxCalls.erase(iter);
+
+        if (xCallBack)
+        {
+            xCallBack(nStatus, msg, nLen);
+        }
+    }
+
+    std::unordered_map<uint64_t, RpcCall> mxCalls;
+    //deadline -> call id
+    std::multimap<int64_t, uint64_t> mxTimers;
+    uint64_t mnNextCallID{ 0 };
+};
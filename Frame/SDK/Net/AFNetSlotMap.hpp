@@ -0,0 +1,244 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "SDK/Core/AFPlatform.hpp"
+#include "SDK/Core/AFNoncopyable.hpp"
+#include "SDK/Core/AFSpinLock.hpp"
+
+//Dense slot array of the connections.
+//A handle is [ generation(32) | index(32) ], the generation of a slot changes when its object is removed,
+//so the handles of closed connections never find the object which reuses the slot.
+//Add and Remove may be called from any thread, Get and ForEach do not lock.
+//The owner must not delete a removed object while another thread may still Get it.
+template<typename T>
+class AFNetSlotMap : public AFNoncopyable
+{
+public:
+    enum
+    {
+        ARK_SLOT_PAGE_BITS = 10,
+        ARK_SLOT_PAGE_SIZE = 1 << ARK_SLOT_PAGE_BITS,
+        ARK_SLOT_MAX_PAGE = 4096, //4M slots
+    };
+
+    static const uint32_t INVALID_INDEX = uint32_t(-1);
+
+    AFNetSlotMap() : mnSize(0), mnFreeHead(INVALID_INDEX), mnCount(0)
+    {
+        for (auto& xPage : mxPages)
+        {
+            xPage.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~AFNetSlotMap()
+    {
+        for (auto& xPage : mxPages)
+        {
+            delete[] xPage.load(std::memory_order_relaxed);
+        }
+    }
+
+    //return the handle of pData, 0 when all slots are used
+    uint64_t Add(T* pData)
+    {
+        return Add(pData, [](const uint64_t nHandle) {});
+    }
+
+    //xInit(nHandle) runs before pData can be found by Get and ForEach, e.g. to give the object its handle
+    template<typename FUNC>
+    uint64_t Add(T* pData, FUNC&& xInit)
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxLock);
+
+        uint32_t nIndex = mnFreeHead;
+
+        if (nIndex != INVALID_INDEX)
+        {
+            mnFreeHead = GetSlot(nIndex).nNextFree;
+        }
+        else
+        {
+            nIndex = mnSize.load(std::memory_order_relaxed);
+
+            if (nIndex >= ARK_SLOT_MAX_PAGE * ARK_SLOT_PAGE_SIZE)
+            {
+                return 0;
+            }
+
+            if ((nIndex & (ARK_SLOT_PAGE_SIZE - 1)) == 0)
+            {
+                mxPages[nIndex >> ARK_SLOT_PAGE_BITS].store(new Slot[ARK_SLOT_PAGE_SIZE], std::memory_order_release);
+            }
+        }
+
+        Slot& xSlot = GetSlot(nIndex);
+        const uint64_t nHandle = MakeHandle(nIndex, xSlot.nGeneration.load(std::memory_order_relaxed));
+        xInit(nHandle);
+        xSlot.pData.store(pData, std::memory_order_release);
+
+        if (nIndex == mnSize.load(std::memory_order_relaxed))
+        {
+            mnSize.store(nIndex + 1, std::memory_order_release);
+        }
+
+        ++mnCount;
+        return nHandle;
+    }
+
+    //nullptr for the handles never added or already removed
+    T* Get(const uint64_t nHandle) const
+    {
+        const uint32_t nIndex = GetIndex(nHandle);
+
+        if (nIndex >= mnSize.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        const Slot& xSlot = GetSlot(nIndex);
+
+        //the object first, then its generation: a Remove and Add between the two loads changed the generation before
+        //the new object was stored, so the stale handle does not get the new object
+        T* pData = xSlot.pData.load(std::memory_order_acquire);
+
+        if (xSlot.nGeneration.load(std::memory_order_acquire) != GetGeneration(nHandle))
+        {
+            return nullptr;
+        }
+
+        return pData;
+    }
+
+    //return the removed object, the slot is free for the next Add with a new generation
+    T* Remove(const uint64_t nHandle)
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxLock);
+
+        const uint32_t nIndex = GetIndex(nHandle);
+
+        if (nIndex >= mnSize.load(std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+
+        Slot& xSlot = GetSlot(nIndex);
+        uint32_t nGeneration = xSlot.nGeneration.load(std::memory_order_relaxed);
+
+        if (nGeneration != GetGeneration(nHandle))
+        {
+            return nullptr;
+        }
+
+        //0 is never used, so no handle is 0
+        nGeneration = (nGeneration + 1 == 0 ? 1 : nGeneration + 1);
+        xSlot.nGeneration.store(nGeneration, std::memory_order_release);
+        T* pData = xSlot.pData.exchange(nullptr, std::memory_order_acq_rel);
+
+        xSlot.nNextFree = mnFreeHead;
+        mnFreeHead = nIndex;
+        --mnCount;
+
+        return pData;
+    }
+
+    //visit the objects in slot order
+    template<typename FUNC>
+    void ForEach(FUNC&& func) const
+    {
+        const uint32_t nSize = mnSize.load(std::memory_order_acquire);
+
+        for (uint32_t i = 0; i < nSize; ++i)
+        {
+            T* pData = GetSlot(i).pData.load(std::memory_order_acquire);
+
+            if (pData != nullptr)
+            {
+                func(pData);
+            }
+        }
+    }
+
+    //remove all the objects, the owner deletes them before
+    void Clear()
+    {
+        const uint32_t nSize = mnSize.load(std::memory_order_acquire);
+
+        for (uint32_t i = 0; i < nSize; ++i)
+        {
+            const Slot& xSlot = GetSlot(i);
+
+            if (xSlot.pData.load(std::memory_order_acquire) != nullptr)
+            {
+                Remove(MakeHandle(i, xSlot.nGeneration.load(std::memory_order_acquire)));
+            }
+        }
+    }
+
+    size_t Count() const
+    {
+        return mnCount;
+    }
+
+    static uint64_t MakeHandle(const uint32_t nIndex, const uint32_t nGeneration)
+    {
+        return (uint64_t(nGeneration) << 32) | nIndex;
+    }
+
+    static uint32_t GetIndex(const uint64_t nHandle)
+    {
+        return uint32_t(nHandle & 0xFFFFFFFF);
+    }
+
+    static uint32_t GetGeneration(const uint64_t nHandle)
+    {
+        return uint32_t(nHandle >> 32);
+    }
+
+private:
+    struct Slot
+    {
+        Slot() : nGeneration(1), pData(nullptr), nNextFree(INVALID_INDEX) {}
+
+        std::atomic<uint32_t> nGeneration;
+        std::atomic<T*> pData;
+        uint32_t nNextFree; //guarded by mxLock
+    };
+
+    Slot& GetSlot(const uint32_t nIndex)
+    {
+        return mxPages[nIndex >> ARK_SLOT_PAGE_BITS].load(std::memory_order_acquire)[nIndex & (ARK_SLOT_PAGE_SIZE - 1)];
+    }
+
+    const Slot& GetSlot(const uint32_t nIndex) const
+    {
+        return mxPages[nIndex >> ARK_SLOT_PAGE_BITS].load(std::memory_order_acquire)[nIndex & (ARK_SLOT_PAGE_SIZE - 1)];
+    }
+
+    //pages never move, so a slot found without lock stays valid
+    std::atomic<Slot*> mxPages[ARK_SLOT_MAX_PAGE];
+    std::atomic<uint32_t> mnSize;
+
+    AFSpinLock mxLock;
+    uint32_t mnFreeHead;
+    std::atomic<size_t> mnCount;
+};
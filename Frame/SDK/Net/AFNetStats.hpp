@@ -0,0 +1,345 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "SDK/Core/AFPlatform.hpp"
+#include "SDK/Core/AFGUID.h"
+#include "SDK/Core/AFSpinLock.hpp"
+
+//totals of one message id
+struct AFNetMsgStat
+{
+    uint64_t nRecvCount{ 0 };
+    uint64_t nRecvBytes{ 0 };
+    uint64_t nSendCount{ 0 };
+    uint64_t nSendBytes{ 0 };
+    uint64_t nHandleTime{ 0 }; //ns, spent in receive callbacks
+    uint64_t nCompressCount{ 0 };
+    uint64_t nCompressRawBytes{ 0 };  //bodies before compression
+    uint64_t nCompressBytes{ 0 };     //bodies sent, the raw size when compression did not help
+    uint64_t nCompressTime{ 0 };      //ns
+    uint64_t nDecompressCount{ 0 };
+    uint64_t nDecompressTime{ 0 };    //ns
+    uint64_t nHeadSavedBytes{ 0 };    //by compact heads, sent and received
+};
+
+//gauges of one connection
+struct AFNetSessionStat
+{
+    AFGUID xClientID{ 0 };
+    size_t nRecvQueue{ 0 };   //received blocks waiting for logic thread
+    size_t nSendBacklog{ 0 }; //bytes not handed to the socket yet
+};
+
+struct AFNetStatsSnapshot
+{
+    int64_t nTime{ 0 }; //ms of the merge
+    std::map<uint16_t, AFNetMsgStat> xMsgStats;
+    std::vector<AFNetSessionStat> xSessions;
+};
+
+//Per message id counters of the whole process.
+//Every thread counts into its own block without lock, the blocks are summed once per second by Merge,
+//readers only see the merged snapshot.
+class AFNetStats
+{
+public:
+    enum
+    {
+        ARK_STATS_PAGE_BITS = 8,
+        ARK_STATS_PAGE_SIZE = 1 << ARK_STATS_PAGE_BITS,
+        ARK_STATS_PAGE_COUNT = 65536 / ARK_STATS_PAGE_SIZE,
+        ARK_STATS_INTERVAL = 1000, //ms
+    };
+
+    static AFNetStats& GetInstance()
+    {
+        static AFNetStats xStats;
+        return xStats;
+    }
+
+    static void RecordRecv(const uint16_t nMsgID, const size_t nBytes, const uint64_t nHandleTime)
+    {
+        Counter& xCounter = GetThreadCounters().GetCounter(nMsgID);
+        Add(xCounter.nRecvCount, 1);
+        Add(xCounter.nRecvBytes, nBytes);
+        Add(xCounter.nHandleTime, nHandleTime);
+    }
+
+    static void RecordSend(const uint16_t nMsgID, const size_t nBytes, const size_t nCount = 1)
+    {
+        Counter& xCounter = GetThreadCounters().GetCounter(nMsgID);
+        Add(xCounter.nSendCount, nCount);
+        Add(xCounter.nSendBytes, nBytes * nCount);
+    }
+
+    static void RecordCompress(const uint16_t nMsgID, const size_t nRawBytes, const size_t nBytes, const uint64_t nTime)
+    {
+        Counter& xCounter = GetThreadCounters().GetCounter(nMsgID);
+        Add(xCounter.nCompressCount, 1);
+        Add(xCounter.nCompressRawBytes, nRawBytes);
+        Add(xCounter.nCompressBytes, nBytes);
+        Add(xCounter.nCompressTime, nTime);
+    }
+
+    static void RecordDecompress(const uint16_t nMsgID, const uint64_t nTime)
+    {
+        Counter& xCounter = GetThreadCounters().GetCounter(nMsgID);
+        Add(xCounter.nDecompressCount, 1);
+        Add(xCounter.nDecompressTime, nTime);
+    }
+
+    static void RecordHeadSaved(const uint16_t nMsgID, const size_t nBytes)
+    {
+        Add(GetThreadCounters().GetCounter(nMsgID).nHeadSavedBytes, nBytes);
+    }
+
+    //sum the counters of all threads, return false when the last merge is not ARK_STATS_INTERVAL ago
+    bool Merge(const int64_t nNow)
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxLock);
+
+        if (nNow - mxSnapshot.nTime < ARK_STATS_INTERVAL)
+        {
+            return false;
+        }
+
+        mxSnapshot.nTime = nNow;
+        mxSnapshot.xMsgStats.clear();
+
+        for (auto pThread : mxThreads)
+        {
+            for (int nPage = 0; nPage < ARK_STATS_PAGE_COUNT; ++nPage)
+            {
+                const Counter* pCounters = pThread->mxPages[nPage].load(std::memory_order_acquire);
+
+                if (pCounters == nullptr)
+                {
+                    continue;
+                }
+
+                for (int i = 0; i < ARK_STATS_PAGE_SIZE; ++i)
+                {
+                    const Counter& xCounter = pCounters[i];
+
+                    if (xCounter.nRecvCount.load(std::memory_order_relaxed) == 0 && xCounter.nSendCount.load(std::memory_order_relaxed) == 0
+                            && xCounter.nCompressCount.load(std::memory_order_relaxed) == 0 && xCounter.nDecompressCount.load(std::memory_order_relaxed) == 0
+                            && xCounter.nHeadSavedBytes.load(std::memory_order_relaxed) == 0)
+                    {
+                        continue;
+                    }
+
+                    AFNetMsgStat& xStat = mxSnapshot.xMsgStats[uint16_t((nPage << ARK_STATS_PAGE_BITS) + i)];
+                    xStat.nRecvCount += xCounter.nRecvCount.load(std::memory_order_relaxed);
+                    xStat.nRecvBytes += xCounter.nRecvBytes.load(std::memory_order_relaxed);
+                    xStat.nSendCount += xCounter.nSendCount.load(std::memory_order_relaxed);
+                    xStat.nSendBytes += xCounter.nSendBytes.load(std::memory_order_relaxed);
+                    xStat.nHandleTime += xCounter.nHandleTime.load(std::memory_order_relaxed);
+                    xStat.nCompressCount += xCounter.nCompressCount.load(std::memory_order_relaxed);
+                    xStat.nCompressRawBytes += xCounter.nCompressRawBytes.load(std::memory_order_relaxed);
+                    xStat.nCompressBytes += xCounter.nCompressBytes.load(std::memory_order_relaxed);
+                    xStat.nCompressTime += xCounter.nCompressTime.load(std::memory_order_relaxed);
+                    xStat.nDecompressCount += xCounter.nDecompressCount.load(std::memory_order_relaxed);
+                    xStat.nDecompressTime += xCounter.nDecompressTime.load(std::memory_order_relaxed);
+                    xStat.nHeadSavedBytes += xCounter.nHeadSavedBytes.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        mxSnapshot.xSessions.clear();
+
+        for (const auto& it : mxSessionStats)
+        {
+            mxSnapshot.xSessions.insert(mxSnapshot.xSessions.end(), it.second.begin(), it.second.end());
+        }
+
+        return true;
+    }
+
+    //gauges of the sessions of one net, replaced every time
+    void SetSessionStats(const void* pOwner, std::vector<AFNetSessionStat>& xList)
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxLock);
+        mxSessionStats[pOwner].swap(xList);
+    }
+
+    void RemoveSessionStats(const void* pOwner)
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxLock);
+        mxSessionStats.erase(pOwner);
+    }
+
+    void GetSnapshot(AFNetStatsSnapshot& xSnapshot)
+    {
+        std::lock_guard<AFSpinLock> xGuard(mxLock);
+        xSnapshot = mxSnapshot;
+    }
+
+    //Prometheus text format of the last snapshot
+    std::string ToPrometheus()
+    {
+        AFNetStatsSnapshot xSnapshot;
+        GetSnapshot(xSnapshot);
+
+        std::ostringstream xStream;
+
+        WriteMsgMetric(xStream, xSnapshot, "ark_net_msg_recv_total", "Received messages by msg id", &AFNetMsgStat::nRecvCount);
+        WriteMsgMetric(xStream, xSnapshot, "ark_net_msg_recv_bytes_total", "Received bytes with head by msg id", &AFNetMsgStat::nRecvBytes);
+        WriteMsgMetric(xStream, xSnapshot, "ark_net_msg_send_total", "Sent messages by msg id, one per target", &AFNetMsgStat::nSendCount);
+        WriteMsgMetric(xStream, xSnapshot, "ark_net_msg_send_bytes_total", "Sent bytes with head by msg id", &AFNetMsgStat::nSendBytes);
+
+        WriteMsgSeconds(xStream, xSnapshot, "ark_net_msg_handle_seconds_total", "Time spent in receive callbacks by msg id", &AFNetMsgStat::nHandleTime);
+
+        //ratio is compress_bytes / compress_raw_bytes, cost is compress_seconds and decompress_seconds
+        WriteMsgMetric(xStream, xSnapshot, "ark_net_msg_compress_total", "Compressed frames by msg id", &AFNetMsgStat::nCompressCount);
+        WriteMsgMetric(xStream, xSnapshot, "ark_net_msg_compress_raw_bytes_total", "Bodies before compression by msg id", &AFNetMsgStat::nCompressRawBytes);
+        WriteMsgMetric(xStream, xSnapshot, "ark_net_msg_compress_bytes_total", "Bodies after compression by msg id", &AFNetMsgStat::nCompressBytes);
+        WriteMsgSeconds(xStream, xSnapshot, "ark_net_msg_compress_seconds_total", "Time spent in compression by msg id", &AFNetMsgStat::nCompressTime);
+        WriteMsgMetric(xStream, xSnapshot, "ark_net_msg_decompress_total", "Decompressed frames by msg id", &AFNetMsgStat::nDecompressCount);
+        WriteMsgSeconds(xStream, xSnapshot, "ark_net_msg_decompress_seconds_total", "Time spent in decompression by msg id", &AFNetMsgStat::nDecompressTime);
+        WriteMsgMetric(xStream, xSnapshot, "ark_net_msg_head_saved_bytes_total", "Bytes saved by compact heads by msg id", &AFNetMsgStat::nHeadSavedBytes);
+
+        size_t nRecvQueue = 0;
+        size_t nRecvQueueMax = 0;
+        size_t nSendBacklog = 0;
+        size_t nSendBacklogMax = 0;
+
+        for (const auto& xSession : xSnapshot.xSessions)
+        {
+            nRecvQueue += xSession.nRecvQueue;
+            nRecvQueueMax = std::max(nRecvQueueMax, xSession.nRecvQueue);
+            nSendBacklog += xSession.nSendBacklog;
+            nSendBacklogMax = std::max(nSendBacklogMax, xSession.nSendBacklog);
+        }
+
+        WriteGauge(xStream, "ark_net_sessions", "Connections", xSnapshot.xSessions.size());
+        WriteGauge(xStream, "ark_net_recv_queue", "Received blocks waiting for logic thread, all sessions", nRecvQueue);
+        WriteGauge(xStream, "ark_net_recv_queue_max", "Received blocks waiting for logic thread, worst session", nRecvQueueMax);
+        WriteGauge(xStream, "ark_net_send_backlog_bytes", "Bytes not handed to the socket yet, all sessions", nSendBacklog);
+        WriteGauge(xStream, "ark_net_send_backlog_bytes_max", "Bytes not handed to the socket yet, worst session", nSendBacklogMax);
+
+        return xStream.str();
+    }
+
+private:
+    struct Counter
+    {
+        std::atomic<uint64_t> nRecvCount{ 0 };
+        std::atomic<uint64_t> nRecvBytes{ 0 };
+        std::atomic<uint64_t> nSendCount{ 0 };
+        std::atomic<uint64_t> nSendBytes{ 0 };
+        std::atomic<uint64_t> nHandleTime{ 0 };
+        std::atomic<uint64_t> nCompressCount{ 0 };
+        std::atomic<uint64_t> nCompressRawBytes{ 0 };
+        std::atomic<uint64_t> nCompressBytes{ 0 };
+        std::atomic<uint64_t> nCompressTime{ 0 };
+        std::atomic<uint64_t> nDecompressCount{ 0 };
+        std::atomic<uint64_t> nDecompressTime{ 0 };
+        std::atomic<uint64_t> nHeadSavedBytes{ 0 };
+    };
+
+    //written by its thread only, pages are allocated on first use of an id in the page
+    struct ThreadCounters
+    {
+        ThreadCounters()
+        {
+            for (auto& xPage : mxPages)
+            {
+                xPage.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        Counter& GetCounter(const uint16_t nMsgID)
+        {
+            std::atomic<Counter*>& xPage = mxPages[nMsgID >> ARK_STATS_PAGE_BITS];
+            Counter* pCounters = xPage.load(std::memory_order_relaxed);
+
+            if (pCounters == nullptr)
+            {
+                pCounters = new Counter[ARK_STATS_PAGE_SIZE];
+                xPage.store(pCounters, std::memory_order_release);
+            }
+
+            return pCounters[nMsgID & (ARK_STATS_PAGE_SIZE - 1)];
+        }
+
+        std::atomic<Counter*> mxPages[ARK_STATS_PAGE_COUNT];
+    };
+
+    AFNetStats() = default;
+
+    //only the owner thread writes, so no locked add is needed
+    static void Add(std::atomic<uint64_t>& xValue, const uint64_t nValue)
+    {
+        xValue.store(xValue.load(std::memory_order_relaxed) + nValue, std::memory_order_relaxed);
+    }
+
+    //blocks are kept after their thread exits, the counts stay in the totals
+    static ThreadCounters& GetThreadCounters()
+    {
+        static thread_local ThreadCounters* pCounters = nullptr;
+
+        if (pCounters == nullptr)
+        {
+            pCounters = new ThreadCounters();
+
+            AFNetStats& xStats = GetInstance();
+            std::lock_guard<AFSpinLock> xGuard(xStats.mxLock);
+            xStats.mxThreads.push_back(pCounters);
+        }
+
+        return *pCounters;
+    }
+
+    static void WriteMsgMetric(std::ostringstream& xStream, const AFNetStatsSnapshot& xSnapshot, const char* pName, const char* pHelp, uint64_t AFNetMsgStat::*pField)
+    {
+        xStream << "# HELP " << pName << " " << pHelp << "\n";
+        xStream << "# TYPE " << pName << " counter\n";
+
+        for (const auto& it : xSnapshot.xMsgStats)
+        {
+            xStream << pName << "{msg_id=\"" << it.first << "\"} " << it.second.*pField << "\n";
+        }
+    }
+
+    static void WriteMsgSeconds(std::ostringstream& xStream, const AFNetStatsSnapshot& xSnapshot, const char* pName, const char* pHelp, uint64_t AFNetMsgStat::*pField)
+    {
+        xStream << "# HELP " << pName << " " << pHelp << "\n";
+        xStream << "# TYPE " << pName << " counter\n";
+
+        for (const auto& it : xSnapshot.xMsgStats)
+        {
+            xStream << pName << "{msg_id=\"" << it.first << "\"} " << (double)(it.second.*pField) / 1000000000.0 << "\n";
+        }
+    }
+
+    static void WriteGauge(std::ostringstream& xStream, const char* pName, const char* pHelp, const size_t nValue)
+    {
+        xStream << "# HELP " << pName << " " << pHelp << "\n";
+        xStream << "# TYPE " << pName << " gauge\n";
+        xStream << pName << " " << nValue << "\n";
+    }
+
+    AFSpinLock mxLock;
+    std::vector<ThreadCounters*> mxThreads;
+    std::map<const void*, std::vector<AFNetSessionStat>> mxSessionStats;
+    AFNetStatsSnapshot mxSnapshot;
+};
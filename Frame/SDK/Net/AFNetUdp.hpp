@@ -0,0 +1,538 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "AFINet.h"
+#include "AFNetKcp.hpp"
+
+#if ARK_PLATFORM == PLATFORM_WIN
+#include <WS2tcpip.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <netinet/in.h>
+#endif
+
+//Non blocking ipv4 udp socket of the kcp links.
+//With a fault config the datagrams sent are dropped or held back, the held ones go out in PumpFault
+class AFNetUdpSocket : public AFNoncopyable
+{
+public:
+#if ARK_PLATFORM == PLATFORM_WIN
+    using SOCKET_FD = SOCKET;
+#else
+    using SOCKET_FD = int;
+#endif
+
+    enum
+    {
+        ARK_UDP_SOCKET_BUFFER = 4 * 1024 * 1024,
+        ARK_UDP_MAX_DATAGRAM = 64 * 1024,
+    };
+
+    AFNetUdpSocket() : mnFD((SOCKET_FD)(-1)), mbFault(false), mxRandom(std::random_device {}()) {}
+
+    ~AFNetUdpSocket()
+    {
+        Close();
+    }
+
+    static bool MakeAddr(const std::string& strHost, const int nPort, sockaddr_in& xAddr)
+    {
+        memset(&xAddr, 0, sizeof(xAddr));
+        xAddr.sin_family = AF_INET;
+        xAddr.sin_port = htons((uint16_t)nPort);
+        xAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+        return (strHost.empty() || inet_pton(AF_INET, strHost.c_str(), &xAddr.sin_addr) == 1);
+    }
+
+    //ip and port in one key
+    static uint64_t GetAddrKey(const sockaddr_in& xAddr)
+    {
+        return ((uint64_t)ntohl(xAddr.sin_addr.s_addr) << 16) | ntohs(xAddr.sin_port);
+    }
+
+    //bind to strHost:nPort, empty strHost for all address and nPort 0 for any port
+    bool Open(const std::string& strHost, const int nPort)
+    {
+        sockaddr_in xAddr;
+
+        if (IsOpen() || !MakeAddr(strHost, nPort, xAddr))
+        {
+            return false;
+        }
+
+        mnFD = socket(AF_INET, SOCK_DGRAM, 0);
+
+        if (!IsOpen())
+        {
+            return false;
+        }
+
+        int nBufferSize = ARK_UDP_SOCKET_BUFFER;
+        setsockopt(mnFD, SOL_SOCKET, SO_RCVBUF, (const char*)&nBufferSize, sizeof(nBufferSize));
+        setsockopt(mnFD, SOL_SOCKET, SO_SNDBUF, (const char*)&nBufferSize, sizeof(nBufferSize));
+
+#if ARK_PLATFORM == PLATFORM_WIN
+        u_long nNonBlock = 1;
+        const bool bNonBlock = (ioctlsocket(mnFD, FIONBIO, &nNonBlock) == 0);
+#else
+        const bool bNonBlock = (fcntl(mnFD, F_SETFL, fcntl(mnFD, F_GETFL, 0) | O_NONBLOCK) == 0);
+#endif
+
+        if (!bNonBlock || bind(mnFD, (sockaddr*)&xAddr, sizeof(xAddr)) != 0)
+        {
+            Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void Close()
+    {
+        if (!IsOpen())
+        {
+            return;
+        }
+
+        Flush();
+
+#if ARK_PLATFORM == PLATFORM_WIN
+        closesocket(mnFD);
+#else
+        close(mnFD);
+#endif
+        mnFD = (SOCKET_FD)(-1);
+    }
+
+    bool IsOpen() const
+    {
+        return mnFD != (SOCKET_FD)(-1);
+    }
+
+    void SetFault(const AFNetFaultConfig& xConfig)
+    {
+        std::lock_guard<std::mutex> xGuard(mxFaultLock);
+        mxFault = xConfig;
+        mbFault = (xConfig.dLoss > 0.0 || xConfig.nDelay > 0 || xConfig.nJitter > 0);
+    }
+
+    //any thread
+    bool SendTo(const char* pData, const size_t nLen, const sockaddr_in& xAddr)
+    {
+        if (mbFault)
+        {
+            std::lock_guard<std::mutex> xGuard(mxFaultLock);
+
+            if (std::uniform_real_distribution<double>(0.0, 1.0)(mxRandom) < mxFault.dLoss)
+            {
+                return true;
+            }
+
+            uint32_t nDelay = mxFault.nDelay;
+
+            if (mxFault.nJitter > 0)
+            {
+                nDelay += std::uniform_int_distribution<uint32_t>(0, mxFault.nJitter)(mxRandom);
+            }
+
+            if (nDelay > 0)
+            {
+                mxDelayed.emplace(AFNetKcp::GetClock() + nDelay, std::make_pair(xAddr, std::string(pData, nLen)));
+                return true;
+            }
+        }
+
+        return sendto(mnFD, pData, (int)nLen, 0, (const sockaddr*)&xAddr, sizeof(xAddr)) == (int)nLen;
+    }
+
+    //io thread, the length of the datagram, < 0 when there is none
+    int RecvFrom(char* pBuffer, const size_t nLen, sockaddr_in& xAddr)
+    {
+        socklen_t nAddrLen = sizeof(xAddr);
+        return (int)recvfrom(mnFD, pBuffer, (int)nLen, 0, (sockaddr*)&xAddr, &nAddrLen);
+    }
+
+    //io thread, wait at most nTimeout ms for a datagram
+    void Wait(const int nTimeout)
+    {
+#if ARK_PLATFORM == PLATFORM_WIN
+        WSAPOLLFD xPoll;
+        xPoll.fd = mnFD;
+        xPoll.events = POLLRDNORM;
+        xPoll.revents = 0;
+        WSAPoll(&xPoll, 1, nTimeout);
+#else
+        pollfd xPoll;
+        xPoll.fd = mnFD;
+        xPoll.events = POLLIN;
+        xPoll.revents = 0;
+        poll(&xPoll, 1, nTimeout);
+#endif
+    }
+
+    //io thread, send the held datagrams which are due, return the ms to the next one, -1 if none is held
+    int PumpFault(const uint32_t nNow)
+    {
+        if (!mbFault)
+        {
+            return -1;
+        }
+
+        std::lock_guard<std::mutex> xGuard(mxFaultLock);
+
+        while (!mxDelayed.empty())
+        {
+            auto iter = mxDelayed.begin();
+            const int32_t nWait = (int32_t)(iter->first - nNow);
+
+            if (nWait > 0)
+            {
+                return nWait;
+            }
+
+            sendto(mnFD, iter->second.second.data(), (int)iter->second.second.size(), 0, (const sockaddr*)&iter->second.first, sizeof(sockaddr_in));
+            mxDelayed.erase(iter);
+        }
+
+        return -1;
+    }
+
+    //send the held datagrams at once, so the FIN of a closing link is not lost with the socket
+    void Flush()
+    {
+        std::lock_guard<std::mutex> xGuard(mxFaultLock);
+
+        for (auto& iter : mxDelayed)
+        {
+            sendto(mnFD, iter.second.second.data(), (int)iter.second.second.size(), 0, (const sockaddr*)&iter.second.first, sizeof(sockaddr_in));
+        }
+
+        mxDelayed.clear();
+    }
+
+private:
+    SOCKET_FD mnFD;
+
+    std::atomic<bool> mbFault;
+    std::mutex mxFaultLock;
+    AFNetFaultConfig mxFault;
+    std::mt19937 mxRandom;
+    std::multimap<uint32_t, std::pair<sockaddr_in, std::string>> mxDelayed;
+};
+
+//Datagrams of conv 0 set up and keep the links: [conv 0(4)][cmd(1)][token(4)][conv(4)] in little endian.
+//SYN: client to server, the token is a random of the client, resent until SYN_ACK comes. The conv field is 0 first,
+//then the cookie the server answered with
+//COOKIE: server to client, a SYN without a valid cookie gets one in the conv field and leaves no state in the server,
+//so a flood of SYN from forged addresses allocates no link. The cookie binds the address and the token for a while
+//SYN_ACK: server to client, the conv of the new link
+//PING: the link is idle, FIN: the link is closed
+class AFNetKcpControl
+{
+public:
+    enum
+    {
+        ARK_KCP_CTRL_SYN = 1,
+        ARK_KCP_CTRL_SYN_ACK = 2,
+        ARK_KCP_CTRL_PING = 3,
+        ARK_KCP_CTRL_FIN = 4,
+        ARK_KCP_CTRL_COOKIE = 5,
+        ARK_KCP_CTRL_LENGTH = 13,
+        ARK_KCP_COOKIE_PERIOD = 10000, //ms, a cookie is valid in its period and the next one
+        ARK_KCP_SYN_INTERVAL = 200, //ms
+        ARK_KCP_PING_INTERVAL = 1000, //ms
+        ARK_KCP_MAX_WAIT = 10, //ms of the io thread waiting for datagrams
+        ARK_KCP_MAX_DRAIN = 4096, //datagrams read by the io thread before it drives the timers again
+    };
+
+    static void Make(char* pOut, const uint8_t nCmd, const uint32_t nToken, const uint32_t nConv)
+    {
+        Encode32(pOut, 0);
+        pOut[4] = (char)nCmd;
+        Encode32(pOut + 5, nToken);
+        Encode32(pOut + 9, nConv);
+    }
+
+    //keyed by a secret of the server, never 0
+    static uint32_t MakeCookie(const uint64_t nSecret, const uint64_t nAddrKey, const uint32_t nToken, const uint32_t nPeriod)
+    {
+        uint64_t nHash = Mix(nSecret ^ nAddrKey);
+        nHash = Mix(nHash ^ (((uint64_t)nToken << 32) | nPeriod));
+        const uint32_t nCookie = (uint32_t)(nHash ^ (nHash >> 32));
+        return (nCookie == 0 ? 1 : nCookie);
+    }
+
+    static bool CheckCookie(const uint64_t nSecret, const uint64_t nAddrKey, const uint32_t nToken, const uint32_t nCookie, const uint32_t nNow)
+    {
+        const uint32_t nPeriod = nNow / ARK_KCP_COOKIE_PERIOD;
+        return (nCookie == MakeCookie(nSecret, nAddrKey, nToken, nPeriod) || nCookie == MakeCookie(nSecret, nAddrKey, nToken, nPeriod - 1));
+    }
+
+    static bool Parse(const char* pData, const size_t nLen, uint8_t& nCmd, uint32_t& nToken, uint32_t& nConv)
+    {
+        if (nLen != ARK_KCP_CTRL_LENGTH || AFNetKcp::GetConv(pData, nLen) != 0)
+        {
+            return false;
+        }
+
+        nCmd = (uint8_t)pData[4];
+        nToken = AFNetKcp::GetConv(pData + 5, sizeof(uint32_t));
+        nConv = AFNetKcp::GetConv(pData + 9, sizeof(uint32_t));
+        return true;
+    }
+
+private:
+    static void Encode32(char* pOut, const uint32_t nValue)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            pOut[i] = (char)((nValue >> (i * 8)) & 0xFF);
+        }
+    }
+
+    //finalizer of splitmix64
+    static uint64_t Mix(uint64_t nValue)
+    {
+        nValue = (nValue ^ (nValue >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        nValue = (nValue ^ (nValue >> 27)) * 0x94D049BB133111EBULL;
+        return nValue ^ (nValue >> 31);
+    }
+};
+
+class AFKcpEntity;
+using AFKcpMsg = AFNetMsg<AFKcpEntity*>;
+
+//A reliable udp link. The io thread feeds the kcp and drives its timers, the logic thread sends through it,
+//both under mxKcpLock. The received bytes are gathered in the buffer of AFBaseNetEntity like the ones of tcp.
+class AFKcpEntity : public AFBaseNetEntity
+{
+public:
+    AFKcpEntity(AFINet* pNet, const AFGUID& xClientID, AFNetUdpSocket* pSocket, const sockaddr_in& xAddr, const uint32_t nConv, const uint32_t nToken) :
+        AFBaseNetEntity(pNet, xClientID),
+        mbInReadyList(false),
+        mbCloseRequest(false),
+        mbClosed(false),
+        mnLastRecvTime(AFNetKcp::GetClock()),
+        mnLastSendTime(AFNetKcp::GetClock()),
+        mnNextUpdate(AFNetKcp::GetClock()),
+        mnConv(nConv),
+        m_pSocket(pSocket),
+        mxAddr(xAddr),
+        mnToken(nToken),
+        mxKcp(nConv, std::bind(&AFKcpEntity::Output, this, std::placeholders::_1, std::placeholders::_2))
+    {
+        const AFNetKcpConfig& xConfig = pNet->GetKcpConfig();
+        mxKcp.SetNoDelay(xConfig.bNoDelay, xConfig.nInterval, xConfig.nResend, xConfig.bNoCwnd);
+        mxKcp.SetWndSize(xConfig.nSndWnd, xConfig.nRcvWnd);
+        mxKcp.SetMtu(xConfig.nMtu);
+    }
+
+    virtual ~AFKcpEntity()
+    {
+        AFKcpMsg* pMsg = nullptr;
+
+        while (mxNetMsgMQ.Pop(pMsg))
+        {
+            AFKcpMsg::Release(pMsg);
+        }
+    }
+
+    AFLockFreeQueue<AFKcpMsg*> mxNetMsgMQ;
+
+    //io thread: return true if the caller should put the entity to the ready list
+    bool MarkReady()
+    {
+        return !mbInReadyList.exchange(true);
+    }
+
+    //logic thread: call before handling the messages, so the new ones will mark it again
+    void ClearReady()
+    {
+        mbInReadyList.store(false);
+    }
+
+    uint64_t GetAddrKey() const
+    {
+        return AFNetUdpSocket::GetAddrKey(mxAddr);
+    }
+
+    uint32_t GetToken() const
+    {
+        return mnToken;
+    }
+
+    uint32_t GetConv() const
+    {
+        return mnConv;
+    }
+
+    //client: the conv given by the server
+    void SetConv(const uint32_t nConv)
+    {
+        std::lock_guard<std::mutex> xGuard(mxKcpLock);
+        mxKcp.SetConv(nConv);
+        mnConv = nConv;
+    }
+
+    //logic thread: the bytes are cut into segments at once, and sent at once in no delay mode
+    bool Send(const char* pData, const size_t nLen)
+    {
+        if (mbClosed)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> xGuard(mxKcpLock);
+        mxKcp.Send(pData, nLen);
+
+        if (mxKcp.IsNoDelay())
+        {
+            mxKcp.Flush(AFNetKcp::GetClock());
+        }
+
+        return true;
+    }
+
+    //bytes not acked yet
+    size_t GetSendBacklog()
+    {
+        std::lock_guard<std::mutex> xGuard(mxKcpLock);
+        return mxKcp.GetWaitSnd() * mxKcp.GetMss();
+    }
+
+    //io thread: a datagram of this link, the bytes received in order are appended to the buffer
+    bool Input(const char* pData, const size_t nLen, const uint32_t nNow)
+    {
+        mnLastRecvTime = nNow;
+
+        std::lock_guard<std::mutex> xGuard(mxKcpLock);
+
+        if (!mxKcp.Input(pData, nLen))
+        {
+            return false;
+        }
+
+        mxKcp.Recv([this](const char* pRecv, const size_t nRecvLen)
+        {
+            AddBuff(pRecv, nRecvLen);
+        });
+
+        //acks of no delay mode are not held to the next interval
+        if (mxKcp.IsNoDelay() && mxKcp.HasPendingAck())
+        {
+            mxKcp.Flush(nNow);
+        }
+
+        return true;
+    }
+
+    //io thread: a control datagram of this link
+    void Touch(const uint32_t nNow)
+    {
+        mnLastRecvTime = nNow;
+    }
+
+    //io thread: timers of the link, false when it should be closed. nNextTime is the time of the next call
+    bool Tick(const uint32_t nNow, const uint32_t nTimeout, uint32_t& nNextTime)
+    {
+        if (mbCloseRequest || (int32_t)(nNow - mnLastRecvTime) >= (int32_t)nTimeout)
+        {
+            return false;
+        }
+
+        do
+        {
+            std::lock_guard<std::mutex> xGuard(mxKcpLock);
+
+            if ((int32_t)(nNow - mnNextUpdate) >= 0)
+            {
+                mxKcp.Update(nNow);
+                mnNextUpdate = mxKcp.Check(nNow);
+            }
+
+            if (mxKcp.IsDeadLink())
+            {
+                return false;
+            }
+
+            nNextTime = mnNextUpdate;
+        } while (0);
+
+        if ((int32_t)(nNow - mnLastSendTime) >= AFNetKcpControl::ARK_KCP_PING_INTERVAL)
+        {
+            SendControl(AFNetKcpControl::ARK_KCP_CTRL_PING);
+        }
+
+        return true;
+    }
+
+    //any thread
+    void SendControl(const uint8_t nCmd)
+    {
+        char szData[AFNetKcpControl::ARK_KCP_CTRL_LENGTH];
+        AFNetKcpControl::Make(szData, nCmd, mnToken, GetConv());
+        m_pSocket->SendTo(szData, sizeof(szData), mxAddr);
+        mnLastSendTime = AFNetKcp::GetClock();
+    }
+
+    //logic thread: the io thread closes the link in its next loop
+    void RequestClose()
+    {
+        mbCloseRequest = true;
+    }
+
+    //io thread: no more sends, the entity is handed to the logic thread to be deleted
+    void SetClosed()
+    {
+        mbClosed = true;
+    }
+
+    bool IsClosed() const
+    {
+        return mbClosed;
+    }
+
+private:
+    void Output(const char* pData, const size_t nLen)
+    {
+        m_pSocket->SendTo(pData, nLen, mxAddr);
+        mnLastSendTime = AFNetKcp::GetClock();
+    }
+
+    std::atomic<bool> mbInReadyList;
+    std::atomic<bool> mbCloseRequest;
+    std::atomic<bool> mbClosed;
+
+    uint32_t mnLastRecvTime; //io thread
+    std::atomic<uint32_t> mnLastSendTime;
+    uint32_t mnNextUpdate; //guarded by mxKcpLock
+    std::atomic<uint32_t> mnConv;
+
+    AFNetUdpSocket* m_pSocket;
+    const sockaddr_in mxAddr;
+    const uint32_t mnToken;
+
+    std::mutex mxKcpLock;
+    AFNetKcp mxKcp;
+};
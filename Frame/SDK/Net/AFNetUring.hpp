@@ -0,0 +1,513 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "AFINet.h"
+#include "SDK/Core/AFNoncopyable.hpp"
+#include "SDK/Core/AFSpinLock.hpp"
+
+//io_uring needs the kernel headers of linux 6.0 or later(multishot recv, provided buffer rings), there is no liburing dependency
+#if ARK_PLATFORM == PLATFORM_UNIX && defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#if defined(IORING_RECV_MULTISHOT)
+#define ARK_HAVE_IO_URING 1
+#else
+#define ARK_HAVE_IO_URING 0
+#endif
+
+#if ARK_HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <netinet/tcp.h>
+
+//Submission and completion rings of one io thread, the thread which calls Init is the only one which submits.
+class AFNetUring : public AFNoncopyable
+{
+public:
+    AFNetUring() = default;
+
+    ~AFNetUring()
+    {
+        Close();
+    }
+
+    bool Init(const unsigned int nEntries)
+    {
+        io_uring_params xParams;
+        memset(&xParams, 0, sizeof(xParams));
+        xParams.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_CQSIZE;
+        xParams.cq_entries = nEntries * 4;
+
+        mnFD = (int)syscall(__NR_io_uring_setup, nEntries, &xParams);
+
+        if (mnFD < 0 || (xParams.features & IORING_FEAT_SINGLE_MMAP) == 0)
+        {
+            Close();
+            return false;
+        }
+
+        mnRingSize = std::max(xParams.sq_off.array + xParams.sq_entries * sizeof(uint32_t), xParams.cq_off.cqes + xParams.cq_entries * sizeof(io_uring_cqe));
+        m_pRing = (char*)mmap(nullptr, mnRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mnFD, IORING_OFF_SQ_RING);
+        mnSqeSize = xParams.sq_entries * sizeof(io_uring_sqe);
+        m_pSqes = (io_uring_sqe*)mmap(nullptr, mnSqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mnFD, IORING_OFF_SQES);
+
+        if (m_pRing == MAP_FAILED || m_pSqes == MAP_FAILED)
+        {
+            m_pRing = (m_pRing == MAP_FAILED ? nullptr : m_pRing);
+            m_pSqes = (m_pSqes == MAP_FAILED ? nullptr : m_pSqes);
+            Close();
+            return false;
+        }
+
+        m_pSqHead = (uint32_t*)(m_pRing + xParams.sq_off.head);
+        m_pSqTail = (uint32_t*)(m_pRing + xParams.sq_off.tail);
+        mnSqMask = *(uint32_t*)(m_pRing + xParams.sq_off.ring_mask);
+        mnSqEntries = xParams.sq_entries;
+        m_pSqArray = (uint32_t*)(m_pRing + xParams.sq_off.array);
+
+        m_pCqHead = (uint32_t*)(m_pRing + xParams.cq_off.head);
+        m_pCqTail = (uint32_t*)(m_pRing + xParams.cq_off.tail);
+        mnCqMask = *(uint32_t*)(m_pRing + xParams.cq_off.ring_mask);
+        m_pCqes = (io_uring_cqe*)(m_pRing + xParams.cq_off.cqes);
+
+        mnSqTail = *m_pSqTail;
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_pSqes != nullptr)
+        {
+            munmap(m_pSqes, mnSqeSize);
+            m_pSqes = nullptr;
+        }
+
+        if (m_pRing != nullptr)
+        {
+            munmap(m_pRing, mnRingSize);
+            m_pRing = nullptr;
+        }
+
+        if (mnFD >= 0)
+        {
+            close(mnFD);
+            mnFD = -1;
+        }
+    }
+
+    int GetFD() const
+    {
+        return mnFD;
+    }
+
+    //a cleared sqe, the ring is submitted first when it is full
+    io_uring_sqe* GetSqe()
+    {
+        if (mnSqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE) >= mnSqEntries)
+        {
+            Submit(0);
+        }
+
+        io_uring_sqe* pSqe = &m_pSqes[mnSqTail & mnSqMask];
+        memset(pSqe, 0, sizeof(io_uring_sqe));
+        m_pSqArray[mnSqTail & mnSqMask] = mnSqTail & mnSqMask;
+        ++mnSqTail;
+        return pSqe;
+    }
+
+    //submit all the sqes in one syscall, and wait for nWait completions
+    int Submit(const unsigned int nWait)
+    {
+        __atomic_store_n(m_pSqTail, mnSqTail, __ATOMIC_RELEASE);
+        const unsigned int nSubmit = mnSqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE);
+
+        if (nSubmit == 0 && nWait == 0)
+        {
+            return 0;
+        }
+
+        const int nRet = (int)syscall(__NR_io_uring_enter, mnFD, nSubmit, nWait, (nWait > 0 ? IORING_ENTER_GETEVENTS : 0), nullptr, 0);
+        return (nRet < 0 ? -errno : nRet);
+    }
+
+    //visit the completions, the sqes prepared by func go out with the next Submit
+    template<typename FUNC>
+    unsigned int ForEachCqe(FUNC&& func)
+    {
+        unsigned int nCount = 0;
+        uint32_t nHead = *m_pCqHead;
+        const uint32_t nTail = __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE);
+
+        for (; nHead != nTail; ++nHead, ++nCount)
+        {
+            func(m_pCqes[nHead & mnCqMask]);
+        }
+
+        __atomic_store_n(m_pCqHead, nHead, __ATOMIC_RELEASE);
+        return nCount;
+    }
+
+    void PrepAcceptMultishot(const int nListenFD, const uint64_t nUserData)
+    {
+        io_uring_sqe* pSqe = GetSqe();
+        pSqe->opcode = IORING_OP_ACCEPT;
+        pSqe->fd = nListenFD;
+        pSqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        pSqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        pSqe->user_data = nUserData;
+    }
+
+    //the data go to a buffer of the group, the buffer id is in the flags of the cqe
+    void PrepRecvMultishot(const int nFD, const uint16_t nBufGroup, const uint64_t nUserData)
+    {
+        io_uring_sqe* pSqe = GetSqe();
+        pSqe->opcode = IORING_OP_RECV;
+        pSqe->fd = nFD;
+        pSqe->ioprio = IORING_RECV_MULTISHOT;
+        pSqe->flags = IOSQE_BUFFER_SELECT;
+        pSqe->buf_group = nBufGroup;
+        pSqe->user_data = nUserData;
+    }
+
+    void PrepWritev(const int nFD, const iovec* pIovecs, const unsigned int nCount, const uint64_t nUserData)
+    {
+        io_uring_sqe* pSqe = GetSqe();
+        pSqe->opcode = IORING_OP_WRITEV;
+        pSqe->fd = nFD;
+        pSqe->addr = (uint64_t)(uintptr_t)pIovecs;
+        pSqe->len = nCount;
+        pSqe->user_data = nUserData;
+    }
+
+    void PrepRead(const int nFD, void* pBuffer, const unsigned int nLen, const uint64_t nUserData)
+    {
+        io_uring_sqe* pSqe = GetSqe();
+        pSqe->opcode = IORING_OP_READ;
+        pSqe->fd = nFD;
+        pSqe->addr = (uint64_t)(uintptr_t)pBuffer;
+        pSqe->len = nLen;
+        pSqe->off = (uint64_t)(-1);
+        pSqe->user_data = nUserData;
+    }
+
+private:
+    int mnFD{ -1 };
+    char* m_pRing{ nullptr };
+    size_t mnRingSize{ 0 };
+    io_uring_sqe* m_pSqes{ nullptr };
+    size_t mnSqeSize{ 0 };
+
+    uint32_t* m_pSqHead{ nullptr };
+    uint32_t* m_pSqTail{ nullptr };
+    uint32_t* m_pSqArray{ nullptr };
+    uint32_t mnSqMask{ 0 };
+    uint32_t mnSqEntries{ 0 };
+    uint32_t mnSqTail{ 0 }; //local tail, published by Submit
+
+    uint32_t* m_pCqHead{ nullptr };
+    uint32_t* m_pCqTail{ nullptr };
+    uint32_t mnCqMask{ 0 };
+    io_uring_cqe* m_pCqes{ nullptr };
+};
+
+//Receive buffers registered to the kernel, a multishot recv takes one for every completion,
+//the io thread gives it back after the data are copied to the session buffer.
+class AFNetUringBufRing : public AFNoncopyable
+{
+public:
+    AFNetUringBufRing() = default;
+
+    ~AFNetUringBufRing()
+    {
+        if (m_pBufRing != nullptr)
+        {
+            munmap(m_pBufRing, mnCount * sizeof(io_uring_buf));
+        }
+
+        delete[] m_pBuffers;
+    }
+
+    //nCount is a power of 2
+    bool Init(AFNetUring& xRing, const uint16_t nGroup, const uint32_t nCount, const uint32_t nSize)
+    {
+        void* pMem = mmap(nullptr, nCount * sizeof(io_uring_buf), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+        if (pMem == MAP_FAILED)
+        {
+            return false;
+        }
+
+        m_pBufRing = (io_uring_buf_ring*)pMem;
+        mnCount = nCount;
+        mnSize = nSize;
+
+        io_uring_buf_reg xReg;
+        memset(&xReg, 0, sizeof(xReg));
+        xReg.ring_addr = (uint64_t)(uintptr_t)m_pBufRing;
+        xReg.ring_entries = nCount;
+        xReg.bgid = nGroup;
+
+        if (syscall(__NR_io_uring_register, xRing.GetFD(), IORING_REGISTER_PBUF_RING, &xReg, 1) != 0)
+        {
+            return false;
+        }
+
+        m_pBuffers = new char[(size_t)nCount * nSize];
+
+        for (uint32_t i = 0; i < nCount; ++i)
+        {
+            Add((uint16_t)i);
+        }
+
+        Commit();
+        return true;
+    }
+
+    const char* GetBuffer(const uint16_t nBufID) const
+    {
+        return m_pBuffers + (size_t)nBufID * mnSize;
+    }
+
+    //give the buffer back, the kernel sees it after Commit
+    void Add(const uint16_t nBufID)
+    {
+        //bufs is not at offset 0 when the flex array of the kernel header is built as c++, the entries are indexed from the base
+        io_uring_buf& xBuf = reinterpret_cast<io_uring_buf*>(m_pBufRing)[(mnTail + mnAdded) & (mnCount - 1)];
+        xBuf.addr = (uint64_t)(uintptr_t)GetBuffer(nBufID);
+        xBuf.len = mnSize;
+        xBuf.bid = nBufID;
+        ++mnAdded;
+    }
+
+    void Commit()
+    {
+        mnTail = (uint16_t)(mnTail + mnAdded);
+        mnAdded = 0;
+        __atomic_store_n(&m_pBufRing->tail, mnTail, __ATOMIC_RELEASE);
+    }
+
+private:
+    io_uring_buf_ring* m_pBufRing{ nullptr };
+    char* m_pBuffers{ nullptr };
+    uint32_t mnCount{ 0 };
+    uint32_t mnSize{ 0 };
+    uint16_t mnTail{ 0 };
+    uint16_t mnAdded{ 0 };
+};
+
+class AFUringEntity;
+using AFUringMsg = AFNetMsg<AFUringEntity*>;
+
+//A tcp session of AFCUringNetServer. The io thread owns the fd and the writes in flight,
+//the logic thread queues packets under mxSendLock and hands the session to the io thread in Flush.
+class AFUringEntity : public AFBaseNetEntity
+{
+public:
+    enum
+    {
+        ARK_URING_MAX_IOV = 64,
+    };
+
+    AFUringEntity(AFINet* pNet, const AFGUID& xClientID, const int nFD, const size_t nWorker) :
+        AFBaseNetEntity(pNet, xClientID),
+        mnFD(nFD),
+        mnWorker(nWorker),
+        mbInReadyList(false),
+        mbSendQueued(false),
+        mbCloseRequest(false),
+        mbClosed(false),
+        mnSendQueueBytes(0)
+    {
+    }
+
+    virtual ~AFUringEntity()
+    {
+        AFUringMsg* pMsg = nullptr;
+
+        while (mxNetMsgMQ.Pop(pMsg))
+        {
+            AFUringMsg::Release(pMsg);
+        }
+    }
+
+    AFLockFreeQueue<AFUringMsg*> mxNetMsgMQ;
+
+    //io thread: return true if the caller should put the entity to the ready list
+    bool MarkReady()
+    {
+        return !mbInReadyList.exchange(true);
+    }
+
+    //logic thread: call before handling the messages, so the new ones will mark it again
+    void ClearReady()
+    {
+        mbInReadyList.store(false);
+    }
+
+    int GetFD() const
+    {
+        return mnFD;
+    }
+
+    size_t GetWorker() const
+    {
+        return mnWorker;
+    }
+
+    //logic thread: return true if the caller should hand the entity to the io thread
+    bool QueueSend(const brynet::net::DataSocket::PACKET_PTR& xPacket)
+    {
+        mnSendQueueBytes.fetch_add(xPacket->size(), std::memory_order_relaxed);
+
+        std::lock_guard<AFSpinLock> xGuard(mxSendLock);
+        mxSendQueue.push_back(xPacket);
+        return !mbSendQueued.exchange(true);
+    }
+
+    //logic thread: closed by io thread after the writes in flight, return true if the caller should hand the entity to the io thread
+    bool RequestClose()
+    {
+        mbCloseRequest = true;
+        return !mbSendQueued.exchange(true);
+    }
+
+    bool IsCloseRequested() const
+    {
+        return mbCloseRequest;
+    }
+
+    //io thread: called before TakeSend, so the packets queued after will hand the entity again
+    void ClearSendQueued()
+    {
+        mbSendQueued.store(false);
+    }
+
+    //io thread: build the iovecs of the next write, false if there is nothing to write
+    bool PrepareWrite()
+    {
+        if (mnWriteIndex >= mxWriting.size())
+        {
+            mxWriting.clear();
+            mnWriteIndex = 0;
+            mnWriteOffset = 0;
+
+            std::lock_guard<AFSpinLock> xGuard(mxSendLock);
+            mxWriting.swap(mxSendQueue);
+        }
+
+        mxIovecs.clear();
+
+        for (size_t i = mnWriteIndex; i < mxWriting.size() && mxIovecs.size() < ARK_URING_MAX_IOV; ++i)
+        {
+            const size_t nOffset = (i == mnWriteIndex ? mnWriteOffset : 0);
+            iovec xIovec;
+            //a broadcast packet is shared by the sessions, it is only read
+            xIovec.iov_base = const_cast<char*>(mxWriting[i]->data()) + nOffset;
+            xIovec.iov_len = mxWriting[i]->size() - nOffset;
+            mxIovecs.push_back(xIovec);
+        }
+
+        return !mxIovecs.empty();
+    }
+
+    const iovec* GetIovecs() const
+    {
+        return mxIovecs.data();
+    }
+
+    unsigned int GetIovecCount() const
+    {
+        return (unsigned int)mxIovecs.size();
+    }
+
+    //io thread: nBytes of the write are on the wire, a short write leaves the rest for the next one
+    void OnWritten(size_t nBytes)
+    {
+        mnSendQueueBytes.fetch_sub(nBytes, std::memory_order_relaxed);
+
+        while (nBytes > 0 && mnWriteIndex < mxWriting.size())
+        {
+            const size_t nLeft = mxWriting[mnWriteIndex]->size() - mnWriteOffset;
+
+            if (nBytes < nLeft)
+            {
+                mnWriteOffset += nBytes;
+                break;
+            }
+
+            nBytes -= nLeft;
+            mxWriting[mnWriteIndex] = nullptr;
+            ++mnWriteIndex;
+            mnWriteOffset = 0;
+        }
+    }
+
+    size_t GetSendBacklog() const
+    {
+        return mnSendQueueBytes.load(std::memory_order_relaxed);
+    }
+
+    void SetClosed()
+    {
+        mbClosed = true;
+    }
+
+    bool IsClosed() const
+    {
+        return mbClosed;
+    }
+
+    //io thread only
+    int mnPendingOps{ 0 };  //recv armed and write in flight, the fd is closed when it is 0
+    bool mbRecvArmed{ false };
+    bool mbWriting{ false };
+    bool mbClosing{ false };
+
+    //logic thread only, set between SENDHIGHWATER and SENDLOWWATER
+    bool mbSendHighWater{ false };
+
+private:
+    const int mnFD;
+    const size_t mnWorker;
+    std::atomic<bool> mbInReadyList;
+    std::atomic<bool> mbSendQueued;
+    std::atomic<bool> mbCloseRequest;
+    std::atomic<bool> mbClosed;
+    std::atomic<size_t> mnSendQueueBytes;
+
+    AFSpinLock mxSendLock;
+    std::vector<brynet::net::DataSocket::PACKET_PTR> mxSendQueue;
+
+    //io thread only
+    std::vector<brynet::net::DataSocket::PACKET_PTR> mxWriting;
+    size_t mnWriteIndex{ 0 };
+    size_t mnWriteOffset{ 0 };
+    std::vector<iovec> mxIovecs;
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+
+//Accept benchmark of SO_REUSEPORT listeners, connections accepted per second and accept latency as the listener count grows.
+//Loopback clients connect as fast as they can, the latency of a connection is from the start of connect() to the return of accept().
+//Only needs the headers, e.g.
+//g++ -O2 -std=c++11 -I../../ TestAcceptBench.cpp -o TestAcceptBench -lpthread
+//./TestAcceptBench [connections per run] [client threads]
+
+#include "SDK/Core/AFPlatform.hpp"
+#include "AFNetAcceptor.hpp"
+
+#if ARK_PLATFORM == PLATFORM_UNIX
+#include <netinet/in.h>
+
+namespace
+{
+
+const int BENCH_BASE_PORT = 27100;
+
+int64_t NowUS()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct AcceptResult
+{
+    double dRate{ 0.0 };
+    int64_t nP50{ 0 };
+    int64_t nP99{ 0 };
+    int64_t nMax{ 0 };
+    size_t nCount{ 0 };
+};
+
+AcceptResult Run(int nListenerCount, int nPort, int nConnCount, int nClientCount)
+{
+    AcceptResult xResult;
+    //every acceptor writes its own list only
+    std::vector<std::vector<int64_t>> xLatencyList(nListenerCount);
+    std::vector<std::unique_ptr<AFNetAcceptor>> xAcceptorList;
+
+    for (int i = 0; i < nListenerCount; ++i)
+    {
+        std::vector<int64_t>* pLatency = &xLatencyList[i];
+        std::unique_ptr<AFNetAcceptor> pAcceptor(new AFNetAcceptor());
+
+        bool bRet = pAcceptor->Start("127.0.0.1", nPort, i, [pLatency](int fd)
+        {
+            //the client sends the time it started connect() right after connected
+            int64_t nStart = 0;
+
+            if (recv(fd, &nStart, sizeof(nStart), MSG_WAITALL) == sizeof(nStart))
+            {
+                pLatency->push_back(NowUS() - nStart);
+            }
+
+            close(fd);
+        });
+
+        if (!bRet)
+        {
+            std::cout << "listen failed, port = " << nPort << std::endl;
+            return xResult;
+        }
+
+        xAcceptorList.push_back(std::move(pAcceptor));
+    }
+
+    sockaddr_in xAddr;
+    memset(&xAddr, 0, sizeof(xAddr));
+    xAddr.sin_family = AF_INET;
+    xAddr.sin_port = htons((uint16_t)nPort);
+    inet_pton(AF_INET, "127.0.0.1", &xAddr.sin_addr);
+
+    std::atomic<int> nNext(0);
+    std::vector<std::thread> xThreads;
+    int64_t nBegin = NowUS();
+
+    for (int i = 0; i < nClientCount; ++i)
+    {
+        xThreads.emplace_back([&nNext, &xAddr, nConnCount]()
+        {
+            while (nNext++ < nConnCount)
+            {
+                int fd = socket(AF_INET, SOCK_STREAM, 0);
+                int64_t nStart = NowUS();
+
+                if (fd >= 0 && connect(fd, (sockaddr*)&xAddr, sizeof(xAddr)) == 0)
+                {
+                    send(fd, &nStart, sizeof(nStart), 0);
+                    //wait for the server to close first, keep TIME_WAIT out of the client port range
+                    char c;
+                    recv(fd, &c, sizeof(c), 0);
+                }
+
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+            }
+        });
+    }
+
+    for (auto& xThread : xThreads)
+    {
+        xThread.join();
+    }
+
+    int64_t nCost = NowUS() - nBegin;
+
+    for (auto& pAcceptor : xAcceptorList)
+    {
+        pAcceptor->Stop();
+    }
+
+    std::vector<int64_t> xAll;
+
+    for (auto& xLatency : xLatencyList)
+    {
+        xAll.insert(xAll.end(), xLatency.begin(), xLatency.end());
+    }
+
+    if (xAll.empty() || nCost <= 0)
+    {
+        return xResult;
+    }
+
+    std::sort(xAll.begin(), xAll.end());
+    xResult.nCount = xAll.size();
+    xResult.dRate = xAll.size() * 1000000.0 / nCost;
+    xResult.nP50 = xAll[xAll.size() / 2];
+    xResult.nP99 = xAll[std::min(xAll.size() - 1, xAll.size() * 99 / 100)];
+    xResult.nMax = xAll.back();
+    return xResult;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const int nConnCount = (argc > 1 ? atoi(argv[1]) : 20000);
+    const int nClientCount = (argc > 2 ? atoi(argv[2]) : 8);
+    const int xListenerCounts[] = { 1, 2, 4, 8 };
+
+    std::cout << "cpus: " << AFNetAcceptor::GetCpuCount() << " connections: " << nConnCount << " client threads: " << nClientCount << std::endl;
+
+    for (int nListenerCount : xListenerCounts)
+    {
+        //a new port every run, TIME_WAIT of the last run does not matter
+        AcceptResult xResult = Run(nListenerCount, BENCH_BASE_PORT + nListenerCount, nConnCount, nClientCount);
+
+        std::cout << "listeners: " << nListenerCount
+                  << " accepted: " << xResult.nCount
+                  << " rate: " << (size_t)xResult.dRate << " conn/s"
+                  << " p50: " << xResult.nP50 << " us"
+                  << " p99: " << xResult.nP99 << " us"
+                  << " max: " << xResult.nMax << " us" << std::endl;
+    }
+
+    return 0;
+}
+
+#else
+
+int main(int argc, char* argv[])
+{
+    std::cout << "SO_REUSEPORT is not supported on this platform" << std::endl;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,626 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+
+//Load generation and latency benchmark of AFCNetServer/AFCNetClient, or AFCKcpNetServer/AFCKcpNetClient, on loopback.
+//An echo server runs in its own thread, the clients are driven by the main thread, every request carries the time it is due,
+//so the round trip latency of fixed/open mode includes the time a late request waits to be sent(no coordinated omission).
+//
+//mode=closed  every connection keeps [window] requests in flight
+//mode=fixed   requests at a fixed rate, [rate] msg/s over all connections
+//mode=open    open loop, Poisson arrivals with [rate] msg/s over all connections
+//
+//./TestNetBench conns=16 mode=fixed rate=50000 size=64 duration=10 warmup=2 window=1 threads=2 port=8099 format=json
+//format=json prints one json line for regression tracking, format=text prints a summary and the percentile distribution.
+//
+//transport=kcp runs the reliable udp transport, loss=0.05 delay=20 jitter=10 drop and hold back the datagrams sent by both sides,
+//so ./TestNetBench transport=kcp loss=0.05 delay=20 compares the tail latency of the transports on a lossy link.
+//
+//transport=uring runs the echo server on io_uring(linux only) with the same brynet clients, so the same load run
+//with transport=tcp and transport=uring compares the epoll and io_uring servers side by side.
+
+#include "SDK/Core/AFPlatform.hpp"
+#include "AFCNetServer.h"
+#include "AFCNetClient.h"
+#include "AFCKcpNetServer.h"
+#include "AFCKcpNetClient.h"
+#include "AFCUringNetServer.h"
+#include <iomanip>
+#include <cmath>
+
+#if ARK_PLATFORM == PLATFORM_WIN
+#pragma comment(lib,"ws2_32.lib")
+#if ARK_RUN_MODE == ARK_RUN_MODE_DEBUG
+#pragma comment(lib,"AFNet_d.lib")
+#pragma comment(lib,"AFCore_d.lib")
+#pragma comment(lib,"brynet.lib")
+#else
+#pragma comment(lib,"AFNet.lib")
+#pragma comment(lib,"AFCore.lib")
+#pragma comment(lib,"brynet.lib")
+#endif
+#endif
+
+namespace
+{
+
+const int BENCH_MSG_ID = 1;
+
+int64_t NowNS()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Log-linear histogram in the way of HdrHistogram, values in ns.
+//Values below 2^SUB_BITS are exact, above that every power of two is split into HALF_COUNT buckets(~1.5% precision).
+class LatencyHistogram
+{
+public:
+    enum
+    {
+        SUB_BITS = 7,
+        SUB_COUNT = 1 << SUB_BITS,
+        HALF_COUNT = SUB_COUNT / 2,
+        MAX_SHIFT = 40,
+    };
+
+    LatencyHistogram() : mxCounts(SUB_COUNT + MAX_SHIFT * HALF_COUNT, 0) {}
+
+    void Record(int64_t nValue)
+    {
+        uint64_t nValueU = (nValue > 0 ? (uint64_t)nValue : 0);
+        ++mxCounts[Index(nValueU)];
+        ++mnTotal;
+        mnSum += nValueU;
+        mnMin = std::min(mnMin, nValueU);
+        mnMax = std::max(mnMax, nValueU);
+    }
+
+    uint64_t GetTotal() const
+    {
+        return mnTotal;
+    }
+
+    uint64_t GetMin() const
+    {
+        return (mnTotal > 0 ? mnMin : 0);
+    }
+
+    uint64_t GetMax() const
+    {
+        return mnMax;
+    }
+
+    double GetMean() const
+    {
+        return (mnTotal > 0 ? (double)mnSum / mnTotal : 0.0);
+    }
+
+    //the highest value of the bucket holding the percentile, like HdrHistogram
+    uint64_t ValueAtPercentile(double dPercentile) const
+    {
+        if (mnTotal == 0)
+        {
+            return 0;
+        }
+
+        uint64_t nTarget = (uint64_t)std::ceil(dPercentile / 100.0 * mnTotal);
+        nTarget = std::max<uint64_t>(1, std::min(nTarget, mnTotal));
+        uint64_t nCount = 0;
+
+        for (size_t i = 0; i < mxCounts.size(); ++i)
+        {
+            nCount += mxCounts[i];
+
+            if (nCount >= nTarget)
+            {
+                return std::min(Highest(i), mnMax);
+            }
+        }
+
+        return mnMax;
+    }
+
+    //call back every non-empty bucket with [highest value, count, cumulative percentile]
+    template<typename Func>
+    void ForEach(Func&& func) const
+    {
+        uint64_t nCount = 0;
+
+        for (size_t i = 0; i < mxCounts.size(); ++i)
+        {
+            if (mxCounts[i] == 0)
+            {
+                continue;
+            }
+
+            nCount += mxCounts[i];
+            func(std::min(Highest(i), mnMax), mxCounts[i], 100.0 * nCount / mnTotal);
+        }
+    }
+
+private:
+    size_t Index(uint64_t nValue) const
+    {
+        if (nValue < SUB_COUNT)
+        {
+            return (size_t)nValue;
+        }
+
+        int nMsb = 0;
+
+        for (uint64_t n = nValue; n > 1; n >>= 1)
+        {
+            ++nMsb;
+        }
+
+        //nValue >> nShift is in [HALF_COUNT, SUB_COUNT)
+        const int nShift = nMsb - (SUB_BITS - 1);
+        size_t nIndex = SUB_COUNT + (nShift - 1) * HALF_COUNT + (size_t)((nValue >> nShift) - HALF_COUNT);
+        return std::min(nIndex, mxCounts.size() - 1);
+    }
+
+    static uint64_t Highest(size_t nIndex)
+    {
+        if (nIndex < SUB_COUNT)
+        {
+            return nIndex;
+        }
+
+        const size_t nRest = nIndex - SUB_COUNT;
+        const int nShift = (int)(nRest / HALF_COUNT) + 1;
+        const uint64_t nSub = nRest % HALF_COUNT + HALF_COUNT;
+        return ((nSub + 1) << nShift) - 1;
+    }
+
+    std::vector<uint64_t> mxCounts;
+    uint64_t mnTotal{ 0 };
+    uint64_t mnSum{ 0 };
+    uint64_t mnMin{ std::numeric_limits<uint64_t>::max() };
+    uint64_t mnMax{ 0 };
+};
+
+struct BenchConfig
+{
+    int nConns{ 16 };
+    std::string strMode{ "closed" };
+    int64_t nRate{ 50000 };
+    int nSize{ 64 };
+    int nDuration{ 10 };
+    int nWarmup{ 2 };
+    int nWindow{ 1 };
+    int nThreads{ 2 };
+    int nPort{ 8099 };
+    std::string strFormat{ "json" };
+    std::string strTransport{ "tcp" };
+    AFNetFaultConfig xFault;
+
+    bool Parse(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string strArg(argv[i]);
+            size_t nPos = strArg.find('=');
+
+            if (nPos == std::string::npos)
+            {
+                return false;
+            }
+
+            std::string strKey = strArg.substr(0, nPos);
+            std::string strValue = strArg.substr(nPos + 1);
+
+            if (strKey == "conns") nConns = atoi(strValue.c_str());
+            else if (strKey == "mode") strMode = strValue;
+            else if (strKey == "rate") nRate = atoll(strValue.c_str());
+            else if (strKey == "size") nSize = atoi(strValue.c_str());
+            else if (strKey == "duration") nDuration = atoi(strValue.c_str());
+            else if (strKey == "warmup") nWarmup = atoi(strValue.c_str());
+            else if (strKey == "window") nWindow = atoi(strValue.c_str());
+            else if (strKey == "threads") nThreads = atoi(strValue.c_str());
+            else if (strKey == "port") nPort = atoi(strValue.c_str());
+            else if (strKey == "format") strFormat = strValue;
+            else if (strKey == "transport") strTransport = strValue;
+            else if (strKey == "loss") xFault.dLoss = atof(strValue.c_str());
+            else if (strKey == "delay") xFault.nDelay = atoi(strValue.c_str());
+            else if (strKey == "jitter") xFault.nJitter = atoi(strValue.c_str());
+            else return false;
+        }
+
+        //the payload carries the due time of the request
+        nSize = std::max<int>(nSize, sizeof(int64_t));
+        return nConns > 0 && nRate > 0 && nDuration > 0 && nWindow > 0 && nThreads > 0
+               && (strMode == "closed" || strMode == "fixed" || strMode == "open")
+               && (strTransport == "tcp" || strTransport == "kcp" || (strTransport == "uring" && ARK_HAVE_IO_URING));
+    }
+};
+
+class BenchServer
+{
+public:
+    BenchServer(const BenchConfig& xConfig) : mbRunning(false)
+    {
+        if (xConfig.strTransport == "kcp")
+        {
+            m_pNet = new AFCKcpNetServer(this, &BenchServer::ReciveHandler, &BenchServer::EventHandler);
+            m_pNet->SetFaultInjection(xConfig.xFault);
+        }
+#if ARK_HAVE_IO_URING
+        else if (xConfig.strTransport == "uring")
+        {
+            m_pNet = new AFCUringNetServer(this, &BenchServer::ReciveHandler, &BenchServer::EventHandler);
+        }
+#endif
+        else
+        {
+            m_pNet = new AFCNetServer(this, &BenchServer::ReciveHandler, &BenchServer::EventHandler);
+        }
+    }
+
+    ~BenchServer()
+    {
+        Stop();
+        delete m_pNet;
+    }
+
+    bool Start(const BenchConfig& xConfig)
+    {
+        std::string strAddr = "127.0.0.1:" + std::to_string(xConfig.nPort);
+
+        if (m_pNet->Start(xConfig.nConns * 2, strAddr, 1, xConfig.nThreads) < 0)
+        {
+            return false;
+        }
+
+        mbRunning = true;
+        mxThread = std::thread([this]()
+        {
+            while (mbRunning)
+            {
+                m_pNet->Update();
+            }
+        });
+
+        return true;
+    }
+
+    void Stop()
+    {
+        mbRunning = false;
+
+        if (mxThread.joinable())
+        {
+            mxThread.join();
+        }
+    }
+
+    void ReciveHandler(const AFIMsgHead& xHead, const int nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID)
+    {
+        m_pNet->SendMsgWithOutHead(nMsgID, msg, nLen, xClientID, 0);
+    }
+
+    void EventHandler(const NetEventType e, const AFGUID& xClientID, const int nServerID)
+    {
+    }
+
+private:
+    AFINet* m_pNet;
+    std::atomic<bool> mbRunning;
+    std::thread mxThread;
+};
+
+class BenchConn
+{
+public:
+    BenchConn(const BenchConfig& xConfig, LatencyHistogram* pHistogram) : m_pHistogram(pHistogram)
+    {
+        if (xConfig.strTransport == "kcp")
+        {
+            m_pNet = new AFCKcpNetClient(this, &BenchConn::ReciveHandler, &BenchConn::EventHandler);
+            m_pNet->SetFaultInjection(xConfig.xFault);
+        }
+        else
+        {
+            m_pNet = new AFCNetClient(this, &BenchConn::ReciveHandler, &BenchConn::EventHandler);
+        }
+    }
+
+    ~BenchConn()
+    {
+        delete m_pNet;
+    }
+
+    void ReciveHandler(const AFIMsgHead& xHead, const int nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID)
+    {
+        if (nLen < sizeof(int64_t))
+        {
+            return;
+        }
+
+        int64_t nDueTime = 0;
+        memcpy(&nDueTime, msg, sizeof(nDueTime));
+
+        --mnInFlight;
+        ++mnRecvCount;
+        mnRecvBytes += nLen;
+
+        //requests due in warm up are not recorded
+        if (nDueTime >= mnRecordTime)
+        {
+            m_pHistogram->Record(NowNS() - nDueTime);
+        }
+    }
+
+    void EventHandler(const NetEventType e, const AFGUID& xClientID, const int nServerID)
+    {
+        mbConnected = (e == CONNECTED);
+    }
+
+    void Send(std::string& strData, int64_t nDueTime)
+    {
+        memcpy(&strData[0], &nDueTime, sizeof(nDueTime));
+
+        if (m_pNet->SendMsgWithOutHead(BENCH_MSG_ID, strData.data(), strData.size(), 0, 0))
+        {
+            ++mnInFlight;
+            ++mnSendCount;
+        }
+    }
+
+    AFINet* m_pNet;
+    LatencyHistogram* m_pHistogram;
+    bool mbConnected{ false };
+    int64_t mnNextTime{ 0 };
+    int64_t mnRecordTime{ 0 };
+    int64_t mnInFlight{ 0 };
+    uint64_t mnSendCount{ 0 };
+    uint64_t mnRecvCount{ 0 };
+    uint64_t mnRecvBytes{ 0 };
+};
+
+bool IsAllConnected(const std::vector<std::unique_ptr<BenchConn>>& xConns)
+{
+    for (auto& pConn : xConns)
+    {
+        if (!pConn->mbConnected)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool IsAnyInFlight(const std::vector<std::unique_ptr<BenchConn>>& xConns)
+{
+    for (auto& pConn : xConns)
+    {
+        if (pConn->mbConnected && pConn->mnInFlight > 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void UpdateAll(std::vector<std::unique_ptr<BenchConn>>& xConns)
+{
+    for (auto& pConn : xConns)
+    {
+        pConn->m_pNet->Update();
+    }
+}
+
+void PrintResult(const BenchConfig& xConfig, const LatencyHistogram& xHistogram, uint64_t nSendCount, uint64_t nRecvCount, uint64_t nRecvBytes, double dSeconds)
+{
+    const double xPercentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+    const char* xNames[] = { "p50", "p90", "p99", "p999" };
+
+    if (xConfig.strFormat == "json")
+    {
+        std::ostringstream xStream;
+        xStream << "{\"bench\":\"ark_net\",\"transport\":\"" << xConfig.strTransport << "\""
+                << ",\"mode\":\"" << xConfig.strMode << "\""
+                << ",\"conns\":" << xConfig.nConns
+                << ",\"size\":" << xConfig.nSize
+                << ",\"rate\":" << (xConfig.strMode == "closed" ? 0 : xConfig.nRate)
+                << ",\"window\":" << xConfig.nWindow
+                << ",\"threads\":" << xConfig.nThreads
+                << ",\"duration\":" << dSeconds
+                << ",\"sent\":" << nSendCount
+                << ",\"received\":" << nRecvCount
+                << ",\"msgs_per_sec\":" << (uint64_t)(nRecvCount / dSeconds)
+                << ",\"bytes_per_sec\":" << (uint64_t)(nRecvBytes / dSeconds)
+                << ",\"latency_us\":{\"count\":" << xHistogram.GetTotal()
+                << ",\"min\":" << xHistogram.GetMin() / 1000.0
+                << ",\"mean\":" << xHistogram.GetMean() / 1000.0;
+
+        for (size_t i = 0; i < ARRAY_LENTGH(xPercentiles); ++i)
+        {
+            xStream << ",\"" << xNames[i] << "\":" << xHistogram.ValueAtPercentile(xPercentiles[i]) / 1000.0;
+        }
+
+        xStream << ",\"max\":" << xHistogram.GetMax() / 1000.0 << "}"
+                << ",\"histogram\":[";
+
+        bool bFirst = true;
+        xHistogram.ForEach([&xStream, &bFirst](uint64_t nValue, uint64_t nCount, double dPercentile)
+        {
+            xStream << (bFirst ? "" : ",") << "[" << nValue / 1000.0 << "," << nCount << "," << dPercentile << "]";
+            bFirst = false;
+        });
+
+        xStream << "]}";
+        std::cout << xStream.str() << std::endl;
+    }
+    else
+    {
+        std::cout << "mode: " << xConfig.strMode << " conns: " << xConfig.nConns << " size: " << xConfig.nSize
+                  << " sent: " << nSendCount << " received: " << nRecvCount
+                  << " throughput: " << (uint64_t)(nRecvCount / dSeconds) << " msg/s " << (uint64_t)(nRecvBytes / dSeconds) << " B/s" << std::endl;
+
+        for (size_t i = 0; i < ARRAY_LENTGH(xPercentiles); ++i)
+        {
+            std::cout << xNames[i] << ": " << xHistogram.ValueAtPercentile(xPercentiles[i]) / 1000.0 << " us" << std::endl;
+        }
+
+        std::cout << "max: " << xHistogram.GetMax() / 1000.0 << " us" << std::endl;
+        std::cout << std::setw(14) << "Value(us)" << std::setw(12) << "Count" << std::setw(14) << "Percentile" << std::endl;
+
+        xHistogram.ForEach([](uint64_t nValue, uint64_t nCount, double dPercentile)
+        {
+            std::cout << std::setw(14) << std::fixed << std::setprecision(3) << nValue / 1000.0
+                      << std::setw(12) << nCount
+                      << std::setw(14) << std::setprecision(6) << dPercentile << std::endl;
+        });
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    BenchConfig xConfig;
+
+    if (!xConfig.Parse(argc, argv))
+    {
+        std::cout << "usage: TestNetBench conns=16 mode=closed|fixed|open rate=50000 size=64 duration=10 warmup=2 window=1 threads=2 port=8099 format=json|text transport=tcp|kcp|uring loss=0 delay=0 jitter=0" << std::endl;
+        return 1;
+    }
+
+    BenchServer xServer(xConfig);
+
+    if (!xServer.Start(xConfig))
+    {
+        std::cout << "server start failed" << std::endl;
+        return 1;
+    }
+
+    LatencyHistogram xHistogram;
+    std::vector<std::unique_ptr<BenchConn>> xConns;
+    const std::string strAddr = "127.0.0.1:" + std::to_string(xConfig.nPort);
+
+    for (int i = 0; i < xConfig.nConns; ++i)
+    {
+        xConns.emplace_back(new BenchConn(xConfig, &xHistogram));
+        xConns.back()->m_pNet->Start(strAddr, i + 1);
+    }
+
+    //wait for all connections
+    const int64_t nConnectEnd = NowNS() + 5 * 1000000000LL;
+
+    while (NowNS() < nConnectEnd && !IsAllConnected(xConns))
+    {
+        UpdateAll(xConns);
+    }
+
+    //per connection interval of fixed/open mode
+    const double dInterval = 1e9 * xConfig.nConns / xConfig.nRate;
+    std::mt19937_64 xRandom(std::random_device{}());
+    std::exponential_distribution<double> xPoisson(1.0 / dInterval);
+    std::string strData(xConfig.nSize, 'a');
+
+    const int64_t nStart = NowNS();
+    const int64_t nRecordTime = nStart + xConfig.nWarmup * 1000000000LL;
+    const int64_t nEnd = nRecordTime + xConfig.nDuration * 1000000000LL;
+
+    for (auto& pConn : xConns)
+    {
+        pConn->mnRecordTime = nRecordTime;
+        pConn->mnNextTime = nStart + (int64_t)(xPoisson(xRandom));
+    }
+
+    uint64_t nRecordSend = 0;
+    uint64_t nRecordRecv = 0;
+    uint64_t nRecordBytes = 0;
+    bool bRecording = false;
+
+    for (int64_t nNow = NowNS(); nNow < nEnd; nNow = NowNS())
+    {
+        if (!bRecording && nNow >= nRecordTime)
+        {
+            //throughput is counted from the end of warm up
+            bRecording = true;
+
+            for (auto& pConn : xConns)
+            {
+                nRecordSend += pConn->mnSendCount;
+                nRecordRecv += pConn->mnRecvCount;
+                nRecordBytes += pConn->mnRecvBytes;
+            }
+        }
+
+        for (auto& pConn : xConns)
+        {
+            pConn->m_pNet->Update();
+
+            if (!pConn->mbConnected)
+            {
+                continue;
+            }
+
+            if (xConfig.strMode == "closed")
+            {
+                while (pConn->mnInFlight < xConfig.nWindow)
+                {
+                    pConn->Send(strData, nNow);
+                }
+            }
+            else
+            {
+                //a late request is sent now but keeps its due time
+                while (pConn->mnNextTime <= nNow)
+                {
+                    pConn->Send(strData, pConn->mnNextTime);
+                    pConn->mnNextTime += (xConfig.strMode == "fixed" ? (int64_t)dInterval : std::max<int64_t>(1, (int64_t)xPoisson(xRandom)));
+                }
+            }
+
+        }
+    }
+
+    const double dSeconds = (NowNS() - nRecordTime) / 1e9;
+
+    //collect the requests in flight
+    const int64_t nDrainEnd = NowNS() + 1000000000LL;
+
+    while (NowNS() < nDrainEnd && IsAnyInFlight(xConns))
+    {
+        UpdateAll(xConns);
+    }
+
+    uint64_t nSendCount = 0;
+    uint64_t nRecvCount = 0;
+    uint64_t nRecvBytes = 0;
+
+    for (auto& pConn : xConns)
+    {
+        nSendCount += pConn->mnSendCount;
+        nRecvCount += pConn->mnRecvCount;
+        nRecvBytes += pConn->mnRecvBytes;
+    }
+
+    PrintResult(xConfig, xHistogram, nSendCount - nRecordSend, nRecvCount - nRecordRecv, nRecvBytes - nRecordBytes, dSeconds);
+
+    xConns.clear();
+    xServer.Stop();
+    return 0;
+}
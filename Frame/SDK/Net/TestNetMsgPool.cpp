@@ -0,0 +1,189 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+
+//Micro benchmark of the io thread -> logic thread message path.
+//legacy: new/delete every message, body copied into the message, one Pop per message
+//pooled: AFNetMsg::Create/Release, body referenced in place, bulk Pop
+//Not header only: AFNetMsg and AFNetMsgPool come with AFINet.h, which needs brynet. Built like the library, e.g.
+//g++ -O2 -std=c++11 -I../../ -I../../../Dep -I../../../Dep/brynet/src TestNetMsgPool.cpp -o TestNetMsgPool -L../../../Dep/lib/Release -lbrynet -lpthread
+
+#include "SDK/Core/AFPlatform.hpp"
+#include "AFINet.h"
+
+namespace
+{
+
+const size_t MSG_PER_THREAD = 2 * 1000 * 1000;
+const char MSG_BODY[32] = "0123456789abcdef0123456789abcde";
+
+struct LegacyMsg
+{
+    LegacyMsg(const brynet::net::TCPSession::PTR session_ptr) : nType(NONE), mxSession(session_ptr) {}
+
+    NetEventType nType;
+    AFGUID xClientID;
+    brynet::net::TCPSession::PTR mxSession;
+    std::string strMsg;
+    AFCMsgHead xHead;
+};
+
+double RunLegacy(size_t nThreadCount)
+{
+    std::vector<std::unique_ptr<moodycamel::BlockingReaderWriterQueue<LegacyMsg*>>> xQueues;
+
+    for (size_t i = 0; i < nThreadCount; ++i)
+    {
+        xQueues.emplace_back(new moodycamel::BlockingReaderWriterQueue<LegacyMsg*>());
+    }
+
+    auto tStart = std::chrono::steady_clock::now();
+    std::vector<std::thread> xThreads;
+
+    for (size_t i = 0; i < nThreadCount; ++i)
+    {
+        auto pQueue = xQueues[i].get();
+        xThreads.emplace_back([pQueue]()
+        {
+            for (size_t n = 0; n < MSG_PER_THREAD; ++n)
+            {
+                LegacyMsg* pMsg = new LegacyMsg(nullptr);
+                pMsg->nType = RECIVEDATA;
+                pMsg->strMsg.append(MSG_BODY, sizeof(MSG_BODY));
+                pQueue->enqueue(pMsg);
+            }
+        });
+    }
+
+    size_t nTotal = MSG_PER_THREAD * nThreadCount;
+    size_t nHandled = 0;
+    size_t nBytes = 0;
+
+    while (nHandled < nTotal)
+    {
+        for (auto& pQueue : xQueues)
+        {
+            size_t nCount = pQueue->size_approx();
+
+            for (size_t i = 0; i < nCount; ++i)
+            {
+                LegacyMsg* pMsg = nullptr;
+
+                if (!pQueue->try_dequeue(pMsg))
+                {
+                    break;
+                }
+
+                nBytes += pMsg->strMsg.size();
+                delete pMsg;
+                ++nHandled;
+            }
+        }
+    }
+
+    for (auto& xThread : xThreads)
+    {
+        xThread.join();
+    }
+
+    std::chrono::duration<double> tCost = std::chrono::steady_clock::now() - tStart;
+    return nBytes == nTotal * sizeof(MSG_BODY) ? nTotal / tCost.count() : 0.0;
+}
+
+double RunPooled(size_t nThreadCount)
+{
+    std::vector<std::unique_ptr<AFLockFreeQueue<AFTCPMsg*>>> xQueues;
+
+    for (size_t i = 0; i < nThreadCount; ++i)
+    {
+        xQueues.emplace_back(new AFLockFreeQueue<AFTCPMsg*>());
+    }
+
+    auto tStart = std::chrono::steady_clock::now();
+    std::vector<std::thread> xThreads;
+
+    for (size_t i = 0; i < nThreadCount; ++i)
+    {
+        auto pQueue = xQueues[i].get();
+        xThreads.emplace_back([pQueue]()
+        {
+            for (size_t n = 0; n < MSG_PER_THREAD; ++n)
+            {
+                AFTCPMsg* pMsg = AFTCPMsg::Create(nullptr);
+                pMsg->nType = RECIVEDATA;
+                pMsg->pData = MSG_BODY;
+                pMsg->nLen = sizeof(MSG_BODY);
+                pQueue->Push(pMsg);
+            }
+        });
+    }
+
+    size_t nTotal = MSG_PER_THREAD * nThreadCount;
+    size_t nHandled = 0;
+    size_t nBytes = 0;
+    AFTCPMsg* xMsgs[AFNetMsgPool<AFTCPMsg>::ARK_NET_MSG_BATCH];
+
+    while (nHandled < nTotal)
+    {
+        for (auto& pQueue : xQueues)
+        {
+            size_t nCount = 0;
+
+            while ((nCount = pQueue->Pop(xMsgs, AFNetMsgPool<AFTCPMsg>::ARK_NET_MSG_BATCH)) > 0)
+            {
+                for (size_t i = 0; i < nCount; ++i)
+                {
+                    nBytes += xMsgs[i]->nLen;
+                    AFTCPMsg::Release(xMsgs[i]);
+                }
+
+                nHandled += nCount;
+            }
+        }
+    }
+
+    for (auto& xThread : xThreads)
+    {
+        xThread.join();
+    }
+
+    std::chrono::duration<double> tCost = std::chrono::steady_clock::now() - tStart;
+    return nBytes == nTotal * sizeof(MSG_BODY) ? nTotal / tCost.count() : 0.0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t xThreadCounts[] = { 1, 4, 8 };
+
+    for (size_t nThreadCount : xThreadCounts)
+    {
+        double dLegacy = RunLegacy(nThreadCount);
+        double dPooled = RunPooled(nThreadCount);
+
+        std::cout << "io threads: " << nThreadCount
+                  << " legacy: " << (size_t)dLegacy << " msg/s"
+                  << " pooled: " << (size_t)dPooled << " msg/s"
+                  << " x" << (dLegacy > 0 ? dPooled / dLegacy : 0.0) << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+
+//Checks of the calls in flight of AFNetRpcCaller, exits with 1 when one fails.
+//Only needs the headers, e.g.
+//g++ -std=c++11 -I../../ TestNetRpc.cpp -o TestNetRpc
+
+#include "AFNetRpcCaller.hpp"
+
+namespace
+{
+
+int nFailed = 0;
+
+#define RPC_CHECK(expr) \
+    do \
+    { \
+        if (!(expr)) \
+        { \
+            std::cout << "failed: " << #expr << " line " << __LINE__ << std::endl; \
+            ++nFailed; \
+        } \
+    } while (0)
+
+//the status of every callback in the order they run
+struct CallLog
+{
+    NET_RPC_CALLBACK Make(const int nTag)
+    {
+        return [this, nTag](const int nStatus, const char* msg, const uint32_t nLen)
+        {
+            xTags.push_back(nTag);
+            xStatus.push_back(nStatus);
+        };
+    }
+
+    std::vector<int> xTags;
+    std::vector<int> xStatus;
+};
+
+void TestTimeoutOrder()
+{
+    AFNetRpcCaller xCaller;
+    CallLog xLog;
+
+    //added out of deadline order, two with the same deadline
+    xCaller.Add(1, 300, xLog.Make(3));
+    xCaller.Add(1, 100, xLog.Make(1));
+    xCaller.Add(2, 200, xLog.Make(2));
+    xCaller.Add(2, 200, xLog.Make(22));
+
+    xCaller.Update(99);
+    RPC_CHECK(xLog.xTags.empty());
+
+    xCaller.Update(200);
+    RPC_CHECK((xLog.xTags == std::vector<int> { 1, 2, 22 }));
+    RPC_CHECK(xCaller.GetCount() == 1);
+
+    xCaller.Update(1000);
+    RPC_CHECK((xLog.xTags == std::vector<int> { 1, 2, 22, 3 }));
+    RPC_CHECK(std::count(xLog.xStatus.begin(), xLog.xStatus.end(), (int)ARK_RPC_TIMEOUT) == 4);
+    RPC_CHECK(xCaller.GetCount() == 0);
+}
+
+void TestDisconnect()
+{
+    AFNetRpcCaller xCaller;
+    CallLog xLog;
+
+    xCaller.Add(1, 100, xLog.Make(1));
+    xCaller.Add(2, 100, xLog.Make(2));
+    xCaller.Add(1, 50, xLog.Make(11));
+
+    //only the calls of server 1, in the order they were sent
+    xCaller.OnDisconnect(1);
+    RPC_CHECK((xLog.xTags == std::vector<int> { 1, 11 }));
+    RPC_CHECK((xLog.xStatus == std::vector<int> { ARK_RPC_DISCONNECTED, ARK_RPC_DISCONNECTED }));
+    RPC_CHECK(xCaller.GetCount() == 1);
+
+    //their timers are gone too
+    xCaller.Update(60);
+    RPC_CHECK(xLog.xTags.size() == 2);
+    xCaller.Update(100);
+    RPC_CHECK((xLog.xTags == std::vector<int> { 1, 11, 2 }));
+}
+
+void TestLateResponse()
+{
+    AFNetRpcCaller xCaller;
+    CallLog xLog;
+
+    const uint64_t nTimeoutID = xCaller.Add(1, 100, xLog.Make(1));
+    const uint64_t nOtherID = xCaller.Add(1, 500, xLog.Make(2));
+
+    xCaller.Update(100);
+    RPC_CHECK((xLog.xStatus == std::vector<int> { ARK_RPC_TIMEOUT }));
+
+    //the response of a timed out call finds nothing
+    const char xBody[] = "body";
+    xCaller.OnResponse(1, nTimeoutID, ARK_RPC_OK, xBody, 4);
+    RPC_CHECK(xLog.xTags.size() == 1);
+
+    //a response from another server than the call went to is dropped
+    xCaller.OnResponse(2, nOtherID, ARK_RPC_OK, xBody, 4);
+    RPC_CHECK(xLog.xTags.size() == 1);
+    RPC_CHECK(xCaller.GetCount() == 1);
+
+    xCaller.OnResponse(1, nOtherID, ARK_RPC_OK, xBody, 4);
+    RPC_CHECK((xLog.xTags == std::vector<int> { 1, 2 }));
+    RPC_CHECK((xLog.xStatus == std::vector<int> { ARK_RPC_TIMEOUT, ARK_RPC_OK }));
+
+    //answered once only
+    xCaller.OnResponse(1, nOtherID, ARK_RPC_OK, xBody, 4);
+    RPC_CHECK(xLog.xTags.size() == 2);
+    RPC_CHECK(xCaller.GetCount() == 0);
+}
+
+void TestCallInCallBack()
+{
+    AFNetRpcCaller xCaller;
+    CallLog xLog;
+    uint64_t nRetryID = 0;
+
+    //a failed call starts its retry from the callback
+    xCaller.Add(1, 100, [&](const int nStatus, const char* msg, const uint32_t nLen)
+    {
+        xLog.xTags.push_back(1);
+        xLog.xStatus.push_back(nStatus);
+        nRetryID = xCaller.Add(1, 100, xLog.Make(2));
+    });
+
+    xCaller.OnDisconnect(1);
+    RPC_CHECK(nRetryID != 0);
+    RPC_CHECK(xCaller.GetCount() == 1);
+
+    //the new call has the deadline 100 too, it runs in the same Update as the one which started it
+    xCaller.Remove(nRetryID);
+    xCaller.Add(1, 100, [&](const int nStatus, const char* msg, const uint32_t nLen)
+    {
+        xLog.xTags.push_back(3);
+        xLog.xStatus.push_back(nStatus);
+        nRetryID = xCaller.Add(1, 100, xLog.Make(4));
+    });
+
+    xCaller.Update(100);
+    RPC_CHECK((xLog.xTags == std::vector<int> { 1, 3, 4 }));
+    RPC_CHECK((xLog.xStatus == std::vector<int> { ARK_RPC_DISCONNECTED, ARK_RPC_TIMEOUT, ARK_RPC_TIMEOUT }));
+    RPC_CHECK(xCaller.GetCount() == 0);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    TestTimeoutOrder();
+    TestDisconnect();
+    TestLateResponse();
+    TestCallInCallBack();
+
+    std::cout << (nFailed == 0 ? "all passed" : "some failed") << std::endl;
+    return (nFailed == 0 ? 0 : 1);
+}
@@ -0,0 +1,212 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+
+//Checks of the handles of AFNetSlotMap, exits with 1 when one fails.
+//Only needs the headers, e.g.
+//g++ -std=c++11 -I../../ TestNetSlotMap.cpp -o TestNetSlotMap -lpthread
+
+#include <thread>
+#include <vector>
+#include "AFNetSlotMap.hpp"
+
+namespace
+{
+
+int nFailed = 0;
+
+#define SLOT_CHECK(expr) \
+    do \
+    { \
+        if (!(expr)) \
+        { \
+            std::cout << "failed: " << #expr << " line " << __LINE__ << std::endl; \
+            ++nFailed; \
+        } \
+    } while (0)
+
+using SlotMap = AFNetSlotMap<int>;
+
+void TestGenerationReuse()
+{
+    SlotMap xSlots;
+    int xData[3] = { 1, 2, 3 };
+
+    const uint64_t nFirst = xSlots.Add(&xData[0]);
+    const uint64_t nSecond = xSlots.Add(&xData[1]);
+    SLOT_CHECK(nFirst != 0 && nSecond != 0 && nFirst != nSecond);
+    SLOT_CHECK(xSlots.Get(nFirst) == &xData[0]);
+    SLOT_CHECK(xSlots.Count() == 2);
+
+    //the freed slot is used again with a new generation
+    SLOT_CHECK(xSlots.Remove(nFirst) == &xData[0]);
+    const uint64_t nThird = xSlots.Add(&xData[2]);
+    SLOT_CHECK(SlotMap::GetIndex(nThird) == SlotMap::GetIndex(nFirst));
+    SLOT_CHECK(SlotMap::GetGeneration(nThird) != SlotMap::GetGeneration(nFirst));
+    SLOT_CHECK(nThird != 0 && nThird != nFirst);
+    SLOT_CHECK(xSlots.Get(nThird) == &xData[2]);
+    SLOT_CHECK(xSlots.Count() == 2);
+
+    //the handle is known before the object can be found
+    uint64_t nInitHandle = 0;
+    const uint64_t nFourth = xSlots.Add(&xData[0], [&](const uint64_t nHandle)
+    {
+        nInitHandle = nHandle;
+        SLOT_CHECK(xSlots.Get(nHandle) == nullptr);
+    });
+    SLOT_CHECK(nInitHandle == nFourth);
+    SLOT_CHECK(xSlots.Get(nFourth) == &xData[0]);
+}
+
+void TestStaleHandle()
+{
+    SlotMap xSlots;
+    int nData = 0;
+
+    const uint64_t nHandle = xSlots.Add(&nData);
+    SLOT_CHECK(xSlots.Remove(nHandle) == &nData);
+
+    //a closed connection is not found, and its id does not remove the new object of the slot
+    SLOT_CHECK(xSlots.Get(nHandle) == nullptr);
+    SLOT_CHECK(xSlots.Remove(nHandle) == nullptr);
+
+    const uint64_t nNewHandle = xSlots.Add(&nData);
+    SLOT_CHECK(xSlots.Get(nHandle) == nullptr);
+    SLOT_CHECK(xSlots.Remove(nHandle) == nullptr);
+    SLOT_CHECK(xSlots.Get(nNewHandle) == &nData);
+
+    //handles never added
+    SLOT_CHECK(xSlots.Get(0) == nullptr);
+    SLOT_CHECK(xSlots.Get(SlotMap::MakeHandle(100, 1)) == nullptr);
+    SLOT_CHECK(xSlots.Remove(SlotMap::MakeHandle(100, 1)) == nullptr);
+
+    //ForEach and Clear see the live objects only
+    size_t nVisit = 0;
+    xSlots.ForEach([&](int* pData)
+    {
+        ++nVisit;
+    });
+    SLOT_CHECK(nVisit == 1);
+
+    xSlots.Clear();
+    SLOT_CHECK(xSlots.Count() == 0);
+    SLOT_CHECK(xSlots.Get(nNewHandle) == nullptr);
+}
+
+void TestFull()
+{
+    std::unique_ptr<SlotMap> pSlots(new SlotMap());
+    int nData = 0;
+    const size_t nMax = (size_t)SlotMap::ARK_SLOT_MAX_PAGE * SlotMap::ARK_SLOT_PAGE_SIZE;
+    uint64_t nLast = 0;
+    bool bAllAdded = true;
+
+    for (size_t i = 0; i < nMax; ++i)
+    {
+        nLast = pSlots->Add(&nData);
+        bAllAdded = (bAllAdded && nLast != 0);
+    }
+
+    SLOT_CHECK(bAllAdded);
+    SLOT_CHECK(pSlots->Count() == nMax);
+
+    //no slot left
+    SLOT_CHECK(pSlots->Add(&nData) == 0);
+    SLOT_CHECK(pSlots->Count() == nMax);
+
+    //one freed slot can be added again, then the map is full again
+    SLOT_CHECK(pSlots->Remove(nLast) == &nData);
+    const uint64_t nAgain = pSlots->Add(&nData);
+    SLOT_CHECK(nAgain != 0 && nAgain != nLast);
+    SLOT_CHECK(pSlots->Add(&nData) == 0);
+}
+
+//one thread removes and adds again on the same slot, another one looks up the old handles meanwhile
+void TestStaleHandleRace()
+{
+    struct Conn
+    {
+        uint64_t nHandle{ 0 }; //set before the object can be found, never changed then
+    };
+
+    const size_t nRounds = 1000 * 1000;
+    std::vector<Conn> xConns(nRounds + 1);
+    SlotMap xSlots;
+    std::atomic<uint64_t> nLatest(0);
+    std::atomic<bool> bDone(false);
+    std::atomic<size_t> nWrong(0);
+
+    auto AddConn = [&](Conn & xConn)
+    {
+        return xSlots.Add(reinterpret_cast<int*>(&xConn), [&xConn](const uint64_t nHandle)
+        {
+            xConn.nHandle = nHandle;
+        });
+    };
+
+    nLatest = AddConn(xConns[0]);
+
+    std::thread xReader([&]()
+    {
+        uint64_t nOld = nLatest.load();
+
+        while (!bDone.load())
+        {
+            const uint64_t nHandle = nLatest.load();
+
+            for (const uint64_t nQuery : { nHandle, nOld })
+            {
+                const Conn* pConn = reinterpret_cast<const Conn*>(xSlots.Get(nQuery));
+
+                if (pConn != nullptr && pConn->nHandle != nQuery)
+                {
+                    ++nWrong;
+                }
+            }
+
+            nOld = nHandle;
+        }
+    });
+
+    for (size_t i = 1; i <= nRounds; ++i)
+    {
+        xSlots.Remove(nLatest.load());
+        nLatest = AddConn(xConns[i]);
+    }
+
+    bDone = true;
+    xReader.join();
+
+    SLOT_CHECK(nWrong == 0);
+    SLOT_CHECK(xSlots.Count() == 1);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    TestGenerationReuse();
+    TestStaleHandle();
+    TestFull();
+    TestStaleHandleRace();
+
+    std::cout << (nFailed == 0 ? "all passed" : "some failed") << std::endl;
+    return (nFailed == 0 ? 0 : 1);
+}
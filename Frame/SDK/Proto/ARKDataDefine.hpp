@@ -2703,6 +2703,16 @@ public:
         static std::string xType = "Type";    //int
         return xType;
     }
+    static const std::string& CompactHead()
+    {
+        static std::string xCompactHead = "CompactHead";    //bool
+        return xCompactHead;
+    }
+    static const std::string& Transport()
+    {
+        static std::string xTransport = "Transport";    //string
+        return xTransport;
+    }
     //DataTables
 
 };
@@ -41,21 +41,21 @@ bool AFCGameNetServerModule::PostInit()
     m_pGameServerToWorldModule = pPluginManager->FindModule<AFIGameServerToWorldModule>();
     m_AccountModule = pPluginManager->FindModule<AFIAccountModule>();
 
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_PTWG_PROXY_REFRESH, this, &AFCGameNetServerModule::OnRefreshProxyServerInfoProcess);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_PTWG_PROXY_REGISTERED, this, &AFCGameNetServerModule::OnProxyServerRegisteredProcess);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_PTWG_PROXY_UNREGISTERED, this, &AFCGameNetServerModule::OnProxyServerUnRegisteredProcess);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_REQ_ENTER_GAME, this, &AFCGameNetServerModule::OnClienEnterGameProcess);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_REQ_LEAVE_GAME, this, &AFCGameNetServerModule::OnClientLeaveGameProcess);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_REQ_ROLE_LIST, this, &AFCGameNetServerModule::OnReqiureRoleListProcess);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_REQ_CREATE_ROLE, this, &AFCGameNetServerModule::OnCreateRoleGameProcess);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_REQ_DELETE_ROLE, this, &AFCGameNetServerModule::OnDeleteRoleGameProcess);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_REQ_RECOVER_ROLE, this, &AFCGameNetServerModule::OnClienSwapSceneProcess);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_REQ_SWAP_SCENE, this, &AFCGameNetServerModule::OnClienSwapSceneProcess);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGMI_REQ_SEARCH_GUILD, this, &AFCGameNetServerModule::OnTransWorld);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGEC_REQ_CREATE_CHATGROUP, this, &AFCGameNetServerModule::OnTransWorld);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGEC_REQ_JOIN_CHATGROUP, this, &AFCGameNetServerModule::OnTransWorld);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGEC_REQ_LEAVE_CHATGROUP, this, &AFCGameNetServerModule::OnTransWorld);
-    m_pNetModule->AddReceiveCallBack(AFMsg::EGEC_REQ_SUBSCRIPTION_CHATGROUP, this, &AFCGameNetServerModule::OnTransWorld);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnRefreshProxyServerInfoProcess>(AFMsg::EGMI_PTWG_PROXY_REFRESH, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnProxyServerRegisteredProcess>(AFMsg::EGMI_PTWG_PROXY_REGISTERED, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnProxyServerUnRegisteredProcess>(AFMsg::EGMI_PTWG_PROXY_UNREGISTERED, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnClienEnterGameProcess>(AFMsg::EGMI_REQ_ENTER_GAME, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnClientLeaveGameProcess>(AFMsg::EGMI_REQ_LEAVE_GAME, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnReqiureRoleListProcess>(AFMsg::EGMI_REQ_ROLE_LIST, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnCreateRoleGameProcess>(AFMsg::EGMI_REQ_CREATE_ROLE, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnDeleteRoleGameProcess>(AFMsg::EGMI_REQ_DELETE_ROLE, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnClienSwapSceneProcess>(AFMsg::EGMI_REQ_RECOVER_ROLE, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnClienSwapSceneProcess>(AFMsg::EGMI_REQ_SWAP_SCENE, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnTransWorld>(AFMsg::EGMI_REQ_SEARCH_GUILD, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnTransWorld>(AFMsg::EGEC_REQ_CREATE_CHATGROUP, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnTransWorld>(AFMsg::EGEC_REQ_JOIN_CHATGROUP, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnTransWorld>(AFMsg::EGEC_REQ_LEAVE_CHATGROUP, this);
+    m_pNetModule->AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnTransWorld>(AFMsg::EGEC_REQ_SUBSCRIPTION_CHATGROUP, this);
 
     m_pNetModule->AddEventCallBack(this, &AFCGameNetServerModule::OnSocketPSEvent);
 
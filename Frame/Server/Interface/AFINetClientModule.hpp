@@ -26,14 +26,16 @@
 #include "SDK/Net/AFCNetClient.h"
 #include "SDK/Interface/AFIModule.h"
 #include "Server/Interface/AFINetModule.h"
+#include "Server/Interface/AFNetRpc.hpp"
 
 
+//CONNECTING and RECONNECT are kept until the net client is connected, it tries again with backoff by itself
 enum ConnectDataState
 {
-    DISCONNECT,
-    CONNECTING,
+    DISCONNECT,     //no net client
+    CONNECTING,     //never connected yet
     NORMAL,
-    RECONNECT,
+    RECONNECT,      //link lost, reconnecting
 };
 
 class ConnectData
@@ -44,6 +46,7 @@ public:
     }
 
     int nGameID{ 0 };
+    int nBusID{ 0 }; //bus id of the server when AFIBusModule reaches it by this client, 0 for none
     ARK_PROCESS_TYPE eServerType{ ARK_PROC_NONE };
     std::string strIP{ "" };
     int nPort{ 0 };
@@ -61,12 +64,14 @@ public:
     enum EConstDefine
     {
         EConstDefine_DefaultWeith = 500,
+        ARK_RPC_DEFAULT_TIMEOUT = 5000, //ms
     };
 
     AFINetClientModule() = delete;
     explicit AFINetClientModule(AFIPluginManager* p)
     {
         pPluginManager = p;
+        AddReceiveCallBack<AFINetClientModule, &AFINetClientModule::OnRpcResponse>(AFNetRpcHead::ARK_RPC_MSG_RESPONSE, this);
     }
 
     virtual bool Init()
@@ -102,7 +107,10 @@ public:
     virtual bool Update()
     {
         ProcessExecute();
+        mxRpcCaller.Update(AFNetRpcCaller::GetTime());
         ProcessAddNetConnect();
+        //the messages decoded in this update are not used any more
+        AFNetMsgArena::Reset();
         return true;
     }
 
@@ -132,6 +140,43 @@ public:
             }
         }
     }
+
+    //send to the server added with this bus id, false when there is no connected server for it
+    bool SendByBusID(const int nBusID, const int nMsgID, const char* msg, const uint32_t nLen, const AFGUID& nPlayerID)
+    {
+        auto iter = mxBusServerIDs.find(nBusID);
+
+        if (iter == mxBusServerIDs.end())
+        {
+            return false;
+        }
+
+        ARK_SHARE_PTR<ConnectData> pServer = mxServerMap.GetElement(iter->second);
+
+        if (pServer == nullptr || pServer->mxNetModule == nullptr || pServer->eState != ConnectDataState::NORMAL)
+        {
+            return false;
+        }
+
+        return pServer->mxNetModule->SendMsgWithOutHead(nMsgID, msg, nLen, 0, nPlayerID);
+    }
+
+    //forward a received frame as it is, see AFINet::SendMsgFrame
+    void SendFrameByServerID(const int nServerID, const AFIMsgHead& xHead, const char* msg, const uint32_t nLen, const AFGUID& nPlayerID)
+    {
+        ARK_SHARE_PTR<ConnectData> pServer = mxServerMap.GetElement(nServerID);
+
+        if (pServer)
+        {
+            ARK_SHARE_PTR<AFCNetClient> pNetModule = pServer->mxNetModule;
+
+            if (pNetModule.get())
+            {
+                pNetModule->SendMsgFrame(xHead, msg, nLen, 0, nPlayerID);
+            }
+        }
+    }
+
     //裸数据,发时组包
     void SendToAllServer(const int nMsgID, const std::string& strData, const AFGUID& nPlayerID)
     {
@@ -151,14 +196,6 @@ public:
     }
     void SendToServerByPB(const int nServerID, const uint16_t nMsgID, google::protobuf::Message& xData, const AFGUID& nPlayerID)
     {
-        std::string strData;
-
-        if (!PackMsgToBasePB(xData, nPlayerID, strData))
-        {
-            //add log
-            return;
-        }
-
         ARK_SHARE_PTR<ConnectData> pServer = mxServerMap.GetElement(nServerID);
 
         if (pServer)
@@ -167,20 +204,15 @@ public:
 
             if (pNetModule.get())
             {
-                pNetModule->SendMsgWithOutHead(nMsgID, strData.data(), strData.length(), AFGUID(0), nPlayerID);
+                pNetModule->SendMsgPacket(AFINetModule::EnCodePB(nMsgID, xData, nPlayerID), AFGUID(0));
             }
         }
     }
 
     void SendToAllServerByPB(const uint16_t nMsgID, google::protobuf::Message& xData, const AFGUID& nPlayerID)
     {
-        std::string strData;
-
-        if (!PackMsgToBasePB(xData, nPlayerID, strData))
-        {
-            //add log
-            return;
-        }
+        //encoded once, every server queues the same packet
+        brynet::net::DataSocket::PACKET_PTR xPacket = AFINetModule::EnCodePB(nMsgID, xData, nPlayerID);
 
         ARK_SHARE_PTR<ConnectData> pServer = mxServerMap.First();
 
@@ -190,7 +222,7 @@ public:
 
             if (pNetModule.get())
             {
-                pNetModule->SendMsgWithOutHead(nMsgID, strData.data(), strData.length(), AFGUID(0), nPlayerID);
+                pNetModule->SendMsgPacket(xPacket, AFGUID(0));
             }
 
             pServer = mxServerMap.Next();
@@ -254,6 +286,68 @@ public:
         SendToServerByPB(xNode.nMachineID, nMsgID, xData, nPlayerID);
     }
 
+    //Call nMethodID of the server, the callback runs in a later Update of this module with the response,
+    //or with the error when the call times out after nTimeout ms or the link is lost.
+    //Any number of calls can be in flight. False when the server is not connected, then the callback is not called.
+    bool CallByServerID(const int nServerID, const uint16_t nMethodID, const google::protobuf::Message& xData, const AFGUID& nPlayerID, const NET_RPC_CALLBACK& xCallBack, const int64_t nTimeout = ARK_RPC_DEFAULT_TIMEOUT)
+    {
+        ARK_SHARE_PTR<ConnectData> pServer = mxServerMap.GetElement(nServerID);
+
+        if (pServer == nullptr || pServer->mxNetModule == nullptr || pServer->eState != ConnectDataState::NORMAL)
+        {
+            return false;
+        }
+
+        AFNetRpcHead xRpcHead;
+        xRpcHead.nCallID = mxRpcCaller.Add(nServerID, AFNetRpcCaller::GetTime() + nTimeout, xCallBack);
+        xRpcHead.nMethodID = nMethodID;
+
+        if (!pServer->mxNetModule->SendMsgPacket(AFNetRpcHead::EnCodePB(AFNetRpcHead::ARK_RPC_MSG_REQUEST, xRpcHead, &xData, nPlayerID), AFGUID(0)))
+        {
+            mxRpcCaller.Remove(xRpcHead.nCallID);
+            return false;
+        }
+
+        return true;
+    }
+
+    //the response is parsed into the net arena, pData is nullptr unless nStatus is ARK_RPC_OK, e.g.
+    //CallByServerID<AFMsg::AckRoleList>(nGameID, AFMsg::EGMI_REQ_ROLE_LIST, xReq, nPlayerID, [](const int nStatus, const AFMsg::AckRoleList* pData) {});
+    template<typename MsgType>
+    bool CallByServerID(const int nServerID, const uint16_t nMethodID, const google::protobuf::Message& xData, const AFGUID& nPlayerID, const std::function<void(const int, const MsgType*)>& xCallBack, const int64_t nTimeout = ARK_RPC_DEFAULT_TIMEOUT)
+    {
+        return CallByServerID(nServerID, nMethodID, xData, nPlayerID, [xCallBack](const int nStatus, const char* msg, const uint32_t nLen)
+        {
+            if (nStatus != ARK_RPC_OK)
+            {
+                xCallBack(nStatus, nullptr);
+                return;
+            }
+
+            const MsgType* pData = AFNetRpcHead::ParsePB<MsgType>(msg, nLen);
+            xCallBack(pData != nullptr ? ARK_RPC_OK : ARK_RPC_BAD_MESSAGE, pData);
+        }, nTimeout);
+    }
+
+    template<typename MsgType>
+    bool CallBySuit(const int& nHashKey, const uint16_t nMethodID, const google::protobuf::Message& xData, const AFGUID& nPlayerID, const std::function<void(const int, const MsgType*)>& xCallBack, const int64_t nTimeout = ARK_RPC_DEFAULT_TIMEOUT)
+    {
+        AFCMachineNode xNode;
+
+        if (mxConsistentHash.Size() <= 0 || !GetServerMachineData(ARK_LEXICAL_CAST<std::string>(nHashKey), xNode))
+        {
+            return false;
+        }
+
+        return CallByServerID<MsgType>(xNode.nMachineID, nMethodID, xData, nPlayerID, xCallBack, nTimeout);
+    }
+
+    //calls in flight
+    size_t GetRpcCount() const
+    {
+        return mxRpcCaller.GetCount();
+    }
+
     ARK_SHARE_PTR<ConnectData> GetServerNetInfo(const int nServerID)
     {
         return mxServerMap.GetElement(nServerID);
@@ -283,59 +377,15 @@ protected:
         {
             const auto& pServerData = mxServerMap.GetCurrentData();
 
-            switch (pServerData->eState)
+            //the connect and the reconnect go on in the net client, Update never waits for them
+            if (pServerData->mxNetModule != nullptr)
             {
-            case ConnectDataState::DISCONNECT:
-                {
-                    if (pServerData->mxNetModule != nullptr)
-                    {
-                        pServerData->mxNetModule = nullptr;
-                        pServerData->eState = ConnectDataState::RECONNECT;
-                    }
-                }
-                break;
-
-            case ConnectDataState::CONNECTING:
-                {
-                    if (pServerData->mxNetModule)
-                    {
-                        pServerData->mxNetModule->Update();
-                    }
-                }
-                break;
+                pServerData->mxNetModule->Update();
 
-            case ConnectDataState::NORMAL:
+                if (pServerData->eState == ConnectDataState::NORMAL)
                 {
-                    if (pServerData->mxNetModule)
-                    {
-                        pServerData->mxNetModule->Update();
-
-                        KeepState(pServerData.get());
-                    }
-                }
-                break;
-
-            case ConnectDataState::RECONNECT:
-                {
-                    //计算时间
-                    if ((pServerData->mnLastActionTime + 30 * AFTimespan::SECOND_MS) >= GetPluginManager()->GetNowTime())
-                    {
-                        break;
-                    }
-
-                    if (nullptr != pServerData->mxNetModule)
-                    {
-                        pServerData->mxNetModule = nullptr;
-                    }
-
-                    pServerData->eState = ConnectDataState::CONNECTING;
-                    pServerData->mxNetModule = std::make_shared<AFCNetClient>(this, &AFINetClientModule::OnReceiveNetPack, &AFINetClientModule::OnSocketNetEvent);
-                    pServerData->mxNetModule->Start(pServerData->strIPAndPort, pServerData->nGameID);
+                    KeepState(pServerData.get());
                 }
-                break;
-
-            default:
-                break;
             }
 
             bRet = mxServerMap.Increase();
@@ -399,10 +449,12 @@ private:
         if (nullptr != pServerInfo)
         {
             RemoveServerWeightData(pServerInfo);
-            pServerInfo->eState = ConnectDataState::DISCONNECT;
+            pServerInfo->eState = ConnectDataState::RECONNECT;
             pServerInfo->mnLastActionTime = GetPluginManager()->GetNowTime();
         }
 
+        mxRpcCaller.OnDisconnect(nServerID);
+
         return 0;
     }
 
@@ -421,6 +473,7 @@ private:
                 xServerData = ARK_SHARE_PTR<ConnectData>(ARK_NEW ConnectData());
 
                 xServerData->nGameID = xInfo.nGameID;
+                xServerData->nBusID = xInfo.nBusID;
                 xServerData->eServerType = xInfo.eServerType;
                 xServerData->strIP = xInfo.strIP;
 
@@ -441,13 +494,17 @@ private:
                 xServerData->mnLastActionTime = GetPluginManager()->GetNowTime();
 
                 xServerData->mxNetModule = std::make_shared<AFCNetClient>(this, &AFINetClientModule::OnReceiveNetPack, &AFINetClientModule::OnSocketNetEvent);
-
+                xServerData->mxNetModule->SetReconnect(true);
                 xServerData->mxNetModule->Start(xServerData->strIPAndPort, xServerData->nGameID);
 
                 if (!mxServerMap.AddElement(xInfo.nGameID, xServerData))
                 {
                     //add log
                 }
+                else if (xInfo.nBusID != 0)
+                {
+                    mxBusServerIDs[xInfo.nBusID] = xInfo.nGameID;
+                }
             }
         }
 
@@ -489,6 +546,19 @@ private:
         }
     }
 
+    void OnRpcResponse(const AFIMsgHead& xHead, const int nMsgID, const char* msg, const uint32_t nLen, const AFGUID& xClientID)
+    {
+        AFNetRpcHead xRpcHead;
+
+        if (!xRpcHead.DeCode(msg, nLen))
+        {
+            return;
+        }
+
+        //the link id of AFCNetClient carries the server id
+        mxRpcCaller.OnResponse((int)xClientID.nHigh, xRpcHead.nCallID, xRpcHead.nStatus, msg + AFNetRpcHead::ARK_RPC_HEAD_LENGTH, nLen - AFNetRpcHead::ARK_RPC_HEAD_LENGTH);
+    }
+
 protected:
     void OnReceiveNetPack(const AFIMsgHead& xHead, const int nMsgID, const char* msg, const size_t nLen, const AFGUID& xClientID)
     {
@@ -511,7 +581,10 @@ protected:
 
 private:
     AFMapEx<int, ConnectData> mxServerMap;
+    //bus id -> server id, of the servers added with a bus id
+    std::unordered_map<int, int> mxBusServerIDs;
     AFCConsistentHash mxConsistentHash;
 
     std::list<ConnectData> mxTempNetList;
+    AFNetRpcCaller mxRpcCaller;
 };
\ No newline at end of file
@@ -25,9 +25,59 @@
 #include "SDK/Net/AFCNetServer.h"
 #include "SDK/Proto/AFProtoCPP.hpp"
 #include "Server/Interface/AFApp.hpp"
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+//Per thread arena of the received protobuf messages.
+//A message decoded by ReceivePB<MsgType> lives until the end of the net update that dispatched it.
+class AFNetMsgArena
+{
+public:
+    enum
+    {
+        ARK_ARENA_INIT_BLOCK = 64 * 1024,
+        ARK_ARENA_MAX_BLOCK = 1024 * 1024,
+    };
+
+    template<typename MsgType>
+    static MsgType* CreateMsg()
+    {
+        return google::protobuf::Arena::CreateMessage<MsgType>(&Instance().mxArena);
+    }
+
+    //called at the end of every net update, the initial block is kept and reused
+    static void Reset()
+    {
+        Instance().mxArena.Reset();
+    }
+
+private:
+    AFNetMsgArena() : mxBlock(new char[ARK_ARENA_INIT_BLOCK]), mxArena(GetOptions(mxBlock.get())) {}
+
+    static google::protobuf::ArenaOptions GetOptions(char* pBlock)
+    {
+        google::protobuf::ArenaOptions xOptions;
+        xOptions.initial_block = pBlock;
+        xOptions.initial_block_size = ARK_ARENA_INIT_BLOCK;
+        xOptions.start_block_size = ARK_ARENA_INIT_BLOCK;
+        xOptions.max_block_size = ARK_ARENA_MAX_BLOCK;
+        return xOptions;
+    }
+
+    static AFNetMsgArena& Instance()
+    {
+        static thread_local AFNetMsgArena xArena;
+        return xArena;
+    }
+
+    std::unique_ptr<char[]> mxBlock;
+    google::protobuf::Arena mxArena;
+};
 
 class AFINetModule : public AFIModule
 {
+public:
+    typedef void(*NET_RECEIVE_THUNK)(void* pObject, const AFIMsgHead& xHead, const int nMsgID, const char* msg, const uint32_t nLen, const AFGUID& xClientID);
 
 protected:
     AFINetModule() {}
@@ -37,6 +87,14 @@ public:
     {
     }
 
+    //handler known at compile time, called without std::function and std::bind, e.g.
+    //AddReceiveCallBack<AFCGameNetServerModule, &AFCGameNetServerModule::OnClienEnterGameProcess>(AFMsg::EGMI_REQ_ENTER_GAME, this);
+    template<typename BaseType, void (BaseType::*handleRecieve)(const AFIMsgHead& xHead, const int, const char*, const uint32_t, const AFGUID&)>
+    bool AddReceiveCallBack(const int nMsgID, BaseType* pBase)
+    {
+        return AddReceiveHandler(nMsgID, pBase, &AFINetModule::CallMemberHandler<BaseType, handleRecieve>);
+    }
+
     template<typename BaseType>
     bool AddReceiveCallBack(const int nMsgID, BaseType* pBase, void (BaseType::*handleRecieve)(const AFIMsgHead& xHead, const int, const char*, const uint32_t, const AFGUID&))
     {
@@ -57,15 +115,14 @@ public:
 
     virtual bool AddReceiveCallBack(const int nMsgID, const NET_RECEIVE_FUNCTOR_PTR& cb)
     {
-        if (mxReceiveCallBack.find(nMsgID) != mxReceiveCallBack.end())
+        if (cb == nullptr || !AddReceiveHandler(nMsgID, cb.get(), &AFINetModule::CallFunctorHandler))
         {
             return false;
         }
-        else
-        {
-            mxReceiveCallBack.insert(std::make_pair(nMsgID, cb));
-            return true;
-        }
+
+        //keep the functor alive, the dispatch table only holds a raw pointer
+        mxReceiveCallBack.insert(std::make_pair(nMsgID, cb));
+        return true;
     }
 
     virtual bool AddReceiveCallBack(const NET_RECEIVE_FUNCTOR_PTR& cb)
@@ -100,7 +157,7 @@ public:
 
     static bool ReceivePB(const AFIMsgHead& xHead, const char* msg, const uint32_t nLen, google::protobuf::Message& xData, AFGUID& nPlayer)
     {
-        if (!xData.ParseFromString(std::string(msg, nLen)))
+        if (!xData.ParseFromArray(msg, (int)nLen))
         {
             //char szData[MAX_PATH] = { 0 };
             //log
@@ -112,6 +169,80 @@ public:
         return true;
     }
 
+    //parse from the received buffer into the net arena, nothing to free
+    template<typename MsgType>
+    static MsgType* ReceivePB(const AFIMsgHead& xHead, const char* msg, const uint32_t nLen, AFGUID& nPlayer)
+    {
+        MsgType* pData = AFNetMsgArena::CreateMsg<MsgType>();
+
+        if (!pData->ParseFromArray(msg, (int)nLen))
+        {
+            return nullptr;
+        }
+
+        nPlayer = xHead.GetPlayerID();
+        return pData;
+    }
+
+    //head and body in one pooled packet, the message is serialized into the packet directly
+    static brynet::net::DataSocket::PACKET_PTR EnCodePB(const uint16_t nMsgID, const google::protobuf::Message& xData, const AFGUID& xPlayerID)
+    {
+        const size_t nBodyLen = xData.ByteSizeLong();
+
+        AFCMsgHead xHead;
+        xHead.SetMsgID(nMsgID);
+        xHead.SetPlayerID(xPlayerID);
+        xHead.SetBodyLength(nBodyLen);
+
+        brynet::net::DataSocket::PACKET_PTR xPacket = AFNetPacketPool::GetInstance().Alloc(AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen);
+        xPacket->resize(AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen);
+
+        uint8_t* pData = reinterpret_cast<uint8_t*>(&(*xPacket)[0]);
+        xHead.EnCode(reinterpret_cast<char*>(pData));
+        xData.SerializeWithCachedSizesToArray(pData + AFIMsgHead::ARK_MSG_HEAD_LENGTH);
+
+        return xPacket;
+    }
+
+    //a BrocastMsg with xData as msg_data, the msg_data field is written in place after the other fields
+    static brynet::net::DataSocket::PACKET_PTR EnCodeBrocastPB(const uint16_t nMsgID, const google::protobuf::Message& xData, const AFGUID& xPlayerID, const std::vector<AFGUID>& xClientIDList)
+    {
+        using google::protobuf::io::CodedOutputStream;
+        using google::protobuf::internal::WireFormatLite;
+
+        //playerid is used by gate to forward the message only
+        AFMsg::BrocastMsg xMsg;
+        *xMsg.mutable_entity_id() = GUIDToPB(xPlayerID);
+        xMsg.set_msg_id(nMsgID);
+
+        for (const auto& xClientID : xClientIDList)
+        {
+            *xMsg.add_target_entity_list() = GUIDToPB(xClientID);
+        }
+
+        const uint32_t nTag = WireFormatLite::MakeTag(AFMsg::BrocastMsg::kMsgDataFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+        const size_t nDataLen = xData.ByteSizeLong();
+        const size_t nWrapLen = xMsg.ByteSizeLong();
+        const size_t nBodyLen = nWrapLen + CodedOutputStream::VarintSize32(nTag) + CodedOutputStream::VarintSize32((uint32_t)nDataLen) + nDataLen;
+
+        AFCMsgHead xHead;
+        xHead.SetMsgID(AFMsg::EGMI_GTG_BROCASTMSG);
+        xHead.SetPlayerID(xPlayerID);
+        xHead.SetBodyLength(nBodyLen);
+
+        brynet::net::DataSocket::PACKET_PTR xPacket = AFNetPacketPool::GetInstance().Alloc(AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen);
+        xPacket->resize(AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen);
+
+        uint8_t* pData = reinterpret_cast<uint8_t*>(&(*xPacket)[0]);
+        xHead.EnCode(reinterpret_cast<char*>(pData));
+        pData = xMsg.SerializeWithCachedSizesToArray(pData + AFIMsgHead::ARK_MSG_HEAD_LENGTH);
+        pData = CodedOutputStream::WriteTagToArray(nTag, pData);
+        pData = CodedOutputStream::WriteVarint32ToArray((uint32_t)nDataLen, pData);
+        xData.SerializeWithCachedSizesToArray(pData);
+
+        return xPacket;
+    }
+
     static AFGUID PBToGUID(AFMsg::PBGUID xID)
     {
         AFGUID xIdent;
@@ -259,15 +390,15 @@ public:
 protected:
     void OnReceiveBaseNetPack(const AFIMsgHead& xHead, const int nMsgID, const char* msg, const uint32_t nLen, const AFGUID& xClientID)
     {
-        auto it = mxReceiveCallBack.find(nMsgID);
+        const NetReceiveHandler* pHandler = GetReceiveHandler(nMsgID);
 
-        if (mxReceiveCallBack.end() != it)
+        if (pHandler != nullptr)
         {
-            (*it->second)(xHead, nMsgID, msg, nLen, xClientID);
+            pHandler->pThunk(pHandler->pObject, xHead, nMsgID, msg, nLen, xClientID);
         }
         else
         {
-            for (auto iter : mxCallBackList)
+            for (auto& iter : mxCallBackList)
             {
                 (*iter)(xHead, nMsgID, msg, nLen, xClientID);
             }
@@ -283,19 +414,85 @@ protected:
     }
 
 private:
+    //msg id is uint16_t, the dispatch table is 256 pages of 256 handlers, a page is allocated when the first handler in it is added
+    enum
+    {
+        ARK_NET_DISPATCH_PAGE_BITS = 8,
+        ARK_NET_DISPATCH_PAGE_SIZE = 1 << ARK_NET_DISPATCH_PAGE_BITS,
+        ARK_NET_DISPATCH_PAGE_COUNT = 0x10000 >> ARK_NET_DISPATCH_PAGE_BITS,
+    };
+
+    struct NetReceiveHandler
+    {
+        void* pObject{ nullptr };
+        NET_RECEIVE_THUNK pThunk{ nullptr };
+    };
+
+    template<typename BaseType, void (BaseType::*handleRecieve)(const AFIMsgHead& xHead, const int, const char*, const uint32_t, const AFGUID&)>
+    static void CallMemberHandler(void* pObject, const AFIMsgHead& xHead, const int nMsgID, const char* msg, const uint32_t nLen, const AFGUID& xClientID)
+    {
+        (static_cast<BaseType*>(pObject)->*handleRecieve)(xHead, nMsgID, msg, nLen, xClientID);
+    }
+
+    static void CallFunctorHandler(void* pObject, const AFIMsgHead& xHead, const int nMsgID, const char* msg, const uint32_t nLen, const AFGUID& xClientID)
+    {
+        (*static_cast<NET_RECEIVE_FUNCTOR*>(pObject))(xHead, nMsgID, msg, nLen, xClientID);
+    }
+
+    bool AddReceiveHandler(const int nMsgID, void* pObject, NET_RECEIVE_THUNK pThunk)
+    {
+        if (nMsgID < 0 || nMsgID > 0xFFFF || GetReceiveHandler(nMsgID) != nullptr)
+        {
+            return false;
+        }
+
+        std::unique_ptr<NetReceiveHandler[]>& xPage = mxDispatchTable[nMsgID >> ARK_NET_DISPATCH_PAGE_BITS];
+
+        if (xPage == nullptr)
+        {
+            xPage.reset(new NetReceiveHandler[ARK_NET_DISPATCH_PAGE_SIZE]);
+        }
+
+        NetReceiveHandler& xHandler = xPage[nMsgID & (ARK_NET_DISPATCH_PAGE_SIZE - 1)];
+        xHandler.pObject = pObject;
+        xHandler.pThunk = pThunk;
+        return true;
+    }
+
+    const NetReceiveHandler* GetReceiveHandler(const int nMsgID) const
+    {
+        if (nMsgID < 0 || nMsgID > 0xFFFF)
+        {
+            return nullptr;
+        }
+
+        const std::unique_ptr<NetReceiveHandler[]>& xPage = mxDispatchTable[nMsgID >> ARK_NET_DISPATCH_PAGE_BITS];
+
+        if (xPage == nullptr)
+        {
+            return nullptr;
+        }
+
+        const NetReceiveHandler& xHandler = xPage[nMsgID & (ARK_NET_DISPATCH_PAGE_SIZE - 1)];
+        return (xHandler.pThunk != nullptr ? &xHandler : nullptr);
+    }
+
+    std::unique_ptr<NetReceiveHandler[]> mxDispatchTable[ARK_NET_DISPATCH_PAGE_COUNT];
     std::map<int, NET_RECEIVE_FUNCTOR_PTR> mxReceiveCallBack;
     std::list<NET_EVENT_FUNCTOR_PTR> mxEventCallBackList;
     std::list<NET_RECEIVE_FUNCTOR_PTR> mxCallBackList;
 };
 
+//xMsg is owned by the net arena, valid until the end of this net update
 #define ARK_MSG_PROCESS(xHead, nMsgID, msgData, nLen, msgType)                          \
     AFGUID nPlayerID;                                                                   \
-    msgType xMsg;                                                                       \
-    if (!AFINetModule::ReceivePB(xHead, msgData, nLen, xMsg, nPlayerID))                \
+    msgType* pArenaMsg = AFINetModule::ReceivePB<msgType>(xHead, msgData, nLen, nPlayerID); \
+    if (nullptr == pArenaMsg)                                                           \
     {                                                                                   \
         ARK_LOG_ERROR("Parse msg error, nMsgID = %d", nMsgID);                          \
         return;                                                                         \
     }                                                                                   \
+    msgType& xMsg = *pArenaMsg;                                                         \
                                                                                         \
     ARK_SHARE_PTR<AFIEntity> pEntity = m_pKernelModule->GetEntity(nPlayerID);           \
     if (nullptr == pEntity)                                                                                                 \
@@ -306,12 +503,13 @@ private:
 
 #define ARK_MSG_PROCESS_NO_OBJECT(xHead, msgData, nLen, msgType)                        \
     AFGUID nPlayerID;                                                                   \
-    msgType xMsg;                                                                       \
-    if (!AFINetModule::ReceivePB(xHead, msgData, nLen, xMsg, nPlayerID))                \
+    msgType* pArenaMsg = AFINetModule::ReceivePB<msgType>(xHead, msgData, nLen, nPlayerID); \
+    if (nullptr == pArenaMsg)                                                           \
     {                                                                                   \
         ARK_LOG_ERROR("Parse msg error, nMsgID = %d", nMsgID);                          \
         return;                                                                         \
-    }
+    }                                                                                   \
+    msgType& xMsg = *pArenaMsg;
 
 #define  ARK_MSG_PROCESS_NO_OBJECT_STRING(xHead, msg, nLen)                     \
     std::string strMsg;                                                         \
@@ -26,8 +26,12 @@
 #include "SDK/Interface/AFIModule.h"
 #include "SDK/Interface/AFIPluginManager.h"
 #include "SDK/Net/AFCNetServer.h"
+#include "SDK/Net/AFCKcpNetServer.h"
+#include "SDK/Net/AFCUringNetServer.h"
+#include "SDK/Net/AFCNetStatsServer.h"
 #include "SDK/Proto/AFProtoCPP.hpp"
 #include "Server/Interface/AFINetModule.h"
+#include "Server/Interface/AFNetRpc.hpp"
 
 class ServerData
 {
@@ -74,6 +78,7 @@ protected:
     {
         nLastTime = GetPluginManager()->GetNowTime();
         m_pNet = NULL;
+        AddReceiveCallBack<AFINetServerModule, &AFINetServerModule::OnRpcRequest>(AFNetRpcHead::ARK_RPC_MSG_REQUEST, this);
     }
 
 public:
@@ -83,6 +88,7 @@ public:
         pPluginManager = p;
         nLastTime = GetPluginManager()->GetNowTime();
         m_pNet = NULL;
+        AddReceiveCallBack<AFINetServerModule, &AFINetServerModule::OnRpcRequest>(AFNetRpcHead::ARK_RPC_MSG_REQUEST, this);
     }
 
     explicit AFINetServerModule(AFIPluginManager* p)
@@ -90,6 +96,7 @@ public:
         pPluginManager = p;
         nLastTime = GetPluginManager()->GetNowTime();
         m_pNet = NULL;
+        AddReceiveCallBack<AFINetServerModule, &AFINetServerModule::OnRpcRequest>(AFNetRpcHead::ARK_RPC_MSG_REQUEST, this);
     }
 
     virtual ~AFINetServerModule()
@@ -103,15 +110,32 @@ public:
         m_pNet = NULL;
     }
 
+    //make the net without starting it, so the options which the io threads read (compact head, compression, lanes)
+    //are set before the first connection. A net made here is the one Start starts, whatever its type
+    template<class ClassNetServerType = AFCNetServer>
+    AFINet* CreateNet()
+    {
+        if (m_pNet == nullptr)
+        {
+            m_pNet = ARK_NEW ClassNetServerType(this, &AFINetServerModule::OnReceiveNetPack, &AFINetServerModule::OnSocketNetEvent);
+        }
+
+        return m_pNet;
+    }
+
     //as server
+    //nListenerCount > 1 starts listeners on the same port with SO_REUSEPORT, see AFINet::SetListener
+    //Start<AFCKcpNetServer> serves the port over reliable udp instead of tcp, the listener options are not used then
+    //Start<AFCUringNetServer> serves tcp on io_uring where ARK_HAVE_IO_URING, nCpuCount workers with a listener each
     template<class ClassNetServerType = AFCNetServer>
-    int Start(const unsigned int nMaxClient, const std::string strIP, const unsigned short nPort, const int nServerID, const int nCpuCount)
+    int Start(const unsigned int nMaxClient, const std::string strIP, const unsigned short nPort, const int nServerID, const int nCpuCount, const int nListenerCount = 1, const bool bBindCpu = false)
     {
         std::string strIPAndPort;
         std::string strPort;
         AFMisc::ARK_TO_STR(strPort, nPort);
         strIPAndPort = strIP + ":" + strPort;
-        m_pNet = ARK_NEW ClassNetServerType(this, &AFINetServerModule::OnReceiveNetPack, &AFINetServerModule::OnSocketNetEvent);
+        CreateNet<ClassNetServerType>();
+        m_pNet->SetListener(nListenerCount, bBindCpu);
         return m_pNet->Start(nMaxClient, strIPAndPort, nServerID, nCpuCount);
     }
 
@@ -125,47 +149,61 @@ public:
         KeepAlive();
 
         m_pNet->Update();
+        //the messages decoded in this update are not used any more
+        AFNetMsgArena::Reset();
         return true;
     }
 
     bool SendMsgToAllClientWithOutHead(const int nMsgID, const std::string& msg, const AFGUID& nPlayerID)
     {
-        return m_pNet->SendMsgToAllClient(msg.c_str(), msg.length(), nPlayerID);
+        return m_pNet->SendMsgToAllClientWithOutHead(nMsgID, msg.c_str(), msg.length(), nPlayerID);
     }
 
     bool SendMsgPBToAllClient(const uint16_t nMsgID, const google::protobuf::Message& xData, const AFGUID& nPlayerID)
     {
-        std::string strMsg;
-
-        if (!xData.SerializeToString(&strMsg))
+        if (m_pNet == nullptr)
         {
-            char szData[MAX_PATH] = { 0 };
-            ARK_SPRINTF(szData, MAX_PATH, "Send Message to all Failed For Serialize of MsgData, MessageID: %d\n", nMsgID);
+            return false;
+        }
 
+        return m_pNet->SendMsgPacketToAllClient(AFINetModule::EnCodePB(nMsgID, xData, nPlayerID));
+    }
+
+    //serialize and encode once, then queue the same packet to every client in list
+    bool SendMsgPBToClientList(const uint16_t nMsgID, const google::protobuf::Message& xData, const std::vector<AFGUID>& xClientIDList, const AFGUID& nPlayerID)
+    {
+        if (m_pNet == nullptr)
+        {
             return false;
         }
 
-        return SendMsgToAllClientWithOutHead(nMsgID, strMsg, nPlayerID);
+        return m_pNet->SendMsgPacketToClientList(AFINetModule::EnCodePB(nMsgID, xData, nPlayerID), xClientIDList);
     }
 
+    //the message is serialized into the send packet directly, BrocastMsg wrapper included
     bool SendMsgPB(const uint16_t nMsgID, const google::protobuf::Message& xData, const AFGUID& xClientID, const AFGUID nPlayer, const std::vector<AFGUID>* pClientIDList = NULL)
     {
-        std::string xMsgData;
-
-        if (!xData.SerializeToString(&xMsgData))
+        if (m_pNet == nullptr)
         {
             char szData[MAX_PATH] = { 0 };
-            ARK_SPRINTF(szData, MAX_PATH, "Send Message to %s Failed For Serialize of MsgData, MessageID: %d\n", xClientID.ToString().c_str(), nMsgID);
-
+            ARK_SPRINTF(szData, MAX_PATH, "Send Message to %s Failed For NULL Of Net, MessageID: %d\n", xClientID.ToString().c_str(), nMsgID);
+            //LogSend(szData);
             return false;
         }
 
-        return SendMsgPB(nMsgID, xMsgData, xClientID, nPlayer, pClientIDList);
+        if (pClientIDList != nullptr)
+        {
+            return m_pNet->SendMsgPacket(AFINetModule::EnCodeBrocastPB(nMsgID, xData, nPlayer, *pClientIDList), xClientID);
+        }
+        else
+        {
+            return m_pNet->SendMsgPacket(AFINetModule::EnCodePB(nMsgID, xData, nPlayer), xClientID);
+        }
     }
 
     bool SendMsgPB(const uint16_t nMsgID, const std::string& strData, const AFGUID& xClientID, const AFGUID& nPlayer, const std::vector<AFGUID>* pClientIDList = NULL)
     {
-        if (m_pNet != nullptr)
+        if (m_pNet == nullptr)
         {
             char szData[MAX_PATH] = { 0 };
             ARK_SPRINTF(szData, MAX_PATH, "Send Message to %s Failed For NULL Of Net, MessageID: %d\n", xClientID.ToString().c_str(), nMsgID);
@@ -214,6 +252,47 @@ public:
         return m_pNet;
     }
 
+    //handle the calls of nMethodID made by AFINetClientModule::CallByServerID, answer with RpcResponse or RpcError,
+    //in the handler or later with a copy of the context
+    template<typename BaseType>
+    bool AddRpcHandler(const uint16_t nMethodID, BaseType* pBase, void (BaseType::*handler)(const AFNetRpcContext&, const char*, const uint32_t))
+    {
+        return AddRpcHandler(nMethodID, std::bind(handler, pBase, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    }
+
+    bool AddRpcHandler(const uint16_t nMethodID, const NET_RPC_HANDLER& xHandler)
+    {
+        return mxRpcHandlers.insert(std::make_pair(nMethodID, xHandler)).second;
+    }
+
+    bool RpcResponse(const AFNetRpcContext& xContext, const google::protobuf::Message& xData)
+    {
+        return SendRpcResponse(xContext, ARK_RPC_OK, &xData);
+    }
+
+    bool RpcError(const AFNetRpcContext& xContext, const AFNetRpcStatus eStatus)
+    {
+        return SendRpcResponse(xContext, eStatus, nullptr);
+    }
+
+    //net telemetry of the whole process in Prometheus text format at http://strIP:nPort/metrics, start it in one module only
+    bool StartStatsServer(const std::string& strIP, const unsigned short nPort)
+    {
+        if (m_pStatsServer != nullptr)
+        {
+            return false;
+        }
+
+        m_pStatsServer.reset(ARK_NEW AFCNetStatsServer());
+        return m_pStatsServer->Start(strIP, nPort);
+    }
+
+    //per msg id counters and session gauges merged in the last second
+    void GetNetStats(AFNetStatsSnapshot& xSnapshot)
+    {
+        AFNetStats::GetInstance().GetSnapshot(xSnapshot);
+    }
+
     bool PackTableToPB(AFDataTable* pTable, AFMsg::EntityDataTableBase* pEntityTableBase)
     {
         if (pTable == nullptr || pEntityTableBase == nullptr)
@@ -334,6 +413,47 @@ protected:
         OnSocketBaseNetEvent(eEvent, xClientID, nServerID);
     }
 
+    void OnRpcRequest(const AFIMsgHead& xHead, const int nMsgID, const char* msg, const uint32_t nLen, const AFGUID& xClientID)
+    {
+        AFNetRpcHead xRpcHead;
+
+        if (!xRpcHead.DeCode(msg, nLen))
+        {
+            return;
+        }
+
+        AFNetRpcContext xContext;
+        xContext.xClientID = xClientID;
+        xContext.xPlayerID = xHead.GetPlayerID();
+        xContext.nCallID = xRpcHead.nCallID;
+        xContext.nMethodID = xRpcHead.nMethodID;
+
+        auto iter = mxRpcHandlers.find(xRpcHead.nMethodID);
+
+        if (iter == mxRpcHandlers.end())
+        {
+            RpcError(xContext, ARK_RPC_NO_METHOD);
+            return;
+        }
+
+        iter->second(xContext, msg + AFNetRpcHead::ARK_RPC_HEAD_LENGTH, nLen - AFNetRpcHead::ARK_RPC_HEAD_LENGTH);
+    }
+
+    bool SendRpcResponse(const AFNetRpcContext& xContext, const int nStatus, const google::protobuf::Message* pData)
+    {
+        if (m_pNet == nullptr)
+        {
+            return false;
+        }
+
+        AFNetRpcHead xRpcHead;
+        xRpcHead.nCallID = xContext.nCallID;
+        xRpcHead.nMethodID = xContext.nMethodID;
+        xRpcHead.nStatus = (uint8_t)nStatus;
+
+        return m_pNet->SendMsgPacket(AFNetRpcHead::EnCodePB(AFNetRpcHead::ARK_RPC_MSG_RESPONSE, xRpcHead, pData, xContext.xPlayerID), xContext.xClientID);
+    }
+
     void KeepAlive()
     {
         //Do nothing whe m_pNet as server
@@ -365,4 +485,6 @@ protected:
 private:
     AFINet* m_pNet;
     int64_t nLastTime;
+    std::unique_ptr<AFCNetStatsServer> m_pStatsServer;
+    std::unordered_map<uint16_t, NET_RPC_HANDLER> mxRpcHandlers;
 };
\ No newline at end of file
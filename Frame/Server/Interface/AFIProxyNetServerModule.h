@@ -29,4 +29,5 @@ public:
     virtual int Transpond(const AFIMsgHead& xHead, const int nMsgID, const char* msg, const uint32_t nLen) = 0;
     virtual int EnterGameSuccessEvent(const AFGUID xClientID, const AFGUID xPlayerID) = 0;
     virtual int SendToPlayerClient(const int nMsgID, const char* msg, const uint32_t nLen, const AFGUID& nClientID, const AFGUID& nPlayer) = 0;
+    virtual int SendToPlayerClientList(const AFMsg::BrocastMsg& xMsg, const AFGUID& nPlayer) = 0;
 };
\ No newline at end of file
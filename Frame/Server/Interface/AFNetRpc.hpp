@@ -0,0 +1,118 @@
+/*
+* This source file is part of ArkGameFrame
+* For the latest info, see https://github.com/ArkGame
+*
+* Copyright (c) 2013-2018 ArkGame authors.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#pragma once
+
+#include "Server/Interface/AFINetModule.h"
+#include "SDK/Net/AFNetRpcCaller.hpp"
+
+//the server side of one call, copy it to answer later
+struct AFNetRpcContext
+{
+    AFGUID xClientID{ 0 };
+    AFGUID xPlayerID{ 0 };
+    uint64_t nCallID{ 0 };
+    uint16_t nMethodID{ 0 };
+};
+
+using NET_RPC_HANDLER = std::function<void(const AFNetRpcContext& xContext, const char* msg, const uint32_t nLen)>;
+
+//Request and response frames of the rpc layer go on two reserved msg ids, the method is a msg id too.
+//Body: [CallID(8)][MethodID(2)][Status(1)][protobuf message] in big endian like AFCMsgHead, the PlayerID of the head is the one of the call.
+class AFNetRpcHead
+{
+public:
+    enum
+    {
+        ARK_RPC_MSG_REQUEST = 0xFFFE,
+        ARK_RPC_MSG_RESPONSE = 0xFFFD,
+        ARK_RPC_HEAD_LENGTH = 11,
+    };
+
+    void EnCode(char* pData) const
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            pData[i] = (char)(nCallID >> (56 - i * 8));
+        }
+
+        pData[8] = (char)(nMethodID >> 8);
+        pData[9] = (char)(nMethodID);
+        pData[10] = (char)nStatus;
+    }
+
+    bool DeCode(const char* pData, const uint32_t nLen)
+    {
+        if (nLen < ARK_RPC_HEAD_LENGTH)
+        {
+            return false;
+        }
+
+        const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+        nCallID = 0;
+
+        for (int i = 0; i < 8; ++i)
+        {
+            nCallID = (nCallID << 8) | pBytes[i];
+        }
+
+        nMethodID = (uint16_t)((pBytes[8] << 8) | pBytes[9]);
+        nStatus = pBytes[10];
+        return true;
+    }
+
+    //head, rpc head and message in one pooled packet, the message is serialized into it directly
+    static brynet::net::DataSocket::PACKET_PTR EnCodePB(const uint16_t nMsgID, const AFNetRpcHead& xRpcHead, const google::protobuf::Message* pData, const AFGUID& xPlayerID)
+    {
+        const size_t nDataLen = (pData != nullptr ? pData->ByteSizeLong() : 0);
+        const size_t nBodyLen = ARK_RPC_HEAD_LENGTH + nDataLen;
+
+        AFCMsgHead xHead;
+        xHead.SetMsgID(nMsgID);
+        xHead.SetPlayerID(xPlayerID);
+        xHead.SetBodyLength(nBodyLen);
+
+        brynet::net::DataSocket::PACKET_PTR xPacket = AFNetPacketPool::GetInstance().Alloc(AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen);
+        xPacket->resize(AFIMsgHead::ARK_MSG_HEAD_LENGTH + nBodyLen);
+
+        char* pFrame = &(*xPacket)[0];
+        xHead.EnCode(pFrame);
+        xRpcHead.EnCode(pFrame + AFIMsgHead::ARK_MSG_HEAD_LENGTH);
+
+        if (pData != nullptr)
+        {
+            pData->SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(pFrame + AFIMsgHead::ARK_MSG_HEAD_LENGTH + ARK_RPC_HEAD_LENGTH));
+        }
+
+        return xPacket;
+    }
+
+    //parse a request or a response into the net arena, nullptr when it fails
+    template<typename MsgType>
+    static MsgType* ParsePB(const char* msg, const uint32_t nLen)
+    {
+        MsgType* pData = AFNetMsgArena::CreateMsg<MsgType>();
+        return (pData->ParseFromArray(msg, (int)nLen) ? pData : nullptr);
+    }
+
+    uint64_t nCallID{ 0 };
+    uint16_t nMethodID{ 0 };
+    uint8_t nStatus{ ARK_RPC_OK };
+};
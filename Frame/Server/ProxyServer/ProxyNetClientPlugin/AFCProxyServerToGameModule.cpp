@@ -181,11 +181,7 @@ void AFCProxyServerToGameModule::OnBrocastmsg(const AFIMsgHead& xHead, const int
 {
     ARK_MSG_PROCESS_NO_OBJECT(xHead, msg, nLen, AFMsg::BrocastMsg);
 
-    for (int i = 0; i < xMsg.target_entity_list_size(); i++)
-    {
-        const AFMsg::PBGUID& tmpID = xMsg.target_entity_list(i);
-        m_pProxyServerNet_ServerModule->SendToPlayerClient(xMsg.msg_id(), xMsg.msg_data().c_str(), xMsg.msg_data().size(), AFINetModule::PBToGUID(tmpID), nPlayerID);
-    }
+    m_pProxyServerNet_ServerModule->SendToPlayerClientList(xMsg, nPlayerID);
 }
 
 void AFCProxyServerToGameModule::LogServerInfo(const std::string& strServerInfo)
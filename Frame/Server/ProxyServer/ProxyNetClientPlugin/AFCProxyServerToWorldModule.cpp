@@ -229,9 +229,5 @@ void AFCProxyServerToWorldModule::OnBrocastmsg(const AFIMsgHead& xHead, const in
 {
     ARK_MSG_PROCESS_NO_OBJECT(xHead, msg, nLen, AFMsg::BrocastMsg);
 
-    for (int i = 0; i < xMsg.target_entity_list_size(); i++)
-    {
-        const AFMsg::PBGUID& xPlayerClientID = xMsg.target_entity_list(i);
-        m_pProxyServerNet_ServerModule->SendToPlayerClient(xMsg.msg_id(), xMsg.msg_data().c_str(), xMsg.msg_data().size(), AFINetModule::PBToGUID(xPlayerClientID), nPlayerID);
-    }
+    m_pProxyServerNet_ServerModule->SendToPlayerClientList(xMsg, nPlayerID);
 }
\ No newline at end of file
@@ -71,7 +71,39 @@ bool AFCProxyNetServerModule::PostInit()
 
                 m_pUUIDModule->SetGUIDMask(nServerID);
 
-                int nRet = m_pNetModule->Start(nMaxConnect, strIP, nPort, nCpus, nServerID);
+                //"kcp" serves the clients over reliable udp, for the ones on lossy mobile links, "uring" serves tcp on io_uring
+                const std::string strTransport(m_pElementModule->GetNodeString(strConfigName, "Transport"));
+                AFINet* pNet = nullptr;
+
+                if (strTransport == "kcp")
+                {
+                    pNet = m_pNetModule->CreateNet<AFCKcpNetServer>();
+                }
+#if ARK_HAVE_IO_URING
+                else if (strTransport == "uring")
+                {
+                    pNet = m_pNetModule->CreateNet<AFCUringNetServer>();
+                }
+#endif
+                else
+                {
+                    pNet = m_pNetModule->CreateNet();
+                }
+
+                //clients of this listener speak the varint head
+                pNet->SetCompactHead(m_pElementModule->GetNodeBool(strConfigName, "CompactHead"));
+
+                //a stalled client must not pile up output in the proxy
+                pNet->SetSendWaterMark(ARK_CLIENT_SEND_LOW_WATER, ARK_CLIENT_SEND_HIGH_WATER, ARK_CLIENT_SEND_LIMIT);
+
+                //big and repetitive, compressed for the clients which announce it
+                pNet->SetCompress(ARK_CLIENT_COMPRESS_MIN_SIZE);
+                pNet->SetMsgCompress(AFMsg::EGMI_ACK_ROLE_LIST, true);
+                pNet->SetMsgCompress(AFMsg::EGMI_ACK_ENTITY_DATA_NODE_ENTER, true);
+                pNet->SetMsgCompress(AFMsg::EGMI_ACK_ENTITY_DATA_TABLE_ENTER, true);
+
+                //started after the options are set, the io threads read them from the first connection on
+                const int nRet = m_pNetModule->Start(nMaxConnect, strIP, nPort, nServerID, nCpus);
 
                 if (nRet < 0)
                 {
@@ -121,7 +153,7 @@ void AFCProxyNetServerModule::OnOtherMessage(const AFIMsgHead& xHead, const int
         return;
     }
 
-    m_pProxyServerToGameModule->GetClusterModule()->SendByServerID(pSessionData->mnGameID, nMsgID, msg, nLen, xHead.GetPlayerID());
+    m_pProxyServerToGameModule->GetClusterModule()->SendFrameByServerID(pSessionData->mnGameID, xHead, msg, nLen, xHead.GetPlayerID());
 }
 
 void AFCProxyNetServerModule::OnConnectKeyProcess(const AFIMsgHead& xHead, const int nMsgID, const char* msg, const uint32_t nLen, const AFGUID& xClientID)
@@ -165,6 +197,14 @@ void AFCProxyNetServerModule::OnSocketClientEvent(const NetEventType eEvent, con
         ARK_LOG_INFO("Connected success, id = {}", xClientID.ToString());
         OnClientConnected(xClientID);
     }
+    else if (eEvent == SENDHIGHWATER)
+    {
+        ARK_LOG_WARN("Send backlog over high water, id = {}", xClientID.ToString());
+    }
+    else if (eEvent == SENDLOWWATER)
+    {
+        ARK_LOG_INFO("Send backlog under low water, id = {}", xClientID.ToString());
+    }
 }
 
 void AFCProxyNetServerModule::OnClientDisconnect(const AFGUID& xClientID)
@@ -261,7 +301,8 @@ int AFCProxyNetServerModule::Transpond(const AFIMsgHead& xHead, const int nMsgID
 
     if (pSessionData)
     {
-        m_pNetModule->GetNet()->SendMsgWithOutHead(nMsgID, msg, nLen, pSessionData->mnClientID, xHead.GetPlayerID());
+        //the received frame goes to the client as it is
+        m_pNetModule->GetNet()->SendMsgFrame(xHead, msg, nLen, pSessionData->mnClientID, xHead.GetPlayerID());
     }
 
     return true;
@@ -274,6 +315,21 @@ int AFCProxyNetServerModule::SendToPlayerClient(const int nMsgID, const char* ms
     return true;
 }
 
+int AFCProxyNetServerModule::SendToPlayerClientList(const AFMsg::BrocastMsg& xMsg, const AFGUID& nPlayer)
+{
+    //every target gets the same frame, so it is encoded once and all the sessions hold the same packet
+    mxBrocastTargets.clear();
+
+    for (int i = 0; i < xMsg.target_entity_list_size(); i++)
+    {
+        mxBrocastTargets.push_back(AFINetModule::PBToGUID(xMsg.target_entity_list(i)));
+    }
+
+    m_pNetModule->GetNet()->SendMsgToClientListWithOutHead(xMsg.msg_id(), xMsg.msg_data().data(), xMsg.msg_data().size(), mxBrocastTargets, nPlayer);
+
+    return true;
+}
+
 void AFCProxyNetServerModule::OnClientConnected(const AFGUID& xClientID)
 {
     ARK_SHARE_PTR<SessionData> pSessionData = std::make_shared<SessionData>();
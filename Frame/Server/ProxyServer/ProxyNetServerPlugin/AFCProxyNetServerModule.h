@@ -36,6 +36,15 @@
 class AFCProxyNetServerModule : public AFIProxyNetServerModule
 {
 public:
+    //send backlog of a player client, see AFINet::SetSendWaterMark
+    enum
+    {
+        ARK_CLIENT_SEND_LOW_WATER = 256 * 1024,
+        ARK_CLIENT_SEND_HIGH_WATER = 1024 * 1024,
+        ARK_CLIENT_SEND_LIMIT = 8 * 1024 * 1024,
+        ARK_CLIENT_COMPRESS_MIN_SIZE = 1024, //see AFINet::SetCompress
+    };
+
     explicit AFCProxyNetServerModule(AFIPluginManager* p)
     {
         pPluginManager = p;
@@ -49,6 +58,7 @@ public:
 
     virtual int Transpond(const AFIMsgHead& xHead, const int nMsgID, const char* msg, const uint32_t nLen);
     virtual int SendToPlayerClient(const int nMsgID, const char* msg, const uint32_t nLen, const AFGUID& nClientID, const AFGUID& nPlayer);
+    virtual int SendToPlayerClientList(const AFMsg::BrocastMsg& xMsg, const AFGUID& nPlayer);
 
     //进入游戏成功
     virtual int EnterGameSuccessEvent(const AFGUID xClientID, const AFGUID xPlayerID);
@@ -92,6 +102,7 @@ protected:
 
 private:
     AFMapEx<AFGUID, SessionData> mmSessionData; //Player Client <--> SessionData
+    std::vector<AFGUID> mxBrocastTargets; //reused by SendToPlayerClientList
     AFCConsistentHash mxConsistentHash;
 
     AFIProxyServerToWorldModule* m_pProxyToWorldModule;